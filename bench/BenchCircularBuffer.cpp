@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+#include "ets/CircularBuffer.h"
+
+using namespace ets;
+
+/***/
+static void BM_CircularBuffer_Insert(benchmark::State& state)
+{
+  CircularBuffer<int64_t> buffer{static_cast<std::size_t>(state.range(0))};
+  int64_t value{0};
+
+  for (auto _ : state)
+  {
+    buffer.insert(value++);
+    benchmark::DoNotOptimize(buffer.back());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CircularBuffer_Insert)->Arg(16)->Arg(1024)->Arg(1 << 16);
+
+/***/
+static void BM_CircularBuffer_InsertN(benchmark::State& state)
+{
+  CircularBuffer<int64_t> buffer{1024};
+  auto const n = static_cast<std::size_t>(state.range(0));
+  int64_t value{0};
+
+  for (auto _ : state)
+  {
+    buffer.insert_n(value++, n);
+    benchmark::DoNotOptimize(buffer.back());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CircularBuffer_InsertN)->Arg(8)->Arg(200);
+
+/**
+ * Same as BM_CircularBuffer_Insert with the capacity known at compile time
+ */
+template <std::size_t N>
+static void BM_FixedCircularBuffer_Insert(benchmark::State& state)
+{
+  CircularBuffer<int64_t, N> buffer;
+  int64_t value{0};
+
+  for (auto _ : state)
+  {
+    buffer.insert(value++);
+    benchmark::DoNotOptimize(buffer.back());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_FixedCircularBuffer_Insert, 16);
+BENCHMARK_TEMPLATE(BM_FixedCircularBuffer_Insert, 1024);
+BENCHMARK_TEMPLATE(BM_FixedCircularBuffer_Insert, 1 << 16);
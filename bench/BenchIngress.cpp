@@ -0,0 +1,130 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "ets/MpscQueue.h"
+
+using namespace ets;
+
+namespace
+{
+struct NewOrder
+{
+  std::string desc;
+};
+
+struct AmendOrder
+{
+  std::string desc;
+};
+
+struct CancelOrder
+{
+  std::string desc;
+};
+
+using message_t = std::variant<NewOrder, AmendOrder, CancelOrder>;
+
+/**
+ * The mutex based queue the example used before, kept as a baseline
+ */
+class MutexQueue
+{
+public:
+  void push(message_t&& item)
+  {
+    std::lock_guard lock{_mutex};
+    _queue.push(std::move(item));
+  }
+
+  template <typename TFunc>
+  std::size_t consume(TFunc&& func, std::size_t max_items)
+  {
+    std::size_t consumed{0};
+    std::lock_guard lock{_mutex};
+    while (!_queue.empty() && consumed < max_items)
+    {
+      func(_queue.front());
+      _queue.pop();
+      ++consumed;
+    }
+    return consumed;
+  }
+
+private:
+  std::mutex _mutex;
+  std::queue<message_t> _queue;
+};
+
+struct MpscQueueAdapter
+{
+  MpscQueue<message_t> queue{4096};
+
+  void push(message_t&& item) { queue.push(std::move(item)); }
+
+  template <typename TFunc>
+  std::size_t consume(TFunc&& func, std::size_t max_items)
+  {
+    return queue.consume(std::forward<TFunc>(func), max_items);
+  }
+};
+} // namespace
+
+/**
+ * range(0) producer threads push orders while the benchmark thread consumes them in batches
+ */
+template <typename TQueue>
+static void BM_Ingress(benchmark::State& state)
+{
+  auto const producers = static_cast<std::size_t>(state.range(0));
+  constexpr std::size_t messages_per_producer = 100'000;
+
+  for (auto _ : state)
+  {
+    TQueue queue;
+    std::vector<std::thread> threads;
+
+    for (std::size_t p = 0; p < producers; ++p)
+    {
+      threads.emplace_back(
+        [&queue]()
+        {
+          for (std::size_t i = 0; i < messages_per_producer; ++i)
+          {
+            queue.push(message_t{std::in_place_type<NewOrder>, "order"});
+          }
+        });
+    }
+
+    std::size_t consumed{0};
+    while (consumed < producers * messages_per_producer)
+    {
+      std::size_t const batch =
+        queue.consume([](message_t& message) { benchmark::DoNotOptimize(message.index()); }, 64);
+
+      if (batch == 0)
+      {
+        // let the producers run when there are fewer cores than threads
+        std::this_thread::yield();
+      }
+
+      consumed += batch;
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(producers * messages_per_producer));
+}
+BENCHMARK_TEMPLATE(BM_Ingress, MutexQueue)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Ingress, MpscQueueAdapter)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "ets/GcraWindow.h"
+#include "ets/SlidingWindow.h"
+
+using namespace ets;
+
+#if defined(__GNUC__) && !defined(__clang__)
+  // the replaced operators below pair malloc with free, gcc can not see through that
+  #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+/**
+ * Counts the bytes allocated by the thread, used to report the memory of each window
+ */
+namespace
+{
+thread_local std::size_t allocated_bytes{0};
+}
+
+void* operator new(std::size_t size)
+{
+  allocated_bytes += size;
+  if (void* ptr = std::malloc(size))
+  {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+/**
+ * Counts the bytes allocated through it. The windows allocating from a std::pmr::memory_resource
+ * get one, their allocations go through the aligned operator new which is not replaced above
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocated_bytes{0};
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    allocated_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+  }
+
+  [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+} // namespace
+
+/**
+ * Reports the memory of one window limiting at range(0) messages per second
+ */
+template <typename TWindow>
+static void BM_Window_Memory(benchmark::State& state)
+{
+  auto const max_messages = static_cast<std::size_t>(state.range(0));
+  std::size_t heap_bytes{0};
+
+  for (auto _ : state)
+  {
+    CountingResource resource;
+    std::size_t const before = allocated_bytes;
+
+    if constexpr (std::is_constructible_v<TWindow, std::size_t, std::chrono::seconds, std::pmr::memory_resource*>)
+    {
+      TWindow window{max_messages, std::chrono::seconds{1}, &resource};
+      benchmark::DoNotOptimize(window);
+    }
+    else
+    {
+      TWindow window{max_messages, std::chrono::seconds{1}};
+      benchmark::DoNotOptimize(window);
+    }
+
+    heap_bytes = allocated_bytes - before + resource.allocated_bytes;
+  }
+
+  state.counters["bytes"] = static_cast<double>(sizeof(TWindow) + heap_bytes);
+}
+BENCHMARK_TEMPLATE(BM_Window_Memory, SlidingWindow<>)->Arg(100)->Arg(10'000)->Arg(50'000);
+BENCHMARK_TEMPLATE(BM_Window_Memory, GcraWindow<>)->Arg(100)->Arg(10'000)->Arg(50'000);
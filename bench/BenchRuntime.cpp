@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ets/GcraWindow.h"
+#include "ets/Runtime.h"
+
+using namespace ets;
+
+namespace
+{
+struct Order
+{
+  uint64_t order_id;
+};
+
+/**
+ * Counts the sent orders of a session, so the sessions do not share a line
+ */
+struct CountingCallback
+{
+  void on_send(Order const& order) { benchmark::DoNotOptimize(sent += order.order_id != 0); }
+
+  uint64_t sent{0};
+};
+
+using session_t = PriorityThrottler<CountingCallback, PriorityMap<Tier<Order>>, GcraWindow<>>;
+using runtime_t = Runtime<Order, session_t>;
+} // namespace
+
+/**
+ * 4 producer threads push orders of 256 sessions to range(0) pipelines. The sessions are not
+ * throttled, so this is the cost of the routing, the rings and the sessions
+ */
+static void BM_Runtime(benchmark::State& state)
+{
+  constexpr std::size_t producers = 4;
+  constexpr std::size_t sessions = 256;
+  constexpr std::size_t messages_per_producer = 250'000;
+
+  RuntimeConfig config;
+  config.pipelines = static_cast<std::size_t>(state.range(0));
+  config.producers = producers;
+  config.rebalance = false;
+  for (std::size_t i = 0; i < config.pipelines; ++i)
+  {
+    config.cpus.push_back(static_cast<int>(i));
+  }
+
+  for (auto _ : state)
+  {
+    runtime_t runtime{config,
+                      [](session_id_t)
+                      {
+                        return std::make_unique<session_t>(1'000'000'000, std::chrono::seconds{1},
+                                                           CountingCallback{});
+                      }};
+    runtime.run();
+
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; ++p)
+    {
+      threads.emplace_back(
+        [&runtime, p]()
+        {
+          for (std::size_t i = 0; i < messages_per_producer; ++i)
+          {
+            runtime.producer(p).push(i % sessions, Order{i + 1});
+          }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    std::size_t processed{0};
+    while (processed < producers * messages_per_producer)
+    {
+      std::this_thread::yield();
+
+      processed = 0;
+      for (std::size_t i = 0; i < runtime.pipelines(); ++i)
+      {
+        processed += runtime.stats(i).processed;
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(producers * messages_per_producer));
+}
+BENCHMARK(BM_Runtime)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,181 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "BenchUtils.h"
+#include "ets/Clock.h"
+#include "ets/GcraWindow.h"
+#include "ets/SlidingWindow.h"
+
+using namespace ets;
+
+/**
+ * Requests at exactly the configured rate so every request is admitted
+ */
+template <typename TWindow>
+static void BM_Window_RequestAdmitted(benchmark::State& state)
+{
+  auto const max_messages = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  TWindow window{max_messages, std::chrono::seconds{1}};
+  auto const step = std::chrono::nanoseconds{std::chrono::seconds{1}} / static_cast<int64_t>(max_messages);
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(step);
+    benchmark::DoNotOptimize(window.request());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Window_RequestAdmitted, SlidingWindow<ManualClock>)->Arg(100)->Arg(50'000);
+BENCHMARK_TEMPLATE(BM_Window_RequestAdmitted, GcraWindow<ManualClock>)->Arg(100)->Arg(50'000);
+
+/**
+ * Same as BM_Window_RequestAdmitted with the limit known at compile time
+ */
+template <std::size_t MaxMessages>
+static void BM_FixedSlidingWindow_RequestAdmitted(benchmark::State& state)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  FixedSlidingWindow<MaxMessages, std::chrono::seconds{1}, ManualClock> window;
+  auto const step = std::chrono::nanoseconds{std::chrono::seconds{1}} / static_cast<int64_t>(MaxMessages);
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(step);
+    benchmark::DoNotOptimize(window.request());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_FixedSlidingWindow_RequestAdmitted, 100);
+BENCHMARK_TEMPLATE(BM_FixedSlidingWindow_RequestAdmitted, 50'000);
+
+/**
+ * Requests while the window is full so every request is throttled
+ */
+template <typename TWindow>
+static void BM_Window_RequestThrottled(benchmark::State& state)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  TWindow window{100, std::chrono::seconds{1}};
+  while (window.request().count() == 0)
+  {
+  }
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(window.request());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Window_RequestThrottled, SlidingWindow<ManualClock>);
+BENCHMARK_TEMPLATE(BM_Window_RequestThrottled, GcraWindow<ManualClock>);
+
+/**
+ * The cost of the clock read in request() for each clock policy
+ */
+template <typename TWindow>
+static void BM_Window_RequestClock(benchmark::State& state)
+{
+  TWindow window{1'000'000'000, std::chrono::seconds{1}};
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(window.request());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Window_RequestClock, GcraWindow<std::chrono::steady_clock>);
+BENCHMARK_TEMPLATE(BM_Window_RequestClock, GcraWindow<TscClock>);
+BENCHMARK_TEMPLATE(BM_Window_RequestClock, GcraWindow<CoarseClock<>>);
+
+/**
+ * Admits a basket of messages with one request
+ */
+template <typename TWindow>
+static void BM_Window_RequestN(benchmark::State& state)
+{
+  auto const n = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  TWindow window{n * 10, std::chrono::seconds{1}, n};
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(std::chrono::milliseconds{100});
+    benchmark::DoNotOptimize(window.request_n(n));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Window_RequestN, GcraWindow<ManualClock>)->Arg(200);
+
+/**
+ * Same as BM_Window_RequestN for the sliding window which has no burst parameter
+ */
+static void BM_SlidingWindow_RequestN(benchmark::State& state)
+{
+  auto const n = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  SlidingWindow<ManualClock> window{n * 10, std::chrono::seconds{1}};
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(std::chrono::milliseconds{100});
+    benchmark::DoNotOptimize(window.request_n(n));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SlidingWindow_RequestN)->Arg(200);
+
+/**
+ * Per message latency percentiles of the admitted path
+ */
+template <typename TWindow>
+static void BM_Window_RequestLatency(benchmark::State& state)
+{
+  auto const max_messages = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  TWindow window{max_messages, std::chrono::seconds{1}};
+  auto const step = std::chrono::nanoseconds{std::chrono::seconds{1}} / static_cast<int64_t>(max_messages);
+  LatencyRecorder recorder;
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(step);
+    recorder.measure([&window]() { benchmark::DoNotOptimize(window.request()); });
+  }
+
+  recorder.report(state);
+}
+BENCHMARK_TEMPLATE(BM_Window_RequestLatency, SlidingWindow<ManualClock>)->Arg(100)->Arg(50'000);
+BENCHMARK_TEMPLATE(BM_Window_RequestLatency, GcraWindow<ManualClock>)->Arg(100)->Arg(50'000);
+
+/**
+ * Counts the messages of the last half interval in a full window whose ring wraps around
+ */
+static void BM_SlidingWindow_CountInWindow(benchmark::State& state)
+{
+  auto const max_messages = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  SlidingWindow<ManualClock> window{max_messages, std::chrono::seconds{1}};
+  auto const step = std::chrono::nanoseconds{std::chrono::seconds{1}} / static_cast<int64_t>(max_messages);
+  for (std::size_t i = 0; i < max_messages + max_messages / 3; ++i)
+  {
+    ManualClock::advance(step);
+    (void)window.request();
+  }
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(window.count_in_window(std::chrono::milliseconds{500}));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SlidingWindow_CountInWindow)->Arg(100)->Arg(50'000);
@@ -0,0 +1,257 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "ets/CacheLine.h"
+#include "ets/Clock.h"
+#include "ets/MessageStorage.h"
+#include "ets/SlidingWindow.h"
+#include "ets/Throttler.h"
+
+using namespace ets;
+
+namespace
+{
+struct HighPrioMsg
+{
+  uint64_t id;
+};
+
+struct LowPrioMsg
+{
+  uint64_t id;
+  std::string desc{"an order description that does not fit in the small string buffer"};
+};
+
+struct OnSendCallback
+{
+  template <typename TMessage>
+  void on_send(TMessage const& message)
+  {
+    benchmark::DoNotOptimize(message.id);
+    ++sent;
+  }
+
+  std::size_t sent{0};
+};
+
+template <typename TRestStorage>
+using throttler_t = Throttler<HighPrioMsg, OnSendCallback, TRestStorage, SlidingWindow<ManualClock>>;
+} // namespace
+
+/**
+ * Per message latency percentiles of try_send_message for admitted messages
+ */
+static void BM_Throttler_AdmitLatency(benchmark::State& state)
+{
+  constexpr std::size_t max_messages = 50'000;
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  throttler_t<TypeErasedStorage> throttler{max_messages, std::chrono::seconds{1}, OnSendCallback{}};
+  auto const step = std::chrono::nanoseconds{std::chrono::seconds{1}} / static_cast<int64_t>(max_messages);
+
+  LatencyRecorder recorder;
+  LowPrioMsg const message{1};
+
+  for (auto _ : state)
+  {
+    ManualClock::advance(step);
+    recorder.measure([&]() { benchmark::DoNotOptimize(throttler.try_send_message(message)); });
+  }
+
+  recorder.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Throttler_AdmitLatency);
+
+/**
+ * Per message latency percentiles of try_send_message when the message is throttled and queued
+ */
+template <typename TRestStorage>
+static void BM_Throttler_QueueLatency(benchmark::State& state)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  LatencyRecorder recorder;
+  LowPrioMsg const message{1};
+
+  auto throttler = std::make_unique<throttler_t<TRestStorage>>(1, std::chrono::seconds{1}, OnSendCallback{});
+  benchmark::DoNotOptimize(throttler->try_send_message(message));
+
+  uint64_t queued{0};
+  for (auto _ : state)
+  {
+    recorder.measure([&]() { benchmark::DoNotOptimize(throttler->try_send_message(message)); });
+
+    if (++queued == 100'000)
+    {
+      // do not let the backlog grow forever
+      state.PauseTiming();
+      throttler = std::make_unique<throttler_t<TRestStorage>>(1, std::chrono::seconds{1}, OnSendCallback{});
+      benchmark::DoNotOptimize(throttler->try_send_message(message));
+      queued = 0;
+      state.ResumeTiming();
+    }
+  }
+
+  recorder.report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Throttler_QueueLatency, TypeErasedStorage);
+BENCHMARK_TEMPLATE(BM_Throttler_QueueLatency, VariantStorage<LowPrioMsg>);
+
+/**
+ * Drains a backlog of range(0) messages in a single send_queued_messages() call
+ */
+template <typename TRestStorage>
+static void BM_Throttler_Drain(benchmark::State& state)
+{
+  auto const backlog = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  throttler_t<TRestStorage> throttler{backlog, std::chrono::seconds{1}, OnSendCallback{}};
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    // fill the window and then queue the backlog
+    for (std::size_t i = 0; i < 2 * backlog; ++i)
+    {
+      benchmark::DoNotOptimize(throttler.try_send_message(LowPrioMsg{i}));
+    }
+    ManualClock::advance(std::chrono::seconds{1});
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(throttler.send_queued_messages());
+
+    state.PauseTiming();
+    ManualClock::advance(std::chrono::seconds{1});
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Throttler_Drain, TypeErasedStorage)->Arg(1'000)->Arg(100'000);
+BENCHMARK_TEMPLATE(BM_Throttler_Drain, VariantStorage<LowPrioMsg>)->Arg(1'000)->Arg(100'000);
+
+/**
+ * Queues and drains a backlog where range(0) percent of the messages are high priority
+ */
+static void BM_Throttler_PriorityMix(benchmark::State& state)
+{
+  constexpr std::size_t backlog = 10'000;
+  auto const high_percent = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  throttler_t<VariantStorage<LowPrioMsg>> throttler{backlog, std::chrono::seconds{1}, OnSendCallback{}};
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    for (std::size_t i = 0; i < backlog; ++i)
+    {
+      benchmark::DoNotOptimize(throttler.try_send_message(LowPrioMsg{i}));
+    }
+    state.ResumeTiming();
+
+    // queue a mix of messages
+    for (std::size_t i = 0; i < backlog; ++i)
+    {
+      if (i % 100 < high_percent)
+      {
+        benchmark::DoNotOptimize(throttler.try_send_message(HighPrioMsg{i}));
+      }
+      else
+      {
+        benchmark::DoNotOptimize(throttler.try_send_message(LowPrioMsg{i}));
+      }
+    }
+
+    ManualClock::advance(std::chrono::seconds{1});
+    benchmark::DoNotOptimize(throttler.send_queued_messages());
+    ManualClock::advance(std::chrono::seconds{1});
+  }
+
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(backlog));
+}
+BENCHMARK(BM_Throttler_PriorityMix)->Arg(0)->Arg(10)->Arg(50)->Arg(90);
+
+namespace
+{
+template <typename TThrottler>
+TThrottler& throttler_of(TThrottler& throttler)
+{
+  return throttler;
+}
+
+template <typename TThrottler>
+TThrottler& throttler_of(CacheAligned<TThrottler>& throttler)
+{
+  return throttler.value;
+}
+
+template <typename TThrottler>
+void emplace_throttler(std::vector<TThrottler>& throttlers)
+{
+  if constexpr (std::is_default_constructible_v<typename TThrottler::window_t>)
+  {
+    throttlers.emplace_back(typename TThrottler::window_t{}, OnSendCallback{});
+  }
+  else
+  {
+    throttlers.emplace_back(4, std::chrono::seconds{1}, OnSendCallback{});
+  }
+}
+
+template <typename TThrottler>
+void emplace_throttler(std::vector<CacheAligned<TThrottler>>& throttlers)
+{
+  throttlers.emplace_back(4, std::chrono::seconds{1}, OnSendCallback{});
+}
+
+using plain_throttler_t = throttler_t<VariantStorage<LowPrioMsg>>;
+using fixed_throttler_t =
+  Throttler<HighPrioMsg, OnSendCallback, VariantStorage<LowPrioMsg>, FixedSlidingWindow<4, std::chrono::seconds{1}, ManualClock>>;
+} // namespace
+
+/**
+ * Admissions spread at random over range(0) throttlers, e.g. one per instrument, so most
+ * admissions miss the data cache: a plain vector of throttlers, one padded to whole cache lines
+ * per throttler and one with the window inline in the throttler
+ */
+template <typename TThrottlers>
+static void BM_Throttler_ManyThrottlers(benchmark::State& state)
+{
+  auto const count = static_cast<std::size_t>(state.range(0));
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  TThrottlers throttlers;
+  throttlers.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    emplace_throttler(throttlers);
+  }
+
+  HighPrioMsg const message{1};
+  uint64_t random{88172645463325252ULL};
+
+  for (auto _ : state)
+  {
+    // xorshift, cheap enough to not hide the cache misses
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+
+    auto& throttler = throttler_of(throttlers[random % count]);
+    benchmark::DoNotOptimize(throttler.try_send_message(message));
+
+    // slow enough that every message is admitted, so no backlog grows
+    ManualClock::advance(std::chrono::milliseconds{1});
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Throttler_ManyThrottlers, std::vector<plain_throttler_t>)->Arg(4'096)->Arg(65'536);
+BENCHMARK_TEMPLATE(BM_Throttler_ManyThrottlers, std::vector<CacheAligned<plain_throttler_t>>)->Arg(4'096)->Arg(65'536);
+BENCHMARK_TEMPLATE(BM_Throttler_ManyThrottlers, std::vector<fixed_throttler_t>)->Arg(4'096)->Arg(65'536);
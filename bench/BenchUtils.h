@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ets/Clock.h"
+
+/**
+ * Records the latency of single operations and reports percentiles as benchmark counters.
+ * The samples are taken with the TscClock, so they include one clock read of overhead.
+ */
+class LatencyRecorder
+{
+public:
+  explicit LatencyRecorder(std::size_t max_samples = 1'000'000) { _samples.reserve(max_samples); }
+
+  template <typename TFunc>
+  void measure(TFunc&& func)
+  {
+    auto const start = ets::TscClock::now();
+    func();
+    auto const end = ets::TscClock::now();
+
+    if (_samples.size() < _samples.capacity())
+    {
+      _samples.push_back((end - start).count());
+    }
+  }
+
+  void report(benchmark::State& state)
+  {
+    if (_samples.empty())
+    {
+      return;
+    }
+
+    std::sort(_samples.begin(), _samples.end());
+    state.counters["p50_ns"] = static_cast<double>(_percentile(0.50));
+    state.counters["p99_ns"] = static_cast<double>(_percentile(0.99));
+    state.counters["p999_ns"] = static_cast<double>(_percentile(0.999));
+  }
+
+private:
+  [[nodiscard]] long long _percentile(double p) const
+  {
+    auto const i = static_cast<std::size_t>(p * static_cast<double>(_samples.size() - 1));
+    return _samples[i];
+  }
+
+private:
+  std::vector<long long> _samples;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "BatchAdmission.h"
+#include "SlidingWindow.h"
+
+namespace ets
+{
+/**
+ * Parameters of the additive increase, multiplicative decrease controller of AdaptiveWindow
+ */
+struct AimdConfig
+{
+  // the limit is multiplied by this factor on a reject of the venue
+  double decrease{0.5};
+
+  // the limit grows by this number of messages after each period without reject
+  std::size_t increase{1};
+
+  // how long the limit is kept after a change. Rejects within one period of a decrease are taken
+  // as the same slow down, since they are usually for messages sent before the decrease
+  std::chrono::nanoseconds period{std::chrono::seconds{1}};
+
+  // the limit never goes below this number of messages
+  std::size_t min_messages{1};
+};
+
+/**
+ * A window whose limit follows the feedback of the venue, so the throttler runs at the real
+ * limit of the venue instead of a conservative static margin. on_reject() shrinks the limit on a
+ * "slow down" reject, then the limit grows back one step per quiet period up to the configured
+ * ceiling:
+ *
+ *   PriorityThrottler<OnSendCallback, Priorities, AdaptiveWindow<>> throttler{100, 1s, callback};
+ *   ...
+ *   if (reject.reason == Reason::Throttled)
+ *   {
+ *     throttler.window().on_reject();
+ *   }
+ *
+ * set_ceiling() changes the limit of the venue itself, e.g. when it widens its limits intraday.
+ * Neither loses the messages already in the window nor the backlog of the throttler.
+ *
+ * The limit is adapted while checking the window, so the delay and the admissible messages are
+ * not const unlike those of SlidingWindow.
+ *
+ * @tparam TWindow the window enforcing the current limit, it must provide
+ * set_limit(max_messages, interval) like SlidingWindow and GcraWindow
+ */
+template <typename TWindow = SlidingWindow<>>
+class AdaptiveWindow
+{
+public:
+  using clock_t = typename TWindow::clock_t;
+  using time_point = typename TWindow::time_point;
+
+  /**
+   * @param max_messages ceiling of the limit, which is also the initial limit
+   * @param interval window length, it does not adapt
+   */
+  AdaptiveWindow(std::size_t max_messages, std::chrono::nanoseconds interval, AimdConfig config = {})
+    : _window(max_messages, interval),
+      _config(config),
+      _interval(interval),
+      _ceiling(max_messages),
+      _limit(max_messages)
+  {
+  }
+
+  /**
+   * Request to send a new message
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(clock_t::now()); }
+
+  /**
+   * Request to send a new message at the given time
+   * @param now current time of the clock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    _adapt(now);
+    return _window.request(now);
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, clock_t::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of the clock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    _adapt(now);
+    return _window.request_n(n, now);
+  }
+
+  /**
+   * How long until one more message can be sent at the given time, without sending it
+   * @param now current time of the clock
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now)
+  {
+    _adapt(now);
+    return _window.delay(now);
+  }
+
+  /**
+   * @return how many of `n` messages can be sent at the given time, without sending them
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now)
+  {
+    _adapt(now);
+    return _window.admissible(n, now);
+  }
+
+  /**
+   * Records `n` messages sent at the given time
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now) { _window.commit(n, now); }
+
+  /**
+   * The venue rejected a message because we sent too fast, the limit is decreased unless it was
+   * already decreased within the last period
+   */
+  void on_reject() { on_reject(clock_t::now()); }
+
+  /**
+   * The venue rejected a message at the given time because we sent too fast
+   * @param now current time of the clock
+   */
+  void on_reject(time_point now)
+  {
+    if (_decreased && (now - _last_change < _config.period))
+    {
+      return;
+    }
+
+    auto const decreased = static_cast<std::size_t>(static_cast<double>(_limit) * _config.decrease);
+    _set_limit(std::clamp(decreased, std::min(_config.min_messages, _ceiling), _ceiling));
+    _decreased = true;
+    _last_change = now;
+  }
+
+  /**
+   * Changes the limit of the venue. The current limit is capped by the new ceiling but does not
+   * jump up to it, it ramps up as after a reject
+   * @param max_messages new ceiling of the limit
+   * @param interval new window length
+   */
+  void set_ceiling(std::size_t max_messages, std::chrono::nanoseconds interval)
+  {
+    _ceiling = max_messages;
+    _interval = interval;
+    _limit = std::min(_limit, _ceiling);
+    _window.set_limit(_limit, _interval);
+  }
+
+  /**
+   * @return the current limit, at most the ceiling
+   */
+  [[nodiscard]] std::size_t limit() const noexcept { return _limit; }
+
+  [[nodiscard]] std::size_t ceiling() const noexcept { return _ceiling; }
+
+  [[nodiscard]] TWindow& window() noexcept { return _window; }
+
+  [[nodiscard]] TWindow const& window() const noexcept { return _window; }
+
+private:
+  /**
+   * Increases the limit by one step per period elapsed since the last change
+   */
+  void _adapt(time_point now)
+  {
+    if (_limit >= _ceiling)
+    {
+      _last_change = now;
+      return;
+    }
+
+    auto const elapsed = now - _last_change;
+    if (elapsed < _config.period)
+    {
+      return;
+    }
+
+    auto const periods = static_cast<std::size_t>(elapsed / _config.period);
+    std::size_t const headroom = _ceiling - _limit;
+    std::size_t const steps = _config.increase > 0 ? headroom / _config.increase + 1 : 0;
+    std::size_t const increase = std::min(periods, steps) * _config.increase;
+
+    _set_limit(std::min(_ceiling, _limit + increase));
+    _decreased = false;
+    _last_change += static_cast<std::chrono::nanoseconds::rep>(periods) * _config.period;
+  }
+
+  void _set_limit(std::size_t limit)
+  {
+    if (limit != _limit)
+    {
+      _limit = limit;
+      _window.set_limit(_limit, _interval);
+    }
+  }
+
+private:
+  TWindow _window;
+  AimdConfig _config;
+  std::chrono::nanoseconds _interval;
+  std::size_t _ceiling;
+  std::size_t _limit;
+  time_point _last_change{};
+  bool _decreased{false};
+};
+} // namespace ets
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace ets
+{
+/**
+ * A bump allocator for the messages of a backlog, see ArenaStorage in MessageStorage.h.
+ *
+ * Memory is handed out from chunks taken from the upstream resource and deallocating does
+ * nothing. rewind() makes all the chunks available again in O(1) once nothing allocated from the
+ * arena is alive anymore, so the arena only goes to the upstream resource while it grows to the
+ * largest backlog. The chunks are given back by release() or the destructor.
+ *
+ * Like std::pmr::monotonic_buffer_resource but rewinding keeps the chunks instead of releasing
+ * them. It is not thread safe.
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  /**
+   * @param upstream where the chunks are allocated, e.g. a HugePageResource
+   * @param chunk_size size of the first chunk, each next chunk doubles it
+   */
+  explicit Arena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                 std::size_t chunk_size = default_chunk_size) noexcept
+    : _upstream(upstream), _next_chunk_size(std::max<std::size_t>(chunk_size, 64))
+  {
+  }
+
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  Arena(Arena&& other) noexcept
+    : _upstream(other._upstream),
+      _next_chunk_size(other._next_chunk_size),
+      _chunks(std::move(other._chunks)),
+      _chunk(std::exchange(other._chunk, 0)),
+      _offset(std::exchange(other._offset, 0))
+  {
+    other._chunks.clear();
+  }
+
+  ~Arena() override { release(); }
+
+  /**
+   * Makes the memory of every chunk available again. Nothing allocated from the arena must be
+   * used after
+   */
+  void rewind() noexcept
+  {
+    _chunk = 0;
+    _offset = 0;
+  }
+
+  /**
+   * Gives the chunks back to the upstream resource
+   */
+  void release() noexcept
+  {
+    for (Chunk const& chunk : _chunks)
+    {
+      _upstream->deallocate(chunk.memory, chunk.size, alignof(std::max_align_t));
+    }
+
+    _chunks.clear();
+    rewind();
+  }
+
+  /**
+   * @return the size of the chunks taken from the upstream resource
+   */
+  [[nodiscard]] std::size_t capacity() const noexcept
+  {
+    std::size_t capacity{0};
+    for (Chunk const& chunk : _chunks)
+    {
+      capacity += chunk.size;
+    }
+    return capacity;
+  }
+
+  [[nodiscard]] std::size_t chunks() const noexcept { return _chunks.size(); }
+
+private:
+  struct Chunk
+  {
+    std::byte* memory;
+    std::size_t size;
+  };
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    for (;; ++_chunk, _offset = 0)
+    {
+      if (_chunk == _chunks.size())
+      {
+        _grow(bytes + alignment);
+      }
+
+      Chunk const& chunk = _chunks[_chunk];
+      auto const address = reinterpret_cast<std::uintptr_t>(chunk.memory) + _offset;
+      std::size_t const padding = (alignment - (address % alignment)) % alignment;
+
+      if (_offset + padding + bytes <= chunk.size)
+      {
+        _offset += padding + bytes;
+        return chunk.memory + (_offset - bytes);
+      }
+    }
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) noexcept override
+  {
+    // the memory is reused once the arena is rewound
+  }
+
+  [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  void _grow(std::size_t min_size)
+  {
+    std::size_t const size = std::max(_next_chunk_size, min_size);
+    auto* memory = static_cast<std::byte*>(_upstream->allocate(size, alignof(std::max_align_t)));
+    _chunks.push_back(Chunk{memory, size});
+    _next_chunk_size = size * 2;
+  }
+
+private:
+  std::pmr::memory_resource* _upstream;
+  std::size_t _next_chunk_size;
+
+  // the chunk and the offset in it of the next allocation
+  std::vector<Chunk> _chunks;
+  std::size_t _chunk{0};
+  std::size_t _offset{0};
+};
+
+/**
+ * Allocates from huge pages to save TLB misses on large backlogs and windows. Each allocation is
+ * its own mapping rounded up to the huge page size, so it is meant as the upstream of an Arena
+ * and not for small allocations. If no huge page is reserved (MAP_HUGETLB fails) the mapping
+ * uses normal pages with transparent huge pages requested.
+ */
+class HugePageResource : public std::pmr::memory_resource
+{
+public:
+  static constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+private:
+  [[nodiscard]] static std::size_t _mapping_size(std::size_t bytes) noexcept
+  {
+    return ((std::max<std::size_t>(bytes, 1) + huge_page_size - 1) / huge_page_size) * huge_page_size;
+  }
+
+  void* do_allocate(std::size_t bytes, std::size_t) override
+  {
+    std::size_t const size = _mapping_size(bytes);
+    void* memory{MAP_FAILED};
+
+#ifdef MAP_HUGETLB
+    memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if (memory == MAP_FAILED)
+    {
+      memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (memory == MAP_FAILED)
+      {
+        throw std::bad_alloc{};
+      }
+
+#ifdef MADV_HUGEPAGE
+      (void)::madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    return memory;
+  }
+
+  void do_deallocate(void* memory, std::size_t bytes, std::size_t) noexcept override
+  {
+    ::munmap(memory, _mapping_size(bytes));
+  }
+
+  [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+  {
+    return dynamic_cast<HugePageResource const*>(&other) != nullptr;
+  }
+};
+} // namespace ets
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+
+#include "BatchAdmission.h"
+#include "MessageStorage.h"
+#include "RingQueue.h"
+#include "SlidingWindow.h"
+
+namespace ets
+{
+/**
+ * A throttler for coroutines. `co_await throttler.send(message)` sends the message right away if
+ * the window admits it, otherwise the coroutine is suspended and resumed once the window admits
+ * the message, so a caller writes straight line code instead of rescheduling on the returned
+ * delay:
+ *
+ *   Task gateway(AsyncThrottler<OnSendCallback>& throttler)
+ *   {
+ *     co_await throttler.send(NewOrder{...});
+ *     co_await throttler.send(CancelOrder{...});
+ *   }
+ *
+ * The throttler is also the single threaded executor of the suspended coroutines. The event loop
+ * calls resume_admitted() when it is due, which reads the clock once, admits as many of the
+ * waiting coroutines as the window allows with one request per batch and resumes them in the
+ * order they were suspended. It returns the delay until the next waiting coroutine can be resumed, for
+ * the Scheduler of the loop, so there is no timer per message.
+ *
+ * The messages wait in the frames of their coroutines and the suspended coroutines in a ring, so
+ * a throttled message does not allocate once the ring has grown to the size of the backlog.
+ * A coroutine still suspended when the throttler is destroyed is never resumed, its owner has to
+ * destroy it.
+ *
+ * GCC 12 miscompiles aggregate temporaries created in a co_await expression, e.g.
+ * `co_await throttler.send(Order{name})` with an Order without constructor. Give such messages
+ * a constructor or create them before the co_await.
+ *
+ * @tparam TOnSendCallback the callback of the sent messages
+ * @tparam TWindow the rate limit policy, see SlidingWindow.h
+ */
+template <typename TOnSendCallback, typename TWindow = SlidingWindow<>>
+class AsyncThrottler
+{
+public:
+  using window_t = TWindow;
+  using clock_t = typename TWindow::clock_t;
+
+  /**
+   * The awaitable of send(). It holds an rvalue message by value and an lvalue by reference
+   */
+  template <typename TMessage>
+  class SendAwaitable
+  {
+  public:
+    SendAwaitable(AsyncThrottler& throttler, TMessage&& message)
+      : _throttler(throttler), _message(std::forward<TMessage>(message))
+    {
+    }
+
+    /**
+     * Sends without suspending if nobody is waiting and the window admits the message
+     */
+    [[nodiscard]] bool await_ready() { return _throttler._try_admit(); }
+
+    void await_suspend(std::coroutine_handle<> handle) { _throttler._waiting.push_back(handle); }
+
+    /**
+     * The window admitted the message, either in await_ready() or before the coroutine was resumed
+     */
+    void await_resume()
+    {
+      send_message(_throttler._on_send_callback, std::forward<TMessage>(_message));
+    }
+
+  private:
+    AsyncThrottler& _throttler;
+    TMessage _message;
+  };
+
+  AsyncThrottler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback)
+    : _window(max_messages, interval), _on_send_callback(std::move(on_send_callback))
+  {
+  }
+
+  /**
+   * Constructs a throttler using an already configured window
+   */
+  AsyncThrottler(TWindow window, TOnSendCallback on_send_callback)
+    : _window(std::move(window)), _on_send_callback(std::move(on_send_callback))
+  {
+  }
+
+  AsyncThrottler(AsyncThrottler const&) = delete;
+  AsyncThrottler& operator=(AsyncThrottler const&) = delete;
+
+  /**
+   * @return an awaitable that sends the message once the window admits it. The messages are
+   * sent in the order their coroutines awaited
+   */
+  template <typename TMessage>
+  [[nodiscard]] SendAwaitable<TMessage> send(TMessage&& message)
+  {
+    return SendAwaitable<TMessage>{*this, std::forward<TMessage>(message)};
+  }
+
+  /**
+   * Resumes the waiting coroutines that the window admits now, in batches of one window request.
+   * A resumed coroutine that awaits again waits behind the coroutines that were already waiting
+   * @return a zero delay if no coroutine is waiting, otherwise the delay until the next one can
+   * be resumed
+   */
+  [[nodiscard]] std::chrono::nanoseconds resume_admitted()
+  {
+    // a single clock read for everything that is due this tick
+    auto const now = clock_t::now();
+
+    while (!_waiting.empty())
+    {
+      BatchAdmission const result = _window.request_n(_waiting.size(), now);
+      if (result.admitted == 0)
+      {
+        return result.delay;
+      }
+
+      for (std::size_t i = 0; i < result.admitted; ++i)
+      {
+        std::coroutine_handle<> const handle = _waiting.front();
+        _waiting.pop_front();
+        handle.resume();
+      }
+
+      // the resumed coroutines might have awaited again, they get the rest of the window
+    }
+
+    return std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * @return number of suspended coroutines waiting for the window
+   */
+  [[nodiscard]] std::size_t waiting() const noexcept { return _waiting.size(); }
+
+private:
+  [[nodiscard]] bool _try_admit()
+  {
+    return _waiting.empty() && (_window.request(clock_t::now()).count() == 0);
+  }
+
+private:
+  TWindow _window;
+  TOnSendCallback _on_send_callback;
+  RingQueue<std::coroutine_handle<>> _waiting;
+};
+} // namespace ets
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace ets
+{
+/**
+ * The result of requesting to send a batch of messages at once
+ */
+struct BatchAdmission
+{
+  // how many messages from the front of the batch can be sent now
+  std::size_t admitted{0};
+
+  // 0 if the whole batch was admitted, otherwise the delay until the next message can be sent
+  std::chrono::nanoseconds delay{0};
+};
+} // namespace ets
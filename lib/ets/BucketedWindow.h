@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BatchAdmission.h"
+
+namespace ets
+{
+/**
+ * A sliding window that keeps a message counter per bucket instead of a timestamp per message,
+ * so its memory depends on the number of buckets and not on max_messages. It suits the long
+ * windows of layered limits, e.g. 2000 messages per minute in 60 buckets of one second.
+ *
+ * The messages of a bucket are counted as sent at the end of their bucket, so any interval never
+ * contains more than max_messages but a message can be delayed by up to one bucket width more
+ * than with SlidingWindow.
+ *
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h
+ */
+template <typename TClock = std::chrono::steady_clock>
+class BucketedWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  /**
+   * @param buckets number of buckets the interval is split into
+   */
+  BucketedWindow(std::size_t max_messages, std::chrono::nanoseconds interval, std::size_t buckets = 60)
+    : _max_messages(max_messages),
+      _buckets(std::max<std::size_t>(buckets, 1)),
+      _width(_width_of(interval, _buckets)),
+      _counts(_buckets + 1, 0)
+  {
+  }
+
+  /**
+   * Request to send a new message
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time
+   * @param now current time of TClock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    std::chrono::nanoseconds const delay = this->delay(now);
+    if (delay.count() == 0)
+    {
+      commit(1, now);
+    }
+
+    return delay;
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    BatchAdmission result;
+    result.admitted = admissible(n, now);
+    commit(result.admitted, now);
+
+    if (result.admitted < n)
+    {
+      result.delay = delay(now);
+    }
+
+    return result;
+  }
+
+  /**
+   * How long until one more message can be sent at the given time, without sending it
+   * @param now current time of TClock
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now)
+  {
+    int64_t const bucket = _advance(now);
+    if (_total < _max_messages)
+    {
+      return std::chrono::nanoseconds{0};
+    }
+
+    // find the bucket whose expiry brings the window below the limit. The oldest bucket in the
+    // window leaves it once the current bucket is `_buckets` ahead of it
+    uint64_t released{0};
+    int64_t oldest = bucket - static_cast<int64_t>(_buckets);
+    for (; oldest < bucket; ++oldest)
+    {
+      released += _counts[_slot_of(oldest)];
+      if (_total - released < _max_messages)
+      {
+        break;
+      }
+    }
+
+    int64_t const expiry = (oldest + static_cast<int64_t>(_buckets) + 1) * _width.count();
+    return std::chrono::nanoseconds{expiry - _ticks_of(now)};
+  }
+
+  /**
+   * @return how many of `n` messages can be sent at the given time, without sending them
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now)
+  {
+    (void)_advance(now);
+    return _total < _max_messages ? static_cast<std::size_t>(std::min<uint64_t>(n, _max_messages - _total)) : 0;
+  }
+
+  /**
+   * Records `n` messages sent at the given time
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now)
+  {
+    int64_t const bucket = _advance(now);
+    _counts[_slot_of(bucket)] += n;
+    _total += n;
+  }
+
+private:
+  [[nodiscard]] static std::chrono::nanoseconds _width_of(std::chrono::nanoseconds interval,
+                                                         std::size_t buckets) noexcept
+  {
+    // round up so the buckets cover at least the interval
+    auto const n = static_cast<std::chrono::nanoseconds::rep>(buckets);
+    return std::chrono::nanoseconds{std::max<std::chrono::nanoseconds::rep>((interval.count() + n - 1) / n, 1)};
+  }
+
+  [[nodiscard]] static int64_t _ticks_of(time_point now) noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+  }
+
+  [[nodiscard]] std::size_t _slot_of(int64_t bucket) const noexcept
+  {
+    auto const slots = static_cast<int64_t>(_counts.size());
+    return static_cast<std::size_t>(((bucket % slots) + slots) % slots);
+  }
+
+  /**
+   * Expires the buckets that left the window
+   * @return the bucket of the given time
+   */
+  int64_t _advance(time_point now)
+  {
+    int64_t const bucket = _ticks_of(now) / _width.count();
+    if (bucket <= _newest)
+    {
+      return _newest;
+    }
+
+    if (bucket - _newest >= static_cast<int64_t>(_counts.size()))
+    {
+      std::fill(_counts.begin(), _counts.end(), 0);
+      _total = 0;
+    }
+    else
+    {
+      for (int64_t expired = _newest + 1; expired <= bucket; ++expired)
+      {
+        uint64_t& count = _counts[_slot_of(expired)];
+        _total -= count;
+        count = 0;
+      }
+    }
+
+    _newest = bucket;
+    return bucket;
+  }
+
+private:
+  uint64_t _max_messages;
+  std::size_t _buckets;
+  std::chrono::nanoseconds _width;
+
+  // the current bucket and the `_buckets` before it, indexed by bucket modulo the size
+  std::vector<uint64_t> _counts;
+  uint64_t _total{0};
+  int64_t _newest{INT64_MIN / 2};
+};
+} // namespace ets
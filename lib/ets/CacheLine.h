@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+namespace ets
+{
+/**
+ * Size of a cache line, used to pad data written by different threads so they do not share a
+ * line. std::hardware_destructive_interference_size is not used as its value is not stable
+ * across compiler flags.
+ */
+inline constexpr std::size_t cache_line_size = 64;
+
+/**
+ * Pads a value to whole cache lines. An array of them, e.g. std::vector<CacheAligned<T>>, keeps
+ * each value from straddling two lines, so the hot state at the start of the value is a single
+ * line fill. Used for the sessions of a ThrottlerPool
+ */
+template <typename T>
+struct alignas(cache_line_size) CacheAligned
+{
+  template <typename... Args>
+  explicit CacheAligned(Args&&... args) : value(std::forward<Args>(args)...)
+  {
+  }
+
+  T value;
+};
+} // namespace ets
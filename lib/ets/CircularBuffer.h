@@ -1,19 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace ets
 {
+/**
+ * A circular buffer storing up to `N` items inline. If the capacity is known at compile time it
+ * avoids the heap and the wrap around branches of the runtime sized buffer below.
+ *
+ * The items are stored in a std::array of the next power of two and indexed by masking a
+ * counter of inserted items, so any `N` works. The oldest item is `N` items behind the counter.
+ */
+template <typename T, std::size_t N = std::dynamic_extent>
+class CircularBuffer
+{
+  static_assert(N > 0, "a circular buffer needs at least one item");
+
+public:
+  static constexpr std::size_t storage_size = std::bit_ceil(N);
+
+  /**
+   * Inserts a new item in the buffer
+   * @param item
+   */
+  void insert(T const& item) noexcept
+  {
+    _buffer[_inserted & mask] = item;
+    ++_inserted;
+  }
+
+  /**
+   * Inserts `n` copies of the same item in the buffer. The copies are written in at most two
+   * contiguous spans, the end of the storage and the start of the storage when wrapping around
+   * @param item
+   * @param n number of copies
+   */
+  void insert_n(T const& item, std::size_t n) noexcept
+  {
+    // only the last copies that fit in the storage are kept
+    std::size_t const writes = std::min(n, storage_size);
+    std::size_t const first = (_inserted + n - writes) & mask;
+    std::size_t const first_span = std::min(writes, storage_size - first);
+
+    std::fill_n(_buffer.begin() + static_cast<std::ptrdiff_t>(first), first_span, item);
+    std::fill_n(_buffer.begin(), writes - first_span, item);
+    _inserted += n;
+  }
+
+  /**
+   * Returns the oldest item in the buffer
+   * @return
+   */
+  [[nodiscard]] T const& back() const noexcept { return _buffer[_oldest() & mask]; }
+
+  /**
+   * Returns the i-th oldest item in the buffer, 0 is the same as back()
+   * @param i must be less than size()
+   */
+  [[nodiscard]] T const& operator[](std::size_t i) const noexcept { return _buffer[(_oldest() + i) & mask]; }
+
+  [[nodiscard]] bool is_full() const noexcept { return _inserted >= N; }
+
+  /**
+   * @return the number of items in the buffer
+   */
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return static_cast<std::size_t>(std::min<uint64_t>(_inserted, N));
+  }
+
+  /**
+   * @return the maximum number of items the buffer stores
+   */
+  [[nodiscard]] static constexpr std::size_t capacity() noexcept { return N; }
+
+  /**
+   * @return the items from the oldest as at most two contiguous spans, the second one is empty
+   * unless the items wrap around the end of the storage
+   */
+  [[nodiscard]] std::array<std::span<T const>, 2> segments() const noexcept
+  {
+    std::size_t const first = _oldest() & mask;
+    std::size_t const first_span = std::min(size(), storage_size - first);
+    return {std::span<T const>{_buffer.data() + first, first_span},
+            std::span<T const>{_buffer.data(), size() - first_span}};
+  }
+
+private:
+  static constexpr uint64_t mask = storage_size - 1;
+
+  /**
+   * @return the counter value of the oldest item
+   */
+  [[nodiscard]] uint64_t _oldest() const noexcept { return _inserted >= N ? _inserted - N : 0; }
+
+private:
+  std::array<T, storage_size> _buffer{};
+  uint64_t _inserted{0};
+};
+
 /**
  * A circular buffer class backed by a std::vector. 
  * Stores up to maximum `n` items in the buffer
  * We can insert an item or get the oldest item in the buffer. Inserting an item might
  * override the oldest item in the buffer
+ * The vector is allocated from a std::pmr::memory_resource, the default resource unless given
  */
 template<typename T>
-class CircularBuffer
+class CircularBuffer<T, std::dynamic_extent>
 {
 public:
-  explicit CircularBuffer(std::size_t n) { _buffer.resize(n); }
+  explicit CircularBuffer(std::size_t n, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : _buffer(n, resource)
+  {
+  }
 
   /**
    * Inserts a new item in the buffer
@@ -32,6 +140,38 @@ public:
     }
   }
 
+  /**
+   * Inserts `n` copies of the same item in the buffer. The copies are written in at most two
+   * contiguous spans, the end of the buffer and the start of the buffer when wrapping around
+   * @param item
+   * @param n number of copies
+   */
+  void insert_n(T const& item, std::size_t n) noexcept
+  {
+    if (n >= _buffer.size())
+    {
+      // every item is replaced, the oldest item is now at the start
+      std::fill(_buffer.begin(), _buffer.end(), item);
+      _index = 0;
+      _full = !_buffer.empty();
+      return;
+    }
+
+    std::size_t const first_span = std::min(n, _buffer.size() - _index);
+    std::fill_n(_buffer.begin() + static_cast<std::ptrdiff_t>(_index), first_span, item);
+    _index += first_span;
+
+    if (_index == _buffer.size())
+    {
+      _index = 0;
+      _full = true;
+    }
+
+    std::size_t const second_span = n - first_span;
+    std::fill_n(_buffer.begin(), second_span, item);
+    _index += second_span;
+  }
+
   /**
    * Returns the oldest item in the buffer
    * @return
@@ -43,11 +183,89 @@ public:
     return _full ? _buffer[_index] : _buffer[0];
   }
 
+  /**
+   * Returns the i-th oldest item in the buffer, 0 is the same as back()
+   * @param i must be less than size()
+   */
+  [[nodiscard]] T const& operator[](std::size_t i) const noexcept
+  {
+    if (!_full)
+    {
+      return _buffer[i];
+    }
+
+    std::size_t const pos = _index + i;
+    return pos < _buffer.size() ? _buffer[pos] : _buffer[pos - _buffer.size()];
+  }
+
   [[nodiscard]] bool is_full() const noexcept { return _full; }
 
+  /**
+   * @return the number of items in the buffer
+   */
+  [[nodiscard]] std::size_t size() const noexcept { return _full ? _buffer.size() : _index; }
+
+  /**
+   * @return the maximum number of items the buffer stores
+   */
+  [[nodiscard]] std::size_t capacity() const noexcept { return _buffer.size(); }
+
+  /**
+   * @return the items from the oldest as at most two contiguous spans, the second one is empty
+   * unless the items wrap around the end of the buffer
+   */
+  [[nodiscard]] std::array<std::span<T const>, 2> segments() const noexcept
+  {
+    if (!_full)
+    {
+      return {std::span<T const>{_buffer.data(), _index}, std::span<T const>{}};
+    }
+
+    return {std::span<T const>{_buffer.data() + _index, _buffer.size() - _index},
+            std::span<T const>{_buffer.data(), _index}};
+  }
+
+  /**
+   * Changes the capacity of the buffer. The newest items that fit in the new capacity are kept
+   * in the same order, the oldest ones are dropped
+   * @param n new capacity
+   */
+  void resize(std::size_t n)
+  {
+    std::size_t const kept = std::min(size(), n);
+    std::size_t const first = size() - kept;
+
+    std::pmr::vector<T> buffer(n, _buffer.get_allocator());
+    for (std::size_t i = 0; i < kept; ++i)
+    {
+      buffer[i] = (*this)[first + i];
+    }
+
+    _buffer = std::move(buffer);
+    _full = (kept == n) && (n > 0);
+    _index = _full ? 0 : kept;
+  }
+
 private:
-  std::vector<T> _buffer;
+  // the insert position first, then the storage pointers
   std::size_t _index{0};
   bool _full { false };
+  std::pmr::vector<T> _buffer;
 };
-} // namespace ets
\ No newline at end of file
+
+/**
+ * Counts the items greater than `value` with a binary search of each segment
+ * @param buffer its items must be sorted from the oldest, e.g. timestamps
+ */
+template <typename T, std::size_t N>
+[[nodiscard]] std::size_t count_greater(CircularBuffer<T, N> const& buffer, T const& value) noexcept
+{
+  std::size_t count{0};
+  for (std::span<T const> const segment : buffer.segments())
+  {
+    count += static_cast<std::size_t>(segment.end() - std::upper_bound(segment.begin(), segment.end(), value));
+  }
+
+  return count;
+}
+} // namespace ets
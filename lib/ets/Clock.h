@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #else
+    #include <x86intrin.h>
+  #endif
+  #define ETS_HAS_RDTSC 1
+#endif
+
+namespace ets
+{
+/**
+ * Clock policies for SlidingWindow and Throttler.
+ *
+ * Every clock here follows the std::chrono clock requirements, a static now() returning its own
+ * time_point, so std::chrono::steady_clock can also be used directly as a policy.
+ */
+
+/**
+ * A clock reading the time stamp counter. Much cheaper than steady_clock::now() which is a vDSO
+ * call. It is calibrated against steady_clock once, the first time it is used.
+ * Requires an invariant TSC, falls back to steady_clock on other architectures.
+ */
+class TscClock
+{
+public:
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<TscClock>;
+  static constexpr bool is_steady = true;
+
+  [[nodiscard]] static time_point now() noexcept
+  {
+#if defined(ETS_HAS_RDTSC)
+    Calibration const& calibration = _calibration();
+    auto const ticks = static_cast<double>(__rdtsc() - calibration.base_tsc);
+    return time_point{duration{calibration.base_ns + static_cast<rep>(ticks * calibration.ns_per_tick)}};
+#else
+    return time_point{std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+#endif
+  }
+
+  /**
+   * @return nanoseconds per tsc tick as measured during calibration
+   */
+  [[nodiscard]] static double ns_per_tick() noexcept
+  {
+#if defined(ETS_HAS_RDTSC)
+    return _calibration().ns_per_tick;
+#else
+    return 1.0;
+#endif
+  }
+
+private:
+#if defined(ETS_HAS_RDTSC)
+  struct Calibration
+  {
+    Calibration() noexcept
+    {
+      // measure the tsc frequency against steady_clock over a short interval
+      auto const start_time = std::chrono::steady_clock::now();
+      uint64_t const start_tsc = __rdtsc();
+
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+      auto const end_time = std::chrono::steady_clock::now();
+      uint64_t const end_tsc = __rdtsc();
+
+      auto const elapsed_ns = std::chrono::duration_cast<duration>(end_time - start_time).count();
+      ns_per_tick = static_cast<double>(elapsed_ns) / static_cast<double>(end_tsc - start_tsc);
+
+      // anchor to steady_clock so the time points have the same epoch
+      base_tsc = end_tsc;
+      base_ns = std::chrono::duration_cast<duration>(end_time.time_since_epoch()).count();
+    }
+
+    double ns_per_tick{1.0};
+    uint64_t base_tsc{0};
+    rep base_ns{0};
+  };
+
+  [[nodiscard]] static Calibration const& _calibration() noexcept
+  {
+    static Calibration const calibration;
+    return calibration;
+  }
+#endif
+};
+
+/**
+ * A clock returning a cached time point. The owning thread calls refresh() once per event loop
+ * iteration and every now() in the same iteration returns that time without reading a clock.
+ * The cached time is per thread.
+ */
+template <typename TSourceClock = std::chrono::steady_clock>
+class CoarseClock
+{
+public:
+  using duration = typename TSourceClock::duration;
+  using rep = typename TSourceClock::rep;
+  using period = typename TSourceClock::period;
+  using time_point = std::chrono::time_point<CoarseClock>;
+  static constexpr bool is_steady = TSourceClock::is_steady;
+
+  [[nodiscard]] static time_point now() noexcept { return _now; }
+
+  /**
+   * Reads the source clock and caches the time
+   * @return the new cached time
+   */
+  static time_point refresh() noexcept
+  {
+    _now = time_point{TSourceClock::now().time_since_epoch()};
+    return _now;
+  }
+
+private:
+  static inline thread_local time_point _now{TSourceClock::now().time_since_epoch()};
+};
+
+/**
+ * A clock that only moves when told to. Used for tests and simulations to drive time
+ * deterministically. The time is shared by all users of the clock.
+ */
+class ManualClock
+{
+public:
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock>;
+  static constexpr bool is_steady = true;
+
+  [[nodiscard]] static time_point now() noexcept { return _now; }
+
+  static void set(time_point now) noexcept { _now = now; }
+
+  static void advance(duration d) noexcept { _now += d; }
+
+private:
+  static inline time_point _now{};
+};
+} // namespace ets
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "FlatHashMap.h"
+#include "RingQueue.h"
+
+namespace ets
+{
+/**
+ * Coalescing policies of the throttler backlog.
+ *
+ * Without coalescing every throttled message is sent eventually. With OrderCoalescing the queued
+ * messages of the same order supersede each other, so obsolete messages do not use rate limit
+ * slots:
+ *  - an amend replaces in place a queued amend of the same order, and an amend of an order whose
+ *    new order is still queued is queued as well, even if the window has room for it
+ *  - a cancel drops the queued new order and amend of the same order. If the new order was still
+ *    queued the order never reached the venue, so the cancel is dropped as well
+ *
+ * The tiers still decide the order messages are sent in. An amend must not be sent before the
+ * new order it amends, so the tier of the amends has to be the tier of the new orders or a later
+ * one, e.g. PriorityMap<Tier<CancelOrder>, Tier<NewOrder>, Tier<AmendOrder>>. A PriorityThrottler
+ * with a priority map sending the amends first does not compile.
+ */
+struct NoCoalescing
+{
+  static constexpr bool enabled = false;
+
+  template <typename TPriorityMap>
+  static constexpr bool supports = true;
+};
+
+/**
+ * Coalesces the messages of the same order. Each of the message types has an `order_id` member
+ */
+template <typename TNewOrder, typename TAmendOrder, typename TCancelOrder>
+struct OrderCoalescing
+{
+  static constexpr bool enabled = true;
+
+  using new_order_t = TNewOrder;
+  using amend_order_t = TAmendOrder;
+  using cancel_order_t = TCancelOrder;
+  using id_t = std::remove_cvref_t<decltype(std::declval<TNewOrder const&>().order_id)>;
+
+  /**
+   * True if the priority map sends the new orders no later than the amends
+   */
+  template <typename TPriorityMap>
+  static constexpr bool supports =
+    TPriorityMap::template tier_of<TAmendOrder> >= TPriorityMap::template tier_of<TNewOrder>;
+
+  template <typename TMessage>
+  [[nodiscard]] static id_t id_of(TMessage const& message)
+  {
+    return message.order_id;
+  }
+};
+
+/**
+ * The index of the queued orders of a throttler in coalescing mode.
+ *
+ * Each queued message gets a sequence number in its tier, and the index maps the id of an order
+ * to the sequences of its queued new order and amend. The sequences of different tiers overlap,
+ * so each entry remembers which of the two it is. A superseded message is marked dead and
+ * skipped by the drain
+ */
+template <typename TId, std::size_t Tiers>
+class CoalescingIndex
+{
+public:
+  static constexpr uint64_t npos = UINT64_MAX;
+
+  /**
+   * What a queued message is to the index
+   */
+  enum class Kind : uint8_t
+  {
+    Other,
+    NewOrder,
+    Amend
+  };
+
+  struct PendingOrder
+  {
+    uint64_t new_order{npos};
+    uint64_t amend{npos};
+  };
+
+  /**
+   * Records a message pushed at the back of a tier
+   * @param kind whether the message is the new order or amend of the order id
+   * @return the sequence of the message
+   */
+  uint64_t push(std::size_t tier, TId const& id, Kind kind)
+  {
+    Backlog& backlog = _backlogs[tier];
+    backlog.messages.push_back(Entry{id, kind, true});
+    return backlog.popped + backlog.messages.size() - 1;
+  }
+
+  [[nodiscard]] PendingOrder& pending(TId const& id) { return *_pending.try_emplace(id).first; }
+
+  [[nodiscard]] PendingOrder* find(TId const& id) noexcept { return _pending.find(id); }
+
+  void erase(TId const& id) noexcept { _pending.erase(id); }
+
+  /**
+   * @return the index from the front of the tier of a queued message
+   */
+  [[nodiscard]] std::size_t index_of(std::size_t tier, uint64_t sequence) const noexcept
+  {
+    return static_cast<std::size_t>(sequence - _backlogs[tier].popped);
+  }
+
+  /**
+   * Marks a queued message as superseded
+   */
+  void kill(std::size_t tier, uint64_t sequence) noexcept
+  {
+    _backlogs[tier].messages[index_of(tier, sequence)].alive = false;
+  }
+
+  [[nodiscard]] bool is_alive(std::size_t tier, std::size_t i) const noexcept
+  {
+    return _backlogs[tier].messages[i].alive;
+  }
+
+  /**
+   * Removes the first n messages of a tier once they are sent or skipped
+   */
+  void pop_front(std::size_t tier, std::size_t n)
+  {
+    Backlog& backlog = _backlogs[tier];
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      Entry const& entry = backlog.messages[i];
+      if (!entry.alive || (entry.kind == Kind::Other))
+      {
+        continue;
+      }
+
+      PendingOrder* pending_order = _pending.find(entry.id);
+      if (pending_order == nullptr)
+      {
+        continue;
+      }
+
+      // only the field of this entry, the other one holds a sequence of another tier
+      uint64_t const sequence = backlog.popped + i;
+      uint64_t& field = entry.kind == Kind::NewOrder ? pending_order->new_order : pending_order->amend;
+      field = field == sequence ? npos : field;
+
+      if ((pending_order->new_order == npos) && (pending_order->amend == npos))
+      {
+        _pending.erase(entry.id);
+      }
+    }
+
+    backlog.messages.pop_front(n);
+    backlog.popped += n;
+  }
+
+  /**
+   * @return number of orders with a queued new order or amend
+   */
+  [[nodiscard]] std::size_t pending_orders() const noexcept { return _pending.size(); }
+
+private:
+  struct Entry
+  {
+    TId id;
+    Kind kind;
+    bool alive;
+  };
+
+  struct Backlog
+  {
+    RingQueue<Entry> messages;
+    uint64_t popped{0};
+  };
+
+  std::array<Backlog, Tiers> _backlogs;
+  FlatHashMap<TId, PendingOrder> _pending;
+};
+} // namespace ets
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "BatchAdmission.h"
+
+namespace ets
+{
+/**
+ * A rate limit made of several windows which must all admit a message, e.g. the layered limits
+ * of a venue of 20 messages per 10ms, 100 per second and 2000 per minute:
+ *
+ *   CompositeWindow<FixedSlidingWindow<20, std::chrono::milliseconds{10}>,
+ *                   SlidingWindow<>,
+ *                   BucketedWindow<>>
+ *     window{{}, {100, std::chrono::seconds{1}}, {2000, std::chrono::minutes{1}}};
+ *
+ * The windows are checked with a single clock read and a message is recorded in all of them or
+ * in none, so a window that rejects never leaves the others with a message that was not sent.
+ * The delay is the longest delay of the windows.
+ *
+ * Each window provides, on top of the SlidingWindow interface:
+ *   delay(now)           how long until one more message can be sent, without sending it
+ *   admissible(n, now)   how many of n messages can be sent, without sending them
+ *   commit(n, now)       records n admissible messages
+ *
+ * A CompositeWindow provides them too, so composites can be nested.
+ */
+template <typename TWindow, typename... TWindows>
+class CompositeWindow
+{
+public:
+  using clock_t = typename TWindow::clock_t;
+  using time_point = typename TWindow::time_point;
+
+  static_assert((std::is_same_v<clock_t, typename TWindows::clock_t> && ...),
+                "the windows must use the same clock so they share a single clock read");
+
+  explicit CompositeWindow(TWindow window, TWindows... windows)
+    : _windows(std::move(window), std::move(windows)...)
+  {
+  }
+
+  /**
+   * Request to send a new message
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(clock_t::now()); }
+
+  /**
+   * Request to send a new message at the given time
+   * @param now current time of the clock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    std::chrono::nanoseconds const delay = this->delay(now);
+    if (delay.count() == 0)
+    {
+      commit(1, now);
+    }
+
+    return delay;
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, clock_t::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of the clock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    BatchAdmission result;
+    result.admitted = admissible(n, now);
+    commit(result.admitted, now);
+
+    if (result.admitted < n)
+    {
+      result.delay = delay(now);
+    }
+
+    return result;
+  }
+
+  /**
+   * @return the longest delay of the windows until one more message can be sent
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now)
+  {
+    return std::apply([now](auto&... windows)
+                      { return std::max({std::chrono::nanoseconds{windows.delay(now)}...}); },
+                      _windows);
+  }
+
+  /**
+   * @return how many of `n` messages every window can send at the given time
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now)
+  {
+    return std::apply([n, now](auto&... windows) { return std::min({n, std::size_t{windows.admissible(n, now)}...}); },
+                      _windows);
+  }
+
+  /**
+   * Records `n` messages in every window
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now)
+  {
+    if (n > 0)
+    {
+      std::apply([n, now](auto&... windows) { (windows.commit(n, now), ...); }, _windows);
+    }
+  }
+
+  template <std::size_t Index>
+  [[nodiscard]] auto& window() noexcept
+  {
+    return std::get<Index>(_windows);
+  }
+
+  template <std::size_t Index>
+  [[nodiscard]] auto const& window() const noexcept
+  {
+    return std::get<Index>(_windows);
+  }
+
+private:
+  std::tuple<TWindow, TWindows...> _windows;
+};
+} // namespace ets
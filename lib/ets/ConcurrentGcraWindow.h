@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "BatchAdmission.h"
+#include "CacheLine.h"
+
+namespace ets
+{
+/**
+ * A GcraWindow that can be shared by many sender threads without a lock.
+ *
+ * The whole state is the theoretical arrival time, kept as an atomic count of nanoseconds and
+ * moved forward with a compare and swap. A failed swap means another sender was admitted in the
+ * meantime and the request is checked again against the new arrival time.
+ *
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h. It must be safe to
+ * call TClock::now() from every sender thread
+ */
+template <typename TClock = std::chrono::steady_clock>
+class ConcurrentGcraWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  ConcurrentGcraWindow(std::size_t max_messages, std::chrono::nanoseconds interval, std::size_t burst = 1)
+    : _emission_interval(_emission_interval_of(max_messages, interval)),
+      _tolerance(_emission_interval * static_cast<int64_t>(burst > 0 ? burst - 1 : 0))
+  {
+  }
+
+  ConcurrentGcraWindow(ConcurrentGcraWindow const&) = delete;
+  ConcurrentGcraWindow& operator=(ConcurrentGcraWindow const&) = delete;
+
+  /**
+   * Request to send a new message. Can be called by any thread
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time. Can be called by any thread
+   * @param now current time of TClock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    int64_t const now_ns = _to_ns(now);
+    int64_t tat = _tat.value.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+      // the theoretical arrival time can not be in the past, an idle limiter does not bank credit
+      int64_t const arrival = std::max(tat, now_ns);
+      int64_t const ahead = arrival - now_ns;
+
+      if (ahead > _tolerance)
+      {
+        // the message arrives too early, return when it will conform
+        return std::chrono::nanoseconds{ahead - _tolerance};
+      }
+
+      if (_tat.value.compare_exchange_weak(tat, arrival + _emission_interval, std::memory_order_relaxed))
+      {
+        return std::chrono::nanoseconds{0};
+      }
+    }
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read. Can be called by any thread
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time. Can be called by any thread
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    int64_t const now_ns = _to_ns(now);
+    int64_t tat = _tat.value.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+      int64_t const arrival = std::max(tat, now_ns);
+      int64_t const ahead = arrival - now_ns;
+
+      BatchAdmission result;
+      if (ahead <= _tolerance)
+      {
+        // each admitted message moves the arrival time one emission interval ahead
+        auto const conforming = static_cast<std::size_t>((_tolerance - ahead) / _emission_interval) + 1;
+        result.admitted = std::min(n, conforming);
+      }
+
+      int64_t const next_tat = arrival + _emission_interval * static_cast<int64_t>(result.admitted);
+
+      if (result.admitted < n)
+      {
+        result.delay = std::chrono::nanoseconds{next_tat - now_ns - _tolerance};
+      }
+
+      if ((result.admitted == 0) ||
+          _tat.value.compare_exchange_weak(tat, next_tat, std::memory_order_relaxed))
+      {
+        return result;
+      }
+    }
+  }
+
+  [[nodiscard]] std::chrono::nanoseconds emission_interval() const noexcept
+  {
+    return std::chrono::nanoseconds{_emission_interval};
+  }
+
+private:
+  struct alignas(cache_line_size) ArrivalTime
+  {
+    std::atomic<int64_t> value{std::numeric_limits<int64_t>::min()};
+  };
+
+  [[nodiscard]] static int64_t _to_ns(time_point tp) noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+  }
+
+  [[nodiscard]] static int64_t _emission_interval_of(std::size_t max_messages,
+                                                     std::chrono::nanoseconds interval) noexcept
+  {
+    // round up so we never go faster than the configured rate
+    auto const n = static_cast<int64_t>(std::max<std::size_t>(max_messages, 1));
+    return std::max<int64_t>((interval.count() + n - 1) / n, 1);
+  }
+
+private:
+  int64_t _emission_interval;
+  int64_t _tolerance;
+  ArrivalTime _tat;
+};
+} // namespace ets
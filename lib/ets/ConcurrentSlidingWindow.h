@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "BatchAdmission.h"
+#include "CacheLine.h"
+#include "TimestampRing.h"
+
+namespace ets
+{
+/**
+ * A SlidingWindow that can be shared by many sender threads without a lock, see TimestampRing
+ * for the algorithm.
+ *
+ * Senders read the clock before claiming, so under contention the timestamps are not strictly
+ * ordered, which shifts the window by at most the time between reading the clock and claiming.
+ *
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h. It must be safe to
+ * call TClock::now() from every sender thread
+ */
+template <typename TClock = std::chrono::steady_clock>
+class ConcurrentSlidingWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  ConcurrentSlidingWindow(std::size_t max_messages, std::chrono::nanoseconds interval)
+    : _slots(std::make_unique<TimestampRing::Slot[]>(std::max<std::size_t>(max_messages, 1))),
+      _ring(_sequence.value, _slots.get(), std::max<std::size_t>(max_messages, 1), interval)
+  {
+  }
+
+  ConcurrentSlidingWindow(ConcurrentSlidingWindow const&) = delete;
+  ConcurrentSlidingWindow& operator=(ConcurrentSlidingWindow const&) = delete;
+
+  /**
+   * Request to send a new message. Can be called by any thread
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time. Can be called by any thread
+   * @param now current time of TClock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    return request_n(1, now).delay;
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read. Can be called by any thread
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time. Can be called by any thread
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    return _ring.request_n(n, std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+  }
+
+private:
+  struct alignas(cache_line_size) Sequence
+  {
+    std::atomic<uint64_t> value{0};
+  };
+
+private:
+  Sequence _sequence;
+  std::unique_ptr<TimestampRing::Slot[]> _slots;
+  TimestampRing _ring;
+};
+} // namespace ets
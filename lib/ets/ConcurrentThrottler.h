@@ -0,0 +1,198 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "BatchAdmission.h"
+#include "ConcurrentGcraWindow.h"
+#include "ConcurrentSlidingWindow.h"
+#include "MessageStorage.h"
+#include "MpscQueue.h"
+
+namespace ets
+{
+/**
+ * A Throttler that many sender threads can use at once, e.g. every gateway thread admitting its
+ * orders directly instead of passing them to a single processor thread.
+ *
+ * The admission path is lock free: the window is a ConcurrentSlidingWindow or a
+ * ConcurrentGcraWindow, and throttled messages are pushed to bounded lock free queues with the
+ * same priority tiers as Throttler. The queued messages are sent by a single drain thread calling
+ * send_queued_messages().
+ *
+ * A sender that gets a non zero delay must make sure the drain thread runs after that delay,
+ * e.g. by scheduling it on a Scheduler. The backlog has a fixed capacity, when it is full the
+ * sender yields until the drain thread makes room.
+ *
+ * The callback is called from the sender threads and from the drain thread, so it must be thread
+ * safe. The rest messages are stored according to the TRestStorage policy, see MessageStorage.h
+ */
+template <typename THighPriorityMessage, typename TOnSendCallback, typename TRestStorage = TypeErasedStorage,
+          typename TWindow = ConcurrentSlidingWindow<>>
+class ConcurrentThrottler
+{
+public:
+  using window_t = TWindow;
+  using clock_t = typename TWindow::clock_t;
+
+  /**
+   * @param backlog_capacity maximum number of queued messages of each tier
+   */
+  ConcurrentThrottler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback,
+                      std::size_t backlog_capacity = 65536)
+    : _on_send_callback(on_send_callback),
+      sw(max_messages, interval),
+      _high_priority_messages(backlog_capacity),
+      _rest_messages(backlog_capacity)
+  {
+  }
+
+  /**
+   * Constructs a throttler using an already configured window, e.g. a SharedSlidingWindow. Only
+   * for movable windows, see the in place constructor for the others
+   * @param backlog_capacity maximum number of queued messages of each tier
+   */
+  ConcurrentThrottler(TWindow window, TOnSendCallback on_send_callback, std::size_t backlog_capacity = 65536)
+    requires std::is_move_constructible_v<TWindow>
+    : _on_send_callback(on_send_callback),
+      sw(std::move(window)),
+      _high_priority_messages(backlog_capacity),
+      _rest_messages(backlog_capacity)
+  {
+  }
+
+  /**
+   * Constructs the window in place from `window_args`, e.g. a ConcurrentGcraWindow with a burst.
+   * The concurrent windows can not be moved
+   * @param backlog_capacity maximum number of queued messages of each tier
+   */
+  template <typename... Args>
+  ConcurrentThrottler(std::in_place_t, TOnSendCallback on_send_callback, std::size_t backlog_capacity,
+                      Args&&... window_args)
+    : _on_send_callback(on_send_callback),
+      sw(std::forward<Args>(window_args)...),
+      _high_priority_messages(backlog_capacity),
+      _rest_messages(backlog_capacity)
+  {
+  }
+
+  /**
+   * Tries to send a new message. Can be called by any thread
+   * @tparam TMessage
+   * @param message
+   * @return 0 if the message was sent, otherwise the delay until the next message can be send
+   */
+  template <typename TMessage>
+  [[nodiscard]] std::chrono::nanoseconds try_send_message(TMessage const& message)
+  {
+    std::chrono::nanoseconds const delay = sw.request();
+    if (delay.count() == 0)
+    {
+      _on_send_callback.on_send(message);
+      return std::chrono::nanoseconds{0};
+    }
+
+    _store_message(message);
+    return delay;
+  }
+
+  /**
+   * Tries to send a batch of messages with a single request to the window. Can be called by any
+   * thread
+   * @tparam TMessage
+   * @param messages
+   * @return how many messages were sent and the delay until the next message can be send
+   */
+  template <typename TMessage, std::size_t Extent>
+  [[nodiscard]] BatchAdmission try_send_batch(std::span<TMessage, Extent> messages)
+  {
+    BatchAdmission const result = sw.request_n(messages.size());
+
+    for (std::size_t i = 0; i < result.admitted; ++i)
+    {
+      _on_send_callback.on_send(messages[i]);
+    }
+
+    for (std::size_t i = result.admitted; i < messages.size(); ++i)
+    {
+      _store_message(messages[i]);
+    }
+
+    return result;
+  }
+
+  /**
+   * Send any messages in the queue. Must only be called by the drain thread
+   * @return a zero delay means we have send all the messages, an non zero delay means we still
+   * need to schedule to send more messages later
+   */
+  [[nodiscard]] std::chrono::nanoseconds send_queued_messages()
+  {
+    // read the clock once for the whole drain
+    auto const now = clock_t::now();
+
+    std::chrono::nanoseconds delay = _send_queued_messages(
+      now, _high_priority_messages, [this](THighPriorityMessage& message) { _on_send_callback.on_send(message); });
+
+    if (delay.count() == 0)
+    {
+      delay = _send_queued_messages(now, _rest_messages, [this](rest_element_t& element)
+                                    { TRestStorage::send_element(element, _on_send_callback); });
+    }
+
+    return delay;
+  }
+
+private:
+  using rest_element_t = typename TRestStorage::template element_t<TOnSendCallback>;
+
+  template <typename TMessage>
+  void _store_message(TMessage const& message)
+  {
+    if constexpr (std::is_same_v<TMessage, THighPriorityMessage>)
+    {
+      _high_priority_messages.push(THighPriorityMessage{message});
+    }
+    else
+    {
+      _rest_messages.push(TRestStorage::template make_element<TOnSendCallback>(message));
+    }
+  }
+
+  template <typename TElement, typename TSend>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_messages(typename clock_t::time_point now,
+                                                               MpscQueue<TElement>& queue, TSend send)
+  {
+    std::chrono::nanoseconds delay{0};
+
+    // the senders may keep pushing while we drain, stop at the first message not published yet
+    while (TElement* element = queue.front())
+    {
+      delay = sw.request(now);
+
+      if (delay.count() != 0)
+      {
+        break;
+      }
+
+      send(*element);
+      queue.pop();
+    }
+
+    return delay;
+  }
+
+protected:
+  // protected to access for testing
+  TOnSendCallback _on_send_callback;
+
+private:
+  TWindow sw;
+
+  MpscQueue<THighPriorityMessage> _high_priority_messages;
+  MpscQueue<rest_element_t> _rest_messages;
+};
+} // namespace ets
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ets
+{
+/**
+ * Mixes the bits of a 64 bit key, so consecutive ids land far apart on a ConsistentHashRing
+ */
+[[nodiscard]] constexpr uint64_t mix_hash(uint64_t key) noexcept
+{
+  // the splitmix64 finalizer
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
+/**
+ * Assigns keys to nodes by consistent hashing.
+ *
+ * Each node is placed at `virtual_nodes` points of a 64 bit ring and a key belongs to the node of
+ * the first point at or after the hash of the key. With enough virtual nodes the keys spread
+ * evenly, and adding or removing a node only moves the keys of the points it gains or loses,
+ * about 1 / nodes of them, instead of reshuffling every key as `hash % nodes` does.
+ *
+ * The points are kept sorted in a vector, so a lookup is a binary search over
+ * nodes * virtual_nodes points.
+ */
+class ConsistentHashRing
+{
+public:
+  /**
+   * @param nodes number of nodes, at least one, they are numbered from 0
+   * @param virtual_nodes number of points of each node on the ring
+   */
+  explicit ConsistentHashRing(std::size_t nodes, std::size_t virtual_nodes = 64) : _virtual_nodes(virtual_nodes)
+  {
+    for (std::size_t node = 0; node < nodes; ++node)
+    {
+      add_node(static_cast<uint32_t>(node));
+    }
+  }
+
+  /**
+   * Places the node on the ring, it takes over the keys just before its points
+   */
+  void add_node(uint32_t node)
+  {
+    for (std::size_t i = 0; i < _virtual_nodes; ++i)
+    {
+      _points.push_back(Point{mix_hash((static_cast<uint64_t>(node) << 32) | i), node});
+    }
+
+    std::sort(_points.begin(), _points.end());
+  }
+
+  /**
+   * Removes the node from the ring, its keys go to the nodes of the following points
+   */
+  void remove_node(uint32_t node)
+  {
+    _points.erase(std::remove_if(_points.begin(), _points.end(), [node](Point const& point) { return point.node == node; }),
+                  _points.end());
+  }
+
+  /**
+   * @return the node of an already hashed key, see mix_hash(). The ring must not be empty
+   */
+  [[nodiscard]] uint32_t node_of(uint64_t hash) const noexcept
+  {
+    auto it = std::lower_bound(_points.begin(), _points.end(), hash,
+                               [](Point const& point, uint64_t value) { return point.hash < value; });
+
+    // wrap around to the first point
+    return (it != _points.end()) ? it->node : _points.front().node;
+  }
+
+  [[nodiscard]] std::size_t points() const noexcept { return _points.size(); }
+
+private:
+  struct Point
+  {
+    uint64_t hash;
+    uint32_t node;
+
+    [[nodiscard]] bool operator<(Point const& other) const noexcept
+    {
+      return (hash < other.hash) || ((hash == other.hash) && (node < other.node));
+    }
+  };
+
+  std::size_t _virtual_nodes;
+  std::vector<Point> _points;
+};
+} // namespace ets
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "RingQueue.h"
+#include "SlidingWindow.h"
+
+namespace ets
+{
+/**
+ * Expiry policies of the throttler backlog.
+ *
+ * Without expiry every throttled message is sent eventually. With an expiry policy each queued
+ * message gets a deadline, the time it was queued plus its time to live, and the drain releases
+ * the messages past their deadline without using a rate limit slot. The callback is told with
+ * on_expire(message) if it has such an overload, see expire_queued_message() in MessageStorage.h.
+ *
+ * A policy provides:
+ *   enabled        true to keep the deadlines
+ *   ttl(message)   the time to live of a message, never_expires if it can wait forever
+ *
+ * so the time to live can be per type, see ExpiryByType, or per message, e.g. read from a field
+ * of the order:
+ *
+ *   struct OrderExpiry
+ *   {
+ *     static constexpr bool enabled = true;
+ *     static std::chrono::nanoseconds ttl(NewOrder const& order) { return order.time_in_force; }
+ *     static std::chrono::nanoseconds ttl(auto const&) { return never_expires; }
+ *   };
+ */
+inline constexpr std::chrono::nanoseconds never_expires = std::chrono::nanoseconds::max();
+
+struct NoExpiry
+{
+  static constexpr bool enabled = false;
+};
+
+/**
+ * The time to live of a message type, see ExpiryByType
+ */
+template <typename TMessage, FixedInterval Ttl>
+struct TtlOf
+{
+  using message_t = TMessage;
+  static constexpr std::chrono::nanoseconds ttl{Ttl.ns};
+
+  static_assert(ttl.count() > 0, "the time to live must be positive");
+};
+
+/**
+ * A time to live per message type, the types not listed never expire:
+ *   ExpiryByType<TtlOf<NewOrder, std::chrono::milliseconds{50}>, TtlOf<AmendOrder, std::chrono::milliseconds{20}>>
+ */
+template <typename... TTtls>
+struct ExpiryByType
+{
+  static constexpr bool enabled = true;
+
+  template <typename TMessage>
+  [[nodiscard]] static constexpr std::chrono::nanoseconds ttl(TMessage const&) noexcept
+  {
+    std::chrono::nanoseconds ttl{never_expires};
+    (void)((std::is_same_v<TMessage, typename TTtls::message_t> ? (ttl = TTtls::ttl, true) : false) || ...);
+    return ttl;
+  }
+};
+
+/**
+ * The deadlines of the queued messages of a throttler with an expiry policy, one queue per tier
+ * in the order of the messages of the tier. The deadlines are in nanoseconds since the epoch of
+ * the throttler clock
+ */
+template <std::size_t Tiers>
+class ExpiryIndex
+{
+public:
+  /**
+   * @return the deadline of a message queued at `now` with a time to live of `ttl`
+   */
+  [[nodiscard]] static constexpr int64_t deadline_of(int64_t now, std::chrono::nanoseconds ttl) noexcept
+  {
+    return ttl.count() >= INT64_MAX - now ? INT64_MAX : now + ttl.count();
+  }
+
+  /**
+   * Records the deadline of a message pushed at the back of a tier
+   */
+  void push(std::size_t tier, int64_t deadline) { _deadlines[tier].push_back(deadline); }
+
+  /**
+   * Sets the deadline of the i-th message from the front of a tier, e.g. of a message replaced by
+   * a newer one
+   */
+  void set(std::size_t tier, std::size_t i, int64_t deadline) noexcept { _deadlines[tier][i] = deadline; }
+
+  /**
+   * @return true if the i-th message from the front of the tier is past its deadline
+   */
+  [[nodiscard]] bool is_expired(std::size_t tier, std::size_t i, int64_t now) const noexcept
+  {
+    return _deadlines[tier][i] <= now;
+  }
+
+  /**
+   * @return how many of the first `n` messages of the tier come before the first expired one
+   */
+  [[nodiscard]] std::size_t live_prefix(std::size_t tier, std::size_t n, int64_t now) const noexcept
+  {
+    RingQueue<int64_t> const& deadlines = _deadlines[tier];
+    std::size_t live{0};
+    while ((live < n) && (deadlines[live] > now))
+    {
+      ++live;
+    }
+    return live;
+  }
+
+  /**
+   * Removes the first n messages of a tier once they are sent or released
+   */
+  void pop_front(std::size_t tier, std::size_t n) noexcept { _deadlines[tier].pop_front(n); }
+
+private:
+  std::array<RingQueue<int64_t>, Tiers> _deadlines;
+};
+} // namespace ets
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ets
+{
+/**
+ * An open addressing hash map with linear probing storing the items inline in a single vector.
+ *
+ * Erasing shifts the following items of the probe sequence back instead of leaving tombstones,
+ * so lookups never degrade after many inserts and erases. The capacity is a power of two and
+ * the hash is mixed with a multiplicative constant, so identity hashes of integer keys spread
+ * evenly.
+ *
+ * Pointers to values are invalidated by any insert or erase.
+ */
+template <typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TKeyEqual = std::equal_to<TKey>>
+class FlatHashMap
+{
+public:
+  explicit FlatHashMap(std::size_t initial_capacity = 16) { _rehash(_round_up(initial_capacity)); }
+
+  /**
+   * @return the value of the key or nullptr if the key is not in the map
+   */
+  [[nodiscard]] TValue* find(TKey const& key) noexcept
+  {
+    for (std::size_t pos = _home(key);; pos = (pos + 1) & _mask)
+    {
+      auto& slot = _slots[pos];
+      if (!slot)
+      {
+        return nullptr;
+      }
+
+      if (TKeyEqual{}(slot->first, key))
+      {
+        return &slot->second;
+      }
+    }
+  }
+
+  [[nodiscard]] TValue const* find(TKey const& key) const noexcept
+  {
+    return const_cast<FlatHashMap*>(this)->find(key);
+  }
+
+  /**
+   * Inserts a new value constructed from args if the key is not in the map
+   * @return the value of the key and true if it was inserted
+   */
+  template <typename... Args>
+  std::pair<TValue*, bool> try_emplace(TKey const& key, Args&&... args)
+  {
+    if (TValue* value = find(key))
+    {
+      return {value, false};
+    }
+
+    // keep the load factor under 3/4
+    if ((_size + 1) * 4 > _slots.size() * 3)
+    {
+      _rehash(_slots.size() * 2);
+    }
+
+    std::size_t pos = _home(key);
+    while (_slots[pos])
+    {
+      pos = (pos + 1) & _mask;
+    }
+
+    _slots[pos].emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+    _size += 1;
+    return {&_slots[pos]->second, true};
+  }
+
+  /**
+   * @return true if the key was in the map and got erased
+   */
+  bool erase(TKey const& key) noexcept
+  {
+    for (std::size_t pos = _home(key);; pos = (pos + 1) & _mask)
+    {
+      auto& slot = _slots[pos];
+      if (!slot)
+      {
+        return false;
+      }
+
+      if (TKeyEqual{}(slot->first, key))
+      {
+        _erase_at(pos);
+        return true;
+      }
+    }
+  }
+
+  /**
+   * Erases every item for which pred(key, value) returns true
+   * @return number of erased items
+   */
+  template <typename TPred>
+  std::size_t erase_if(TPred pred)
+  {
+    std::size_t erased{0};
+
+    for (std::size_t pos = 0; pos < _slots.size();)
+    {
+      auto& slot = _slots[pos];
+      if (slot && pred(static_cast<TKey const&>(slot->first), slot->second))
+      {
+        // an item further in the probe sequence might have moved here, check this slot again
+        _erase_at(pos);
+        erased += 1;
+      }
+      else
+      {
+        ++pos;
+      }
+    }
+
+    return erased;
+  }
+
+  /**
+   * Calls func(key, value) for every item
+   */
+  template <typename TFunc>
+  void for_each(TFunc func)
+  {
+    for (auto& slot : _slots)
+    {
+      if (slot)
+      {
+        func(static_cast<TKey const&>(slot->first), slot->second);
+      }
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return _size; }
+  [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+  [[nodiscard]] std::size_t capacity() const noexcept { return _slots.size(); }
+
+private:
+  [[nodiscard]] static std::size_t _round_up(std::size_t capacity) noexcept
+  {
+    std::size_t rounded{2};
+    while (rounded < capacity)
+    {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  [[nodiscard]] std::size_t _home(TKey const& key) const noexcept
+  {
+    // fibonacci hashing, keep the high bits of the product
+    auto const hash = static_cast<uint64_t>(THash{}(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(hash >> _shift);
+  }
+
+  void _erase_at(std::size_t hole) noexcept
+  {
+    _slots[hole].reset();
+    _size -= 1;
+
+    // shift back any following item that probed past the hole
+    for (std::size_t pos = (hole + 1) & _mask; _slots[pos]; pos = (pos + 1) & _mask)
+    {
+      std::size_t const home = _home(_slots[pos]->first);
+
+      // the item can move to the hole if its home is not cyclically in (hole, pos]
+      bool const home_after_hole = hole <= pos ? (hole < home && home <= pos) : (hole < home || home <= pos);
+      if (!home_after_hole)
+      {
+        _slots[hole] = std::move(_slots[pos]);
+        _slots[pos].reset();
+        hole = pos;
+      }
+    }
+  }
+
+  void _rehash(std::size_t capacity)
+  {
+    std::vector<std::optional<std::pair<TKey, TValue>>> old_slots(capacity);
+    old_slots.swap(_slots);
+
+    _mask = capacity - 1;
+    _shift = 64;
+    for (std::size_t c = capacity; c > 1; c >>= 1)
+    {
+      --_shift;
+    }
+
+    for (auto& slot : old_slots)
+    {
+      if (slot)
+      {
+        std::size_t pos = _home(slot->first);
+        while (_slots[pos])
+        {
+          pos = (pos + 1) & _mask;
+        }
+        _slots[pos] = std::move(slot);
+      }
+    }
+  }
+
+private:
+  std::vector<std::optional<std::pair<TKey, TValue>>> _slots;
+  std::size_t _size{0};
+  std::size_t _mask{0};
+  uint32_t _shift{64};
+};
+} // namespace ets
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "BatchAdmission.h"
+
+namespace ets
+{
+/**
+ * A rate limiter using the generic cell rate algorithm. It has the same contract as
+ * SlidingWindow but stores a single theoretical arrival time instead of a timestamp per message,
+ * so its memory does not depend on max_messages.
+ *
+ * Messages are admitted at one per emission interval (interval / max_messages) with a
+ * tolerance of `burst` messages sent back to back. With the default burst of 1 the messages are
+ * evenly spaced and any interval never contains more than max_messages, which is the same limit
+ * as SlidingWindow but without bursts. A larger burst approximates the sliding window burst
+ * behaviour but then an interval can contain up to max_messages + burst - 1 messages.
+ *
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h
+ */
+template <typename TClock = std::chrono::steady_clock>
+class GcraWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  GcraWindow(std::size_t max_messages, std::chrono::nanoseconds interval, std::size_t burst = 1)
+    : _burst(burst),
+      _emission_interval(_emission_interval_of(max_messages, interval)),
+      _tolerance(_tolerance_of(_emission_interval, _burst))
+  {
+  }
+
+  /**
+   * Request to send a new message
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time
+   * @param now current time of TClock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
+  {
+    // the theoretical arrival time can not be in the past, an idle limiter does not bank credit
+    time_point const tat = std::max(_tat, now);
+    auto const ahead = std::chrono::duration_cast<std::chrono::nanoseconds>(tat - now);
+
+    if (ahead > _tolerance)
+    {
+      // the message arrives too early, return when it will conform
+      return ahead - _tolerance;
+    }
+
+    _tat = tat + _emission_interval;
+
+    return std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    BatchAdmission result;
+    result.admitted = admissible(n, now);
+    commit(result.admitted, now);
+
+    if (result.admitted < n)
+    {
+      result.delay = delay(now);
+    }
+
+    return result;
+  }
+
+  /**
+   * How long until one more message can be sent at the given time, without sending it.
+   * delay(), admissible() and commit() let a caller check several windows before sending, see
+   * CompositeWindow.h
+   * @param now current time of TClock
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now) const noexcept
+  {
+    auto const ahead = std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(_tat, now) - now);
+    return ahead > _tolerance ? ahead - _tolerance : std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * @return how many of `n` messages can be sent at the given time, without sending them
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now) const noexcept
+  {
+    auto const ahead = std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(_tat, now) - now);
+    if (ahead > _tolerance)
+    {
+      return 0;
+    }
+
+    // each admitted message moves the arrival time one emission interval ahead
+    auto const conforming = static_cast<std::size_t>((_tolerance - ahead) / _emission_interval) + 1;
+    return std::min(n, conforming);
+  }
+
+  /**
+   * Records `n` messages sent at the given time
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now) noexcept
+  {
+    _tat = std::max(_tat, now) + _emission_interval * static_cast<std::chrono::nanoseconds::rep>(n);
+  }
+
+  [[nodiscard]] std::chrono::nanoseconds emission_interval() const noexcept { return _emission_interval; }
+
+  /**
+   * Changes the rate keeping the burst. The arrival time of the messages already sent is kept,
+   * so a lower rate applies from the next message
+   * @param max_messages new max number of messages per interval
+   * @param interval new interval
+   */
+  void set_limit(std::size_t max_messages, std::chrono::nanoseconds interval) noexcept
+  {
+    _emission_interval = _emission_interval_of(max_messages, interval);
+    _tolerance = _tolerance_of(_emission_interval, _burst);
+  }
+
+private:
+  [[nodiscard]] static std::chrono::nanoseconds _tolerance_of(std::chrono::nanoseconds emission_interval,
+                                                              std::size_t burst) noexcept
+  {
+    return emission_interval * static_cast<std::chrono::nanoseconds::rep>(burst > 0 ? burst - 1 : 0);
+  }
+
+  [[nodiscard]] static std::chrono::nanoseconds _emission_interval_of(std::size_t max_messages,
+                                                                      std::chrono::nanoseconds interval) noexcept
+  {
+    // round up so we never go faster than the configured rate
+    auto const n = static_cast<std::chrono::nanoseconds::rep>(std::max<std::size_t>(max_messages, 1));
+    return std::chrono::nanoseconds{std::max<std::chrono::nanoseconds::rep>((interval.count() + n - 1) / n, 1)};
+  }
+
+private:
+  std::size_t _burst;
+  std::chrono::nanoseconds _emission_interval;
+  std::chrono::nanoseconds _tolerance;
+  time_point _tat{};
+};
+} // namespace ets
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+#include "FlatHashMap.h"
+#include "GcraWindow.h"
+#include "MessageStorage.h"
+#include "RingQueue.h"
+
+namespace ets
+{
+/**
+ * A message throttler enforcing a separate rate limit per key, e.g. per client or per session.
+ *
+ * The window of each key is created lazily the first time a message is sent for the key and
+ * kept in a flat hash map together with a few bytes of state. Keys that have been idle can be
+ * evicted. By default every key uses a GcraWindow so the state per key is constant whatever the
+ * limit is.
+ *
+ * Throttled messages are queued per key with the same priority tiers as Throttler, and the keys
+ * with queued messages are kept in a list. A drain only visits those keys and stops at the first
+ * throttled message of each, so it costs one window request per sent message plus one per
+ * throttled key whatever the depth of their backlogs. The order of the messages of each key is
+ * kept, and a throttled key does not block the messages of other keys.
+ *
+ * The callback is called with the key and the message: on_send(key, message)
+ */
+template <typename TKey, typename THighPriorityMessage, typename TOnSendCallback,
+          typename TRestStorage = TypeErasedStorage, typename TWindow = GcraWindow<>, typename THash = std::hash<TKey>>
+class KeyedThrottler
+{
+public:
+  using window_t = TWindow;
+  using clock_t = typename TWindow::clock_t;
+  using time_point = typename clock_t::time_point;
+
+  KeyedThrottler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback)
+    : _on_send_callback(on_send_callback), _max_messages(max_messages), _interval(interval)
+  {
+  }
+
+  /**
+   * Tries to send a new message for the key. If the message is throttled then returns the delay
+   * until the window of the key allows the next message. The message is also queued while the key
+   * has queued messages
+   * @return 0 if the message was sent, otherwise the delay until the next message can be send
+   */
+  template <typename TMessage>
+  [[nodiscard]] std::chrono::nanoseconds try_send_message(TKey const& key, TMessage const& message)
+  {
+    auto const now = clock_t::now();
+    KeyState& state = _key_state(key);
+    state.last_used = now;
+
+    std::chrono::nanoseconds delay{0};
+    if (state.queued == 0)
+    {
+      delay = state.window.request(now);
+      if (delay.count() == 0)
+      {
+        _on_send_callback.on_send(key, message);
+        return std::chrono::nanoseconds{0};
+      }
+    }
+    else
+    {
+      // the message must not overtake the queued messages of its key, even if the window has room
+      delay = std::max(state.window.delay(now), std::chrono::nanoseconds{1});
+    }
+
+    if (!state.backlog)
+    {
+      state.backlog = std::make_unique<Backlog>();
+    }
+
+    if (state.queued == 0)
+    {
+      _backlogged_keys.push_back(key);
+    }
+
+    state.queued += 1;
+    _queued_messages += 1;
+
+    if constexpr (std::is_same_v<TMessage, THighPriorityMessage>)
+    {
+      state.backlog->high_priority_messages.push_back(message);
+    }
+    else
+    {
+      state.backlog->rest_messages.push(message);
+    }
+
+    return delay;
+  }
+
+  /**
+   * Send any messages in the backlog whose key allows it
+   * @return a zero delay means we have send all the messages, a non zero delay is the earliest
+   * time any of the remaining messages can be sent
+   */
+  [[nodiscard]] std::chrono::nanoseconds send_queued_messages()
+  {
+    auto const now = clock_t::now();
+    std::chrono::nanoseconds min_delay{0};
+
+    for (std::size_t remaining = _backlogged_keys.size(); remaining != 0; --remaining)
+    {
+      TKey const& key = _backlogged_keys.front();
+
+      // a key with queued messages is never evicted
+      std::chrono::nanoseconds const delay = _send_queued_messages(now, key, *_keys.find(key));
+
+      if (delay.count() == 0)
+      {
+        _backlogged_keys.pop_front();
+      }
+      else
+      {
+        min_delay = (min_delay.count() == 0) ? delay : std::min(min_delay, delay);
+        _backlogged_keys.rotate_front();
+      }
+    }
+
+    return min_delay;
+  }
+
+  /**
+   * Removes the state of the keys that did not send any message for `idle_time` and have
+   * no queued messages. The idle time should be at least the interval of the limit, so an
+   * evicted key had no message in its window
+   * @return number of evicted keys
+   */
+  std::size_t evict_idle(std::chrono::nanoseconds idle_time)
+  {
+    auto const now = clock_t::now();
+    return _keys.erase_if([now, idle_time](TKey const&, KeyState const& state)
+                          { return (state.queued == 0) && (now - state.last_used >= idle_time); });
+  }
+
+  /**
+   * @return number of keys with state
+   */
+  [[nodiscard]] std::size_t keys() const noexcept { return _keys.size(); }
+
+  /**
+   * @return number of messages in the backlog of all keys
+   */
+  [[nodiscard]] std::size_t queued_messages() const noexcept { return _queued_messages; }
+
+protected:
+  // protected to access for testing
+  TOnSendCallback _on_send_callback;
+
+private:
+  /**
+   * Adapts the keyed callback for the rest storage which calls on_send(message)
+   */
+  struct KeyedSend
+  {
+    template <typename TMessage>
+    void on_send(TMessage const& message)
+    {
+      on_send_callback.on_send(key, message);
+    }
+
+    TOnSendCallback& on_send_callback;
+    TKey const& key;
+  };
+
+  /**
+   * The queued messages of a key
+   */
+  struct Backlog
+  {
+    RingQueue<THighPriorityMessage> high_priority_messages;
+    typename TRestStorage::template container<KeyedSend> rest_messages;
+  };
+
+  struct KeyState
+  {
+    KeyState(std::size_t max_messages, std::chrono::nanoseconds interval) : window(max_messages, interval) {}
+
+    TWindow window;
+    time_point last_used{};
+    std::size_t queued{0};
+
+    // allocated the first time the key is throttled and kept until the key is evicted, so the
+    // keys that are never throttled only hold a pointer
+    std::unique_ptr<Backlog> backlog;
+  };
+
+  [[nodiscard]] KeyState& _key_state(TKey const& key)
+  {
+    return *_keys.try_emplace(key, _max_messages, _interval).first;
+  }
+
+  /**
+   * Sends the queued messages of a key, the high priority ones first, until its window is full
+   * @return 0 if the backlog of the key was sent, otherwise the delay until its window has room
+   */
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_messages(time_point now, TKey const& key, KeyState& state)
+  {
+    Backlog& backlog = *state.backlog;
+
+    while (state.queued != 0)
+    {
+      std::chrono::nanoseconds const delay = state.window.request(now);
+      if (delay.count() != 0)
+      {
+        return delay;
+      }
+
+      if (!backlog.high_priority_messages.empty())
+      {
+        _on_send_callback.on_send(key, backlog.high_priority_messages.front());
+        backlog.high_priority_messages.pop_front();
+      }
+      else
+      {
+        KeyedSend keyed_send{_on_send_callback, key};
+        backlog.rest_messages.send(0, keyed_send);
+        backlog.rest_messages.pop_front(1);
+      }
+
+      state.queued -= 1;
+      state.last_used = now;
+      _queued_messages -= 1;
+    }
+
+    return std::chrono::nanoseconds{0};
+  }
+
+private:
+  std::size_t _max_messages;
+  std::chrono::nanoseconds _interval;
+
+  FlatHashMap<TKey, KeyState, THash> _keys;
+
+  // each key with queued messages once
+  RingQueue<TKey> _backlogged_keys;
+  std::size_t _queued_messages{0};
+};
+} // namespace ets
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "Arena.h"
+#include "RingQueue.h"
+
+namespace ets
+{
+/**
+ * Storage policies for the messages that the Throttler queues when they get throttled.
+ *
+ * Each policy describes how a single queued message is held:
+ *   element_t<TOnSendCallback>                 the type holding one message
+ *   make_element<TOnSendCallback>(message)     creates the element of a message
+ *   send_element(element, callback)            calls callback.on_send() with the message
+ *
+ * and provides a `container` template taking the send callback type. A container stores
+ * messages in the order they are pushed and sends them later from the front of the queue.
+ * It is default constructible, or constructible from the std::pmr::memory_resource it allocates
+ * from. It provides:
+ *   push(message)                  store a message at the back, moved from an rvalue
+ *   emplace<TMessage>(args...)     construct a message in place at the back
+ *   send(i, callback)              call callback.on_send() for the i-th message from the front
+ *   expire(i, callback)            call callback.on_expire() for the i-th message from the front,
+ *                                  see expire_queued_message()
+ *   replace(i, message)            replace the i-th message from the front
+ *   visit(i, visitor)              call visitor(message) for the i-th message, only if the
+ *                                  container knows the message types
+ *   send_batch(n, callback)        call callback.on_send_batch() with the first n messages, only
+ *                                  if the container stores a single type contiguously and the
+ *                                  callback accepts batches of it
+ *   pop_front(n)                   remove the first n messages
+ *   rotate_front()                 move the front message to the back
+ *   size(), empty()
+ *
+ * A queued message is released once it is sent, so it is passed to the callback with
+ * send_queued_message() which moves it if the callback accepts an rvalue.
+ */
+
+/**
+ * Calls callback.on_send() with a message. An rvalue is moved to the callback if it has an
+ * on_send overload taking one, otherwise the callback gets a const reference as usual
+ */
+template <typename TOnSendCallback, typename TMessage>
+void send_message(TOnSendCallback& on_send_callback, TMessage&& message)
+{
+  if constexpr (!std::is_lvalue_reference_v<TMessage> &&
+                requires { on_send_callback.on_send(std::move(message)); })
+  {
+    on_send_callback.on_send(std::move(message));
+  }
+  else
+  {
+    on_send_callback.on_send(std::as_const(message));
+  }
+}
+
+/**
+ * True if the callback can take several messages at once as on_send_batch(std::span<TMessage
+ * const>), e.g. to write them with a single writev() or sendmmsg()
+ */
+template <typename TOnSendCallback, typename TMessage>
+inline constexpr bool accepts_batches =
+  requires(TOnSendCallback& on_send_callback, std::span<TMessage const> messages) {
+    on_send_callback.on_send_batch(messages);
+  };
+
+/**
+ * Sends a queued message that is released right after
+ */
+template <typename TOnSendCallback, typename TMessage>
+void send_queued_message(TOnSendCallback& on_send_callback, TMessage& message)
+{
+  send_message(on_send_callback, std::move(message));
+}
+
+/**
+ * Calls callback.on_expire() with a queued message that is released without sending because its
+ * deadline passed, see Expiry.h. Nothing is called if the callback has no on_expire overload for
+ * the message. The message is moved as it is released right after
+ */
+template <typename TOnSendCallback, typename TMessage>
+void expire_queued_message(TOnSendCallback& on_send_callback, TMessage& message)
+{
+  if constexpr (requires { on_send_callback.on_expire(std::move(message)); })
+  {
+    on_send_callback.on_expire(std::move(message));
+  }
+}
+
+/**
+ * Accepts any message type. Each message is copied to the heap and later sent via a virtual
+ * function. This costs an allocation per throttled message.
+ */
+struct TypeErasedStorage
+{
+  template <typename TOnSendCallback>
+  class StoredMessageBase
+  {
+  public:
+    virtual ~StoredMessageBase() = default;
+    virtual void send(TOnSendCallback& on_send_callback) = 0;
+    virtual void expire(TOnSendCallback& on_send_callback) = 0;
+
+    /**
+     * Destroys the message and gives its memory back to the resource it was allocated from
+     */
+    virtual void release(std::pmr::memory_resource* resource) noexcept = 0;
+  };
+
+  template <typename TOnSendCallback, typename TMessage>
+  class StoredMessage : public StoredMessageBase<TOnSendCallback>
+  {
+  public:
+    template <typename... Args>
+    explicit StoredMessage(std::in_place_t, Args&&... args) : _message(std::forward<Args>(args)...)
+    {
+    }
+
+    void send(TOnSendCallback& on_send_callback) override { send_queued_message(on_send_callback, _message); }
+
+    void expire(TOnSendCallback& on_send_callback) override { expire_queued_message(on_send_callback, _message); }
+
+    void release(std::pmr::memory_resource* resource) noexcept override
+    {
+      std::destroy_at(this);
+      resource->deallocate(this, sizeof(StoredMessage), alignof(StoredMessage));
+    }
+
+  private:
+    TMessage _message;
+  };
+
+  /**
+   * Creates a message in memory of the resource
+   */
+  template <typename TOnSendCallback, typename TMessage, typename... Args>
+  [[nodiscard]] static StoredMessageBase<TOnSendCallback>* allocate_element(std::pmr::memory_resource* resource,
+                                                                            Args&&... args)
+  {
+    using stored_t = StoredMessage<TOnSendCallback, TMessage>;
+    void* memory = resource->allocate(sizeof(stored_t), alignof(stored_t));
+    try
+    {
+      return ::new (memory) stored_t(std::in_place, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      resource->deallocate(memory, sizeof(stored_t), alignof(stored_t));
+      throw;
+    }
+  }
+
+  template <typename TOnSendCallback>
+  using element_t = std::unique_ptr<StoredMessageBase<TOnSendCallback>>;
+
+  template <typename TOnSendCallback, typename TMessage>
+  [[nodiscard]] static element_t<TOnSendCallback> make_element(TMessage&& message)
+  {
+    return emplace_element<TOnSendCallback, std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+  }
+
+  template <typename TOnSendCallback, typename TMessage, typename... Args>
+  [[nodiscard]] static element_t<TOnSendCallback> emplace_element(Args&&... args)
+  {
+    return std::make_unique<StoredMessage<TOnSendCallback, TMessage>>(std::in_place, std::forward<Args>(args)...);
+  }
+
+  template <typename TOnSendCallback>
+  static void send_element(element_t<TOnSendCallback>& element, TOnSendCallback& on_send_callback)
+  {
+    element->send(on_send_callback);
+  }
+
+  /**
+   * Releases a message of a container to the resource of the container
+   */
+  template <typename TOnSendCallback>
+  struct Releaser
+  {
+    void operator()(StoredMessageBase<TOnSendCallback>* message) const noexcept { message->release(resource); }
+
+    std::pmr::memory_resource* resource;
+  };
+
+  template <typename TOnSendCallback>
+  class container
+  {
+  public:
+    container() = default;
+
+    explicit container(std::pmr::memory_resource* resource) : _messages(16, resource) {}
+
+    template <typename TMessage>
+    void push(TMessage&& message)
+    {
+      emplace<std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+    }
+
+    template <typename TMessage, typename... Args>
+    void emplace(Args&&... args)
+    {
+      _messages.push_back(_element<TMessage>(std::forward<Args>(args)...));
+    }
+
+    void send(std::size_t i, TOnSendCallback& on_send_callback) { _messages[i]->send(on_send_callback); }
+
+    void expire(std::size_t i, TOnSendCallback& on_send_callback) { _messages[i]->expire(on_send_callback); }
+
+    template <typename TMessage>
+    void replace(std::size_t i, TMessage&& message)
+    {
+      _messages[i] = _element<std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+    }
+
+    void pop_front(std::size_t n) noexcept { _messages.pop_front(n); }
+
+    void rotate_front() { _messages.rotate_front(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return _messages.size(); }
+    [[nodiscard]] bool empty() const noexcept { return _messages.empty(); }
+
+  private:
+    using element_t = std::unique_ptr<StoredMessageBase<TOnSendCallback>, Releaser<TOnSendCallback>>;
+
+    template <typename TMessage, typename... Args>
+    [[nodiscard]] element_t _element(Args&&... args)
+    {
+      std::pmr::memory_resource* resource = _messages.resource();
+      return element_t{allocate_element<TOnSendCallback, TMessage>(resource, std::forward<Args>(args)...),
+                       Releaser<TOnSendCallback>{resource}};
+    }
+
+  private:
+    RingQueue<element_t> _messages;
+  };
+};
+
+/**
+ * Accepts any message type like TypeErasedStorage, but the messages are allocated from an arena
+ * of the container instead of the heap. Queueing a message bumps a pointer, and the arena is
+ * rewound in O(1) whenever the backlog empties, so a backlog that drains regularly reuses the
+ * same memory and never allocates once the arena has grown to the size of the burst. The memory
+ * of a sent message is only reused once the whole backlog was sent, so a backlog that never
+ * empties keeps growing the arena.
+ *
+ * The arena takes its chunks from the resource of the container, e.g. a HugePageResource, see
+ * Arena.h
+ */
+struct ArenaStorage
+{
+  template <typename TOnSendCallback>
+  class container
+  {
+  public:
+    container() : container(std::pmr::get_default_resource()) {}
+
+    explicit container(std::pmr::memory_resource* resource) : _arena(resource), _messages(16, resource) {}
+
+    container(container&&) noexcept = default;
+
+    ~container() { pop_front(size()); }
+
+    template <typename TMessage>
+    void push(TMessage&& message)
+    {
+      emplace<std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+    }
+
+    template <typename TMessage, typename... Args>
+    void emplace(Args&&... args)
+    {
+      _messages.push_back(
+        TypeErasedStorage::allocate_element<TOnSendCallback, TMessage>(&_arena, std::forward<Args>(args)...));
+    }
+
+    void send(std::size_t i, TOnSendCallback& on_send_callback) { _messages[i]->send(on_send_callback); }
+
+    void expire(std::size_t i, TOnSendCallback& on_send_callback) { _messages[i]->expire(on_send_callback); }
+
+    template <typename TMessage>
+    void replace(std::size_t i, TMessage&& message)
+    {
+      _messages[i]->release(&_arena);
+      _messages[i] = TypeErasedStorage::allocate_element<TOnSendCallback, std::remove_cvref_t<TMessage>>(
+        &_arena, std::forward<TMessage>(message));
+    }
+
+    void pop_front(std::size_t n) noexcept
+    {
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        _messages[i]->release(&_arena);
+      }
+      _messages.pop_front(n);
+
+      if (_messages.empty())
+      {
+        // nothing lives in the arena anymore
+        _arena.rewind();
+      }
+    }
+
+    void rotate_front() { _messages.rotate_front(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return _messages.size(); }
+    [[nodiscard]] bool empty() const noexcept { return _messages.empty(); }
+
+    [[nodiscard]] Arena const& arena() const noexcept { return _arena; }
+
+  private:
+    Arena _arena;
+    RingQueue<TypeErasedStorage::StoredMessageBase<TOnSendCallback>*> _messages;
+  };
+};
+
+/**
+ * Accepts only the listed message types. The messages are stored in place as a std::variant in
+ * the queue, so queueing a message never allocates once the queue has grown to the size of the
+ * backlog, and sending is a std::visit instead of a virtual call.
+ */
+template <typename... TMessages>
+struct VariantStorage
+{
+  template <typename TOnSendCallback>
+  using element_t = std::variant<TMessages...>;
+
+  template <typename TOnSendCallback, typename TMessage>
+  [[nodiscard]] static element_t<TOnSendCallback> make_element(TMessage&& message)
+  {
+    return emplace_element<TOnSendCallback, std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+  }
+
+  template <typename TOnSendCallback, typename TMessage, typename... Args>
+  [[nodiscard]] static element_t<TOnSendCallback> emplace_element(Args&&... args)
+  {
+    static_assert((std::is_same_v<TMessage, TMessages> || ...),
+                  "message type is not in the VariantStorage message list");
+    return element_t<TOnSendCallback>{std::in_place_type<TMessage>, std::forward<Args>(args)...};
+  }
+
+  template <typename TOnSendCallback>
+  static void send_element(std::variant<TMessages...>& element, TOnSendCallback& on_send_callback)
+  {
+    std::visit([&on_send_callback](auto& message) { send_queued_message(on_send_callback, message); }, element);
+  }
+
+  template <typename TOnSendCallback>
+  class container
+  {
+  public:
+    container() = default;
+
+    explicit container(std::pmr::memory_resource* resource) : _messages(16, resource) {}
+
+    template <typename TMessage>
+    void push(TMessage&& message)
+    {
+      emplace<std::remove_cvref_t<TMessage>>(std::forward<TMessage>(message));
+    }
+
+    template <typename TMessage, typename... Args>
+    void emplace(Args&&... args)
+    {
+      static_assert((std::is_same_v<TMessage, TMessages> || ...),
+                    "message type is not in the VariantStorage message list");
+      _messages.emplace_back(std::in_place_type<TMessage>, std::forward<Args>(args)...);
+    }
+
+    void send(std::size_t i, TOnSendCallback& on_send_callback) { send_element(_messages[i], on_send_callback); }
+
+    void expire(std::size_t i, TOnSendCallback& on_send_callback)
+    {
+      std::visit([&on_send_callback](auto& message) { expire_queued_message(on_send_callback, message); },
+                 _messages[i]);
+    }
+
+    template <typename TMessage>
+    void replace(std::size_t i, TMessage&& message)
+    {
+      using message_t = std::remove_cvref_t<TMessage>;
+      static_assert((std::is_same_v<message_t, TMessages> || ...),
+                    "message type is not in the VariantStorage message list");
+      _messages[i].template emplace<message_t>(std::forward<TMessage>(message));
+    }
+
+    template <typename TVisitor>
+    void visit(std::size_t i, TVisitor& visitor) const
+    {
+      std::visit(visitor, _messages[i]);
+    }
+
+    void pop_front(std::size_t n) noexcept { _messages.pop_front(n); }
+
+    void rotate_front() { _messages.rotate_front(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return _messages.size(); }
+    [[nodiscard]] bool empty() const noexcept { return _messages.empty(); }
+
+  private:
+    RingQueue<std::variant<TMessages...>> _messages;
+  };
+};
+} // namespace ets
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "RingQueue.h"
+
+namespace ets
+{
+/**
+ * Instrumentation policies of the throttler.
+ *
+ * A policy provides a `recorder` template taking the number of priority tiers. The throttler
+ * owns one recorder and calls it on its hot path:
+ *   on_admitted(n)            n messages were sent without being queued
+ *   on_queued(tier, now)      a message was queued in a tier
+ *   on_sent(tier, now)        the oldest queued message of a tier was sent
+ *   on_dropped(tier)          the oldest queued message of a tier was released without sending
+ *   on_coalesced(tier)        a message of a tier was superseded, see Coalescing.h
+ *   on_expired(tier)          the oldest queued message of a tier was released past its deadline,
+ *                             see Expiry.h
+ *
+ * `now` is in nanoseconds since the epoch of the throttler clock.
+ */
+
+/**
+ * No instrumentation, every call compiles to nothing
+ */
+struct NoMetrics
+{
+  template <std::size_t Tiers>
+  struct recorder
+  {
+    void on_admitted(std::size_t) noexcept {}
+    void on_queued(std::size_t, int64_t) {}
+    void on_sent(std::size_t, int64_t) noexcept {}
+    void on_dropped(std::size_t) noexcept {}
+    void on_coalesced(std::size_t) noexcept {}
+    void on_expired(std::size_t) noexcept {}
+  };
+};
+
+/**
+ * A histogram of durations with a relative error of 1/16 at any magnitude, like a HDR histogram
+ * with one significant hex digit. Values below 16 ns have their own bucket, each next power of
+ * two range is split into 16 buckets.
+ *
+ * One thread records, any thread can take a snapshot. The buckets are relaxed atomics so a
+ * snapshot taken while recording may be off by the values recorded meanwhile.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr std::size_t sub_bucket_bits = 4;
+  static constexpr std::size_t sub_buckets = std::size_t{1} << sub_bucket_bits;
+  static constexpr std::size_t buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+  struct Snapshot
+  {
+    std::array<uint64_t, buckets> counts{};
+    uint64_t count{0};
+    uint64_t max{0};
+    uint64_t sum{0};
+
+    /**
+     * @param quantile between 0 and 1, e.g. 0.99
+     * @return the highest duration in the bucket of the quantile
+     */
+    [[nodiscard]] std::chrono::nanoseconds value_at(double quantile) const noexcept
+    {
+      if (count == 0)
+      {
+        return std::chrono::nanoseconds{0};
+      }
+
+      auto const rank = static_cast<uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+      uint64_t seen{0};
+      for (std::size_t i = 0; i < buckets; ++i)
+      {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+          return std::chrono::nanoseconds{static_cast<int64_t>(std::min(highest_of(i), max))};
+        }
+      }
+
+      return std::chrono::nanoseconds{static_cast<int64_t>(max)};
+    }
+
+    [[nodiscard]] std::chrono::nanoseconds mean() const noexcept
+    {
+      return std::chrono::nanoseconds{count == 0 ? 0 : static_cast<int64_t>(sum / count)};
+    }
+  };
+
+  [[nodiscard]] static std::size_t index_of(uint64_t value) noexcept
+  {
+    if (value < sub_buckets)
+    {
+      return static_cast<std::size_t>(value);
+    }
+
+    // the highest bit selects the range and the next bits the bucket within the range
+    auto const shift = static_cast<std::size_t>(std::bit_width(value)) - 1 - sub_bucket_bits;
+    return (shift + 1) * sub_buckets + static_cast<std::size_t>((value >> shift) & (sub_buckets - 1));
+  }
+
+  /**
+   * @return the lowest value of a bucket
+   */
+  [[nodiscard]] static uint64_t lowest_of(std::size_t index) noexcept
+  {
+    if (index < sub_buckets)
+    {
+      return index;
+    }
+
+    std::size_t const shift = index / sub_buckets - 1;
+    return (sub_buckets + index % sub_buckets) << shift;
+  }
+
+  /**
+   * @return the highest value of a bucket
+   */
+  [[nodiscard]] static uint64_t highest_of(std::size_t index) noexcept
+  {
+    return index + 1 == buckets ? UINT64_MAX : lowest_of(index + 1) - 1;
+  }
+
+  /**
+   * Records a duration. Must only be called by a single thread
+   */
+  void record(std::chrono::nanoseconds duration) noexcept
+  {
+    auto const value = static_cast<uint64_t>(duration.count() < 0 ? 0 : duration.count());
+
+    _increment(_counts[index_of(value)], 1);
+    _increment(_sum, value);
+
+    if (value > _max.load(std::memory_order_relaxed))
+    {
+      _max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Can be called by any thread
+   */
+  [[nodiscard]] Snapshot snapshot() const noexcept
+  {
+    Snapshot snapshot;
+    for (std::size_t i = 0; i < buckets; ++i)
+    {
+      snapshot.counts[i] = _counts[i].load(std::memory_order_relaxed);
+      snapshot.count += snapshot.counts[i];
+    }
+
+    snapshot.max = _max.load(std::memory_order_relaxed);
+    snapshot.sum = _sum.load(std::memory_order_relaxed);
+    return snapshot;
+  }
+
+private:
+  static void _increment(std::atomic<uint64_t>& counter, uint64_t value) noexcept
+  {
+    // a single writer, a plain load and store is enough and avoids a locked instruction
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, buckets> _counts{};
+  std::atomic<uint64_t> _sum{0};
+  std::atomic<uint64_t> _max{0};
+};
+
+/**
+ * Counters per tier, queue depth high water marks and a histogram of the time messages wait in
+ * the backlog before they are sent.
+ *
+ * The throttler thread writes relaxed atomics without locked instructions, a monitoring thread
+ * reads them with snapshot() without perturbing the throttler.
+ */
+struct AtomicMetrics
+{
+  struct TierSnapshot
+  {
+    uint64_t queued{0};
+    uint64_t sent{0};
+    uint64_t dropped{0};
+    uint64_t coalesced{0};
+    uint64_t expired{0};
+    uint64_t depth{0};
+    uint64_t max_depth{0};
+  };
+
+  template <std::size_t Tiers>
+  struct Snapshot
+  {
+    uint64_t admitted{0};
+    std::array<TierSnapshot, Tiers> tiers{};
+    LatencyHistogram::Snapshot wait;
+
+    /**
+     * @return number of messages that were throttled
+     */
+    [[nodiscard]] uint64_t throttled() const noexcept
+    {
+      uint64_t throttled{0};
+      for (TierSnapshot const& tier : tiers)
+      {
+        throttled += tier.queued;
+      }
+      return throttled;
+    }
+  };
+
+  template <std::size_t Tiers>
+  class recorder
+  {
+  public:
+    void on_admitted(std::size_t n) noexcept { _increment(_admitted, n); }
+
+    void on_queued(std::size_t tier, int64_t now)
+    {
+      TierCounters& counters = _tiers[tier];
+      _increment(counters.queued, 1);
+
+      uint64_t const depth = counters.depth.load(std::memory_order_relaxed) + 1;
+      counters.depth.store(depth, std::memory_order_relaxed);
+      if (depth > counters.max_depth.load(std::memory_order_relaxed))
+      {
+        counters.max_depth.store(depth, std::memory_order_relaxed);
+      }
+
+      _queued_at[tier].push_back(now);
+    }
+
+    void on_sent(std::size_t tier, int64_t now) noexcept
+    {
+      _increment(_tiers[tier].sent, 1);
+      _wait.record(std::chrono::nanoseconds{now - _release(tier)});
+    }
+
+    void on_dropped(std::size_t tier) noexcept
+    {
+      _increment(_tiers[tier].dropped, 1);
+      (void)_release(tier);
+    }
+
+    void on_coalesced(std::size_t tier) noexcept { _increment(_tiers[tier].coalesced, 1); }
+
+    void on_expired(std::size_t tier) noexcept
+    {
+      _increment(_tiers[tier].expired, 1);
+      (void)_release(tier);
+    }
+
+    /**
+     * Can be called by any thread
+     */
+    [[nodiscard]] Snapshot<Tiers> snapshot() const noexcept
+    {
+      Snapshot<Tiers> snapshot;
+      snapshot.admitted = _admitted.load(std::memory_order_relaxed);
+
+      for (std::size_t i = 0; i < Tiers; ++i)
+      {
+        TierCounters const& counters = _tiers[i];
+        TierSnapshot& tier = snapshot.tiers[i];
+        tier.queued = counters.queued.load(std::memory_order_relaxed);
+        tier.sent = counters.sent.load(std::memory_order_relaxed);
+        tier.dropped = counters.dropped.load(std::memory_order_relaxed);
+        tier.coalesced = counters.coalesced.load(std::memory_order_relaxed);
+        tier.expired = counters.expired.load(std::memory_order_relaxed);
+        tier.depth = counters.depth.load(std::memory_order_relaxed);
+        tier.max_depth = counters.max_depth.load(std::memory_order_relaxed);
+      }
+
+      snapshot.wait = _wait.snapshot();
+      return snapshot;
+    }
+
+  private:
+    struct TierCounters
+    {
+      std::atomic<uint64_t> queued{0};
+      std::atomic<uint64_t> sent{0};
+      std::atomic<uint64_t> dropped{0};
+      std::atomic<uint64_t> coalesced{0};
+      std::atomic<uint64_t> expired{0};
+      std::atomic<uint64_t> depth{0};
+      std::atomic<uint64_t> max_depth{0};
+    };
+
+    static void _increment(std::atomic<uint64_t>& counter, uint64_t value) noexcept
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Removes the oldest queued message of a tier
+     * @return the time it was queued
+     */
+    int64_t _release(std::size_t tier) noexcept
+    {
+      TierCounters& counters = _tiers[tier];
+      counters.depth.store(counters.depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+
+      int64_t const queued_at = _queued_at[tier].front();
+      _queued_at[tier].pop_front();
+      return queued_at;
+    }
+
+  private:
+    std::atomic<uint64_t> _admitted{0};
+    std::array<TierCounters, Tiers> _tiers;
+    LatencyHistogram _wait;
+
+    // only used by the throttler thread, the backlogs are in order so the front is the oldest
+    std::array<RingQueue<int64_t>, Tiers> _queued_at;
+  };
+};
+} // namespace ets
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "CacheLine.h"
+
+namespace ets
+{
+/**
+ * A bounded lock free multi producer single consumer queue.
+ *
+ * Items are constructed in place in a ring of power of two capacity. Each cell carries a
+ * sequence number that tells producers when the cell is free and the consumer when the item
+ * in it is ready, so producers only contend on the tail counter and never take a lock.
+ * The consumer drains the ready items in batches.
+ */
+template <typename T>
+class MpscQueue
+{
+public:
+  explicit MpscQueue(std::size_t capacity)
+  {
+    std::size_t rounded_capacity{2};
+    while (rounded_capacity < capacity)
+    {
+      rounded_capacity <<= 1;
+    }
+
+    _mask = rounded_capacity - 1;
+    _cells = std::make_unique<Cell[]>(rounded_capacity);
+
+    for (std::size_t i = 0; i < rounded_capacity; ++i)
+    {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(MpscQueue const&) = delete;
+  MpscQueue& operator=(MpscQueue const&) = delete;
+
+  ~MpscQueue()
+  {
+    // destroy any items that were never consumed
+    consume([](T&) {});
+  }
+
+  /**
+   * Tries to construct a new item at the back of the queue. Can be called by any thread
+   * @return false if the queue is full
+   */
+  template <typename... Args>
+  [[nodiscard]] bool try_emplace(Args&&... args)
+  {
+    std::size_t pos = _tail.value.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    while (true)
+    {
+      cell = &_cells[pos & _mask];
+      std::size_t const sequence = cell->sequence.load(std::memory_order_acquire);
+      auto const dif = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+
+      if (dif == 0)
+      {
+        // the cell is free, try to claim it
+        if (_tail.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (dif < 0)
+      {
+        // the consumer did not release this cell yet, the queue is full
+        return false;
+      }
+      else
+      {
+        // another producer claimed this cell, reload the tail
+        pos = _tail.value.load(std::memory_order_relaxed);
+      }
+    }
+
+    ::new (static_cast<void*>(cell->storage)) T(std::forward<Args>(args)...);
+
+    // publish the item to the consumer
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+  /**
+   * Pushes a new item, yields the thread while the queue is full. Can be called by any thread
+   */
+  void push(T&& item)
+  {
+    while (!try_emplace(std::move(item)))
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * Consumes up to max_items ready items in order. Must only be called by the consumer thread
+   * @param func invoked with a reference to each item, the item is destroyed after the call
+   * @param max_items maximum items to consume in this batch
+   * @return number of consumed items
+   */
+  template <typename TFunc>
+  std::size_t consume(TFunc&& func, std::size_t max_items = SIZE_MAX)
+  {
+    std::size_t consumed{0};
+
+    while (consumed < max_items)
+    {
+      Cell& cell = _cells[_head.value & _mask];
+
+      if (cell.sequence.load(std::memory_order_acquire) != _head.value + 1)
+      {
+        // the next item is not published yet
+        break;
+      }
+
+      T* item = std::launder(reinterpret_cast<T*>(cell.storage));
+      func(*item);
+      std::destroy_at(item);
+
+      // release the cell to the producers for the next lap
+      cell.sequence.store(_head.value + _mask + 1, std::memory_order_release);
+      _head.value += 1;
+      ++consumed;
+    }
+
+    return consumed;
+  }
+
+  /**
+   * @return the next ready item or nullptr if there is none. The item stays in the queue until
+   * pop() is called. Must only be called by the consumer thread
+   */
+  [[nodiscard]] T* front() noexcept
+  {
+    Cell& cell = _cells[_head.value & _mask];
+
+    if (cell.sequence.load(std::memory_order_acquire) != _head.value + 1)
+    {
+      return nullptr;
+    }
+
+    return std::launder(reinterpret_cast<T*>(cell.storage));
+  }
+
+  /**
+   * Destroys the item returned by front(). Must only be called by the consumer thread after
+   * front() returned an item
+   */
+  void pop() noexcept
+  {
+    Cell& cell = _cells[_head.value & _mask];
+    std::destroy_at(std::launder(reinterpret_cast<T*>(cell.storage)));
+
+    cell.sequence.store(_head.value + _mask + 1, std::memory_order_release);
+    _head.value += 1;
+  }
+
+  /**
+   * @return true if there is no item ready to consume. Must only be called by the consumer thread
+   */
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return _cells[_head.value & _mask].sequence.load(std::memory_order_acquire) != _head.value + 1;
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return _mask + 1; }
+
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence{0};
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  // the producers and the consumer each write their own counter on a separate cache line
+  struct alignas(cache_line_size) ProducerCounter
+  {
+    std::atomic<std::size_t> value{0};
+  };
+
+  struct alignas(cache_line_size) ConsumerCounter
+  {
+    std::size_t value{0};
+  };
+
+private:
+  ProducerCounter _tail;
+  ConsumerCounter _head;
+  std::size_t _mask{0};
+  std::unique_ptr<Cell[]> _cells;
+};
+} // namespace ets
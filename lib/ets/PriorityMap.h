@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "MessageStorage.h"
+#include "RingQueue.h"
+
+namespace ets
+{
+/**
+ * Priority tiers of the throttler backlog, resolved at compile time.
+ *
+ * A PriorityMap lists the tiers from the highest priority to the lowest. Each message type goes
+ * to the first tier that accepts it, the queued messages of a tier are sent before any message
+ * of the next tiers and in order within a tier.
+ *
+ * A tier provides:
+ *   accepts<TMessage>            true if the tier stores this message type
+ *   container<TOnSendCallback>   the queue of the tier, see MessageStorage.h for its interface
+ *
+ * e.g. cancels before amends before new orders:
+ *   PriorityMap<Tier<CancelOrder>, Tier<AmendOrder>, Tier<NewOrder>>
+ */
+
+/**
+ * A tier storing the listed message types. The messages are stored in place, a single type in
+ * its own queue and several types as a std::variant like VariantStorage
+ */
+template <typename... TMessages>
+struct Tier
+{
+  static_assert(sizeof...(TMessages) > 0, "a tier needs at least one message type");
+
+  template <typename TMessage>
+  static constexpr bool accepts = (std::is_same_v<TMessage, TMessages> || ...);
+
+  template <typename TOnSendCallback>
+  using container = typename VariantStorage<TMessages...>::template container<TOnSendCallback>;
+};
+
+template <typename TMessage>
+struct Tier<TMessage>
+{
+  template <typename TOther>
+  static constexpr bool accepts = std::is_same_v<TOther, TMessage>;
+
+  template <typename TOnSendCallback>
+  class container
+  {
+  public:
+    container() = default;
+
+    explicit container(std::pmr::memory_resource* resource) : _messages(16, resource) {}
+
+    void push(TMessage const& message) { _messages.push_back(message); }
+    void push(TMessage&& message) { _messages.push_back(std::move(message)); }
+
+    template <typename TOther, typename... Args>
+    void emplace(Args&&... args)
+    {
+      static_assert(std::is_same_v<TOther, TMessage>, "the tier does not store this message type");
+      _messages.emplace_back(std::forward<Args>(args)...);
+    }
+
+    void send(std::size_t i, TOnSendCallback& on_send_callback)
+    {
+      send_queued_message(on_send_callback, _messages[i]);
+    }
+
+    void expire(std::size_t i, TOnSendCallback& on_send_callback)
+    {
+      expire_queued_message(on_send_callback, _messages[i]);
+    }
+
+    /**
+     * Passes the first `n` messages to the callback without copying them, in one span or two
+     * if they wrap around the end of the ring
+     */
+    void send_batch(std::size_t n, TOnSendCallback& on_send_callback)
+      requires accepts_batches<TOnSendCallback, TMessage>
+    {
+      std::size_t sent{0};
+      while (sent < n)
+      {
+        std::span<TMessage const> const messages = _messages.contiguous(sent, n - sent);
+        on_send_callback.on_send_batch(messages);
+        sent += messages.size();
+      }
+    }
+
+    void replace(std::size_t i, TMessage const& message) { _messages[i] = message; }
+    void replace(std::size_t i, TMessage&& message) { _messages[i] = std::move(message); }
+
+    template <typename TVisitor>
+    void visit(std::size_t i, TVisitor& visitor) const
+    {
+      visitor(_messages[i]);
+    }
+
+    void pop_front(std::size_t n) noexcept { _messages.pop_front(n); }
+
+    void rotate_front() { _messages.rotate_front(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return _messages.size(); }
+    [[nodiscard]] bool empty() const noexcept { return _messages.empty(); }
+
+  private:
+    RingQueue<TMessage> _messages;
+  };
+};
+
+/**
+ * A tier accepting any message type, usually the last one. The messages are stored by the
+ * TStorage policy, see MessageStorage.h
+ */
+template <typename TStorage = TypeErasedStorage>
+struct AnyTier
+{
+  template <typename TMessage>
+  static constexpr bool accepts = true;
+
+  template <typename TOnSendCallback>
+  using container = typename TStorage::template container<TOnSendCallback>;
+};
+
+template <typename... TTiers>
+struct PriorityMap
+{
+  static constexpr std::size_t tiers = sizeof...(TTiers);
+  static_assert((tiers > 0) && (tiers <= 64), "the throttler keeps the non empty tiers in a 64 bit mask");
+
+private:
+  template <typename TMessage>
+  [[nodiscard]] static constexpr std::size_t _tier_of() noexcept
+  {
+    std::size_t tier{0};
+    bool found{false};
+    ((found = found || TTiers::template accepts<TMessage>, tier += found ? 0 : 1), ...);
+    return tier;
+  }
+
+public:
+  /**
+   * The tier of a message type, `tiers` if no tier accepts it
+   */
+  template <typename TMessage>
+  static constexpr std::size_t tier_of = _tier_of<TMessage>();
+
+  template <std::size_t Index>
+  using tier_t = std::tuple_element_t<Index, std::tuple<TTiers...>>;
+};
+} // namespace ets
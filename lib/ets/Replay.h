@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "Metrics.h"
+#include "PriorityMap.h"
+#include "Throttler.h"
+
+namespace ets
+{
+/**
+ * Replay of captured order flow through a throttler, faster than real time, to tune its limits.
+ *
+ * The flow is a binary event log: a ReplayLogHeader followed by the events in time order. The
+ * log is mapped read only by EventLog and replay() runs it through a PriorityThrottler driven by
+ * ManualClock, which jumps from one event or wake-up to the next, so a day of flow replays in
+ * seconds and the result does not depend on the machine. See replay/ReplayMain.cpp for the
+ * ets_replay tool.
+ */
+
+/**
+ * A message offered to the throttler, 16 bytes so the log stays compact
+ */
+struct ReplayEvent
+{
+  // nanoseconds since any epoch, non decreasing along the log
+  int64_t timestamp{0};
+  uint32_t id{0};
+
+  // 0 for the urgent messages, e.g. cancels, which are sent before the others
+  uint16_t priority{0};
+  uint16_t reserved{0};
+};
+
+static_assert(sizeof(ReplayEvent) == 16);
+static_assert(std::is_trivially_copyable_v<ReplayEvent>);
+
+struct ReplayLogHeader
+{
+  static constexpr uint32_t magic_value = 0x52535445; // "ETSR"
+  static constexpr uint32_t current_version = 1;
+
+  uint32_t magic{magic_value};
+  uint32_t version{current_version};
+  uint64_t events{0};
+};
+
+static_assert(sizeof(ReplayLogHeader) == 16);
+
+/**
+ * Writes an event log readable by EventLog
+ */
+inline void write_event_log(std::string const& path, std::span<ReplayEvent const> events)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr)
+  {
+    throw std::system_error(errno, std::system_category(), "fopen " + path);
+  }
+
+  ReplayLogHeader const header{ReplayLogHeader::magic_value, ReplayLogHeader::current_version, events.size()};
+  bool const written = (std::fwrite(&header, sizeof(header), 1, file) == 1) &&
+    (std::fwrite(events.data(), sizeof(ReplayEvent), events.size(), file) == events.size());
+  int const error = errno;
+
+  if ((std::fclose(file) != 0) || !written)
+  {
+    throw std::system_error(written ? errno : error, std::system_category(), "fwrite " + path);
+  }
+}
+
+/**
+ * An event log mapped read only. The events are read in place, the pages are brought in by the
+ * kernel read ahead as the replay goes
+ */
+class EventLog
+{
+public:
+  explicit EventLog(std::string const& path)
+  {
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+      throw std::system_error(errno, std::system_category(), "open " + path);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) == -1)
+    {
+      int const error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::system_category(), "fstat " + path);
+    }
+
+    _size = static_cast<std::size_t>(st.st_size);
+    if (_size < sizeof(ReplayLogHeader))
+    {
+      ::close(fd);
+      throw std::runtime_error("ets::EventLog: " + path + " is too small for a header");
+    }
+
+    void* mapping = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int const error = errno;
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+      throw std::system_error(error, std::system_category(), "mmap " + path);
+    }
+
+    _mapping = mapping;
+    (void)::madvise(_mapping, _size, MADV_SEQUENTIAL);
+
+    ReplayLogHeader const& header = *static_cast<ReplayLogHeader const*>(_mapping);
+    if ((header.magic != ReplayLogHeader::magic_value) || (header.version != ReplayLogHeader::current_version) ||
+        (header.events > (_size - sizeof(ReplayLogHeader)) / sizeof(ReplayEvent)))
+    {
+      _unmap();
+      throw std::runtime_error("ets::EventLog: " + path + " is not an event log");
+    }
+
+    _events = std::span<ReplayEvent const>{
+      reinterpret_cast<ReplayEvent const*>(static_cast<std::byte const*>(_mapping) + sizeof(ReplayLogHeader)),
+      static_cast<std::size_t>(header.events)};
+  }
+
+  EventLog(EventLog const&) = delete;
+  EventLog& operator=(EventLog const&) = delete;
+
+  EventLog(EventLog&& other) noexcept
+    : _mapping(std::exchange(other._mapping, nullptr)),
+      _size(std::exchange(other._size, 0)),
+      _events(std::exchange(other._events, {}))
+  {
+  }
+
+  ~EventLog() { _unmap(); }
+
+  [[nodiscard]] std::span<ReplayEvent const> events() const noexcept { return _events; }
+
+private:
+  void _unmap() noexcept
+  {
+    if (_mapping != nullptr)
+    {
+      ::munmap(_mapping, _size);
+      _mapping = nullptr;
+    }
+  }
+
+private:
+  void* _mapping{nullptr};
+  std::size_t _size{0};
+  std::span<ReplayEvent const> _events;
+};
+
+/**
+ * The outcome of a replay, in simulated time
+ */
+struct ReplayReport
+{
+  uint64_t messages{0};
+
+  // the messages which had to wait in the backlog
+  uint64_t queued{0};
+  uint64_t sent{0};
+
+  // from the first event to the last message sent
+  std::chrono::nanoseconds duration{0};
+
+  // the time each message spent in the backlog, 0 for the messages admitted right away
+  LatencyHistogram::Snapshot delays;
+
+  /**
+   * @return messages sent per simulated second
+   */
+  [[nodiscard]] double throughput() const noexcept
+  {
+    return duration.count() == 0 ? 0.0 : static_cast<double>(sent) * 1e9 / static_cast<double>(duration.count());
+  }
+
+  /**
+   * @return the share of a limit of `max_messages` per `interval` used over the replay, between 0
+   * and 1
+   */
+  [[nodiscard]] double utilization(std::size_t max_messages, std::chrono::nanoseconds interval) const noexcept
+  {
+    // the window of the first message and one more per interval elapsed
+    double const windows = 1.0 + static_cast<double>(duration.count()) / static_cast<double>(interval.count());
+    return static_cast<double>(sent) / (windows * static_cast<double>(max_messages));
+  }
+};
+
+namespace detail
+{
+struct UrgentReplayMessage
+{
+  int64_t timestamp;
+  uint32_t id;
+};
+
+struct ReplayMessage
+{
+  int64_t timestamp;
+  uint32_t id;
+};
+
+/**
+ * What the callback of the replayed throttler records
+ */
+struct ReplayState
+{
+  LatencyHistogram delays;
+  uint64_t sent{0};
+  int64_t last_sent{0};
+};
+
+class ReplayRecorder
+{
+public:
+  explicit ReplayRecorder(ReplayState* state) : _state(state) {}
+
+  template <typename TMessage>
+  void on_send(TMessage const& message)
+  {
+    _record(message.timestamp);
+  }
+
+  template <typename TMessage>
+  void on_send_batch(std::span<TMessage const> messages)
+  {
+    for (TMessage const& message : messages)
+    {
+      _record(message.timestamp);
+    }
+  }
+
+private:
+  void _record(int64_t timestamp) noexcept
+  {
+    _state->last_sent = ManualClock::now().time_since_epoch().count();
+    _state->delays.record(std::chrono::nanoseconds{_state->last_sent - timestamp});
+    ++_state->sent;
+  }
+
+private:
+  ReplayState* _state;
+};
+
+using replay_priorities_t = PriorityMap<Tier<UrgentReplayMessage>, Tier<ReplayMessage>>;
+} // namespace detail
+
+/**
+ * Runs the events through a throttler with the given window and reports the queueing
+ * delays. The clock jumps to each event, and between events to each time the backlog can send
+ * again, so the replay costs the same whether the flow is spread over a day or a second.
+ *
+ * Events out of order, e.g. from merged captures, are replayed at the time of the latest event.
+ * ManualClock is set by the replay, it must not be used by anything else meanwhile.
+ *
+ * @tparam TWindow any window policy on ManualClock, e.g. SlidingWindow<ManualClock>
+ */
+template <typename TWindow>
+[[nodiscard]] ReplayReport replay(std::span<ReplayEvent const> events, TWindow window)
+{
+  static_assert(std::is_same_v<typename TWindow::clock_t, ManualClock>, "the replay drives ManualClock");
+
+  ReplayReport report;
+  if (events.empty())
+  {
+    return report;
+  }
+
+  using time_point = ManualClock::time_point;
+  constexpr time_point idle = time_point::max();
+
+  detail::ReplayState state;
+  PriorityThrottler<detail::ReplayRecorder, detail::replay_priorities_t, TWindow> throttler{
+    std::move(window), detail::ReplayRecorder{&state}};
+
+  auto const drain_until = [&](time_point& wake_up, time_point until)
+  {
+    while (wake_up <= until)
+    {
+      ManualClock::set(wake_up);
+      std::chrono::nanoseconds const delay = throttler.send_queued_messages();
+      wake_up = delay.count() == 0 ? idle : wake_up + delay;
+    }
+  };
+
+  time_point const start{std::chrono::nanoseconds{events.front().timestamp}};
+  time_point now = start;
+  time_point wake_up = idle;
+
+  for (ReplayEvent const& event : events)
+  {
+    now = std::max(now, time_point{std::chrono::nanoseconds{event.timestamp}});
+    drain_until(wake_up, now);
+    ManualClock::set(now);
+
+    std::chrono::nanoseconds const delay = event.priority == 0
+      ? throttler.try_send_message(detail::UrgentReplayMessage{now.time_since_epoch().count(), event.id})
+      : throttler.try_send_message(detail::ReplayMessage{now.time_since_epoch().count(), event.id});
+
+    if (delay.count() != 0)
+    {
+      ++report.queued;
+      wake_up = std::min(wake_up, now + delay);
+    }
+  }
+
+  drain_until(wake_up, idle - std::chrono::nanoseconds{1});
+
+  report.messages = events.size();
+  report.sent = state.sent;
+  report.duration = std::chrono::nanoseconds{std::max(state.last_sent, now.time_since_epoch().count())} -
+    start.time_since_epoch();
+  report.delays = state.delays.snapshot();
+  return report;
+}
+} // namespace ets
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace ets
+{
+/**
+ * A FIFO queue backed by a growable ring of power of two capacity.
+ * Items are pushed at the back and popped from the front in O(1). When the ring is full its
+ * capacity is doubled and the items are moved over, so an unbounded backlog costs amortised O(1)
+ * per item and never shifts the remaining items when the front is released.
+ *
+ * The ring is allocated from a std::pmr::memory_resource, e.g. one bound to the NUMA node of
+ * the thread using the queue. By default it is the default resource of the program.
+ */
+template <typename T>
+class RingQueue
+{
+public:
+  explicit RingQueue(std::size_t initial_capacity = 16,
+                     std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : _resource(resource)
+  {
+    // round up to the next power of two so we can mask instead of checking for wrap around
+    std::size_t capacity{1};
+    while (capacity < initial_capacity)
+    {
+      capacity <<= 1;
+    }
+
+    _storage = _allocate(capacity);
+    _mask = capacity - 1;
+  }
+
+  RingQueue(RingQueue const&) = delete;
+  RingQueue& operator=(RingQueue const&) = delete;
+
+  RingQueue(RingQueue&& other) noexcept
+    : _storage(std::exchange(other._storage, nullptr)),
+      _mask(std::exchange(other._mask, 0)),
+      _head(std::exchange(other._head, 0)),
+      _tail(std::exchange(other._tail, 0)),
+      _resource(other._resource)
+  {
+  }
+
+  RingQueue& operator=(RingQueue&& other) noexcept
+  {
+    if (this != &other)
+    {
+      _release();
+      _resource = other._resource;
+      _storage = std::exchange(other._storage, nullptr);
+      _mask = std::exchange(other._mask, 0);
+      _head = std::exchange(other._head, 0);
+      _tail = std::exchange(other._tail, 0);
+    }
+    return *this;
+  }
+
+  ~RingQueue() { _release(); }
+
+  /**
+   * Constructs a new item in place at the back of the queue
+   * @return the new item
+   */
+  template <typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    if (size() == capacity())
+    {
+      _grow();
+    }
+
+    T* item = ::new (static_cast<void*>(_storage + (_tail & _mask))) T(std::forward<Args>(args)...);
+    _tail += 1;
+    return *item;
+  }
+
+  void push_back(T const& item) { emplace_back(item); }
+  void push_back(T&& item) { emplace_back(std::move(item)); }
+
+  /**
+   * Returns the item at position `i` counting from the front of the queue
+   */
+  [[nodiscard]] T& operator[](std::size_t i) noexcept { return _storage[(_head + i) & _mask]; }
+  [[nodiscard]] T const& operator[](std::size_t i) const noexcept
+  {
+    return _storage[(_head + i) & _mask];
+  }
+
+  /**
+   * Returns the items from position `i` up to the end of the storage, at most `n` of them. The
+   * items of the queue are in at most two such spans, the second one starts at the storage start
+   */
+  [[nodiscard]] std::span<T const> contiguous(std::size_t i, std::size_t n) const noexcept
+  {
+    std::size_t const first = (_head + i) & _mask;
+    return std::span<T const>{_storage + first, std::min(n, capacity() - first)};
+  }
+
+  [[nodiscard]] T& front() noexcept { return _storage[_head & _mask]; }
+  [[nodiscard]] T const& front() const noexcept { return _storage[_head & _mask]; }
+
+  /**
+   * Removes the front item
+   */
+  void pop_front() noexcept
+  {
+    std::destroy_at(_storage + (_head & _mask));
+    _head += 1;
+  }
+
+  /**
+   * Removes the first `n` items at once. Used to release a prefix of already processed items
+   * @param n number of items to remove, must not be larger than size()
+   */
+  void pop_front(std::size_t n) noexcept
+  {
+    if constexpr (!std::is_trivially_destructible_v<T>)
+    {
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        std::destroy_at(_storage + ((_head + i) & _mask));
+      }
+    }
+
+    _head += n;
+  }
+
+  /**
+   * Moves the front item to the back of the queue
+   */
+  void rotate_front()
+  {
+    T item{std::move(front())};
+    pop_front();
+    emplace_back(std::move(item));
+  }
+
+  void clear() noexcept { pop_front(size()); }
+
+  [[nodiscard]] std::size_t size() const noexcept { return _tail - _head; }
+  [[nodiscard]] bool empty() const noexcept { return _tail == _head; }
+  [[nodiscard]] std::size_t capacity() const noexcept { return _storage ? _mask + 1 : 0; }
+
+  [[nodiscard]] std::pmr::memory_resource* resource() const noexcept { return _resource; }
+
+private:
+  [[nodiscard]] T* _allocate(std::size_t capacity)
+  {
+    return static_cast<T*>(_resource->allocate(capacity * sizeof(T), alignof(T)));
+  }
+
+  void _deallocate(T* storage, std::size_t capacity) noexcept
+  {
+    _resource->deallocate(storage, capacity * sizeof(T), alignof(T));
+  }
+
+  void _grow()
+  {
+    std::size_t const new_capacity = capacity() ? capacity() * 2 : 1;
+    T* new_storage = _allocate(new_capacity);
+
+    // move the items over keeping their order, they start at the beginning of the new storage
+    std::size_t const count = size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      T* item = _storage + ((_head + i) & _mask);
+      ::new (static_cast<void*>(new_storage + i)) T(std::move(*item));
+      std::destroy_at(item);
+    }
+
+    if (_storage)
+    {
+      _deallocate(_storage, capacity());
+    }
+
+    _storage = new_storage;
+    _mask = new_capacity - 1;
+    _head = 0;
+    _tail = count;
+  }
+
+  void _release() noexcept
+  {
+    if (_storage)
+    {
+      clear();
+      _deallocate(_storage, capacity());
+      _storage = nullptr;
+    }
+  }
+
+private:
+  T* _storage{nullptr};
+  std::size_t _mask{0};
+
+  // head and tail keep increasing and are masked on access, size is always tail - head
+  std::size_t _head{0};
+  std::size_t _tail{0};
+
+  // only used when the ring grows
+  std::pmr::memory_resource* _resource;
+};
+} // namespace ets
@@ -0,0 +1,953 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
+#include "CacheLine.h"
+#include "ConsistentHashRing.h"
+#include "FlatHashMap.h"
+#include "RingQueue.h"
+#include "Scheduler.h"
+#include "SpscQueue.h"
+#include "Throttler.h"
+
+namespace ets
+{
+using session_id_t = uint64_t;
+
+/**
+ * The configuration of a Runtime
+ */
+struct RuntimeConfig
+{
+  // number of processor threads
+  std::size_t pipelines{1};
+
+  // number of producer threads, each gets its own ring to every pipeline
+  std::size_t producers{1};
+
+  // the cpu each pipeline is pinned to, a pipeline without an entry or with -1 is not pinned
+  std::vector<int> cpus;
+
+  // capacity of each ingress ring
+  std::size_t ring_capacity{1024};
+
+  // number of partitions the sessions are hashed to, rounded up to a power of two. A partition
+  // is the unit of rebalancing, all its sessions move together
+  std::size_t partitions{256};
+
+  // number of points of each pipeline on the consistent hash ring
+  std::size_t virtual_nodes{64};
+
+  // how long a pipeline busy polls before parking, see Scheduler
+  std::chrono::nanoseconds spin_duration{0};
+
+  // max messages consumed from one ring before moving to the next
+  std::size_t max_batch_size{64};
+
+  // max queued messages sent by one drain of the backlogs
+  std::size_t max_drain_size{256};
+
+  // set to false to keep every partition on the pipeline the consistent hash ring gives it
+  bool rebalance{true};
+
+  // how often a pipeline publishes its load and looks for a pipeline to steal from
+  std::chrono::nanoseconds rebalance_interval{std::chrono::milliseconds{10}};
+
+  // a pipeline is only stolen from once its load reaches this many messages
+  std::size_t steal_threshold{1024};
+};
+
+/**
+ * The counters of a pipeline of a Runtime, updated by its thread and readable from any thread
+ */
+struct PipelineStats
+{
+  // number of messages passed to the sessions of the pipeline
+  std::size_t processed{0};
+
+  // number of sessions owned by the pipeline
+  std::size_t sessions{0};
+
+  // number of partitions the pipeline stole from others and gave to others
+  std::size_t partitions_in{0};
+  std::size_t partitions_out{0};
+};
+
+/**
+ * Runs the sessions of a gateway on several processor threads, the pipelines, each pinned to its
+ * own core, so the throughput scales with the cores instead of being capped by one thread.
+ *
+ * Each session, e.g. a PriorityThrottler per venue session or per client, is owned by exactly one
+ * pipeline, which is the only thread touching it. A pipeline owns:
+ *   - one SpscQueue from each producer thread, so producers never contend with each other
+ *   - a Scheduler parking the thread until new ingress arrives or a backlog is due
+ *   - the sessions of its partitions and the list of the sessions with a backlog
+ *
+ * Sessions are hashed to a fixed number of partitions and the partitions are placed on the
+ * pipelines by a ConsistentHashRing, so a restart with a different number of pipelines only moves
+ * about 1 / pipelines of the sessions. A producer routes a message with a single load of the owner
+ * of its partition.
+ *
+ * Hot sessions are rebalanced by work stealing. Every rebalance interval each pipeline publishes
+ * its load, the number of messages it processed decayed by half every interval. A pipeline whose
+ * load is less than half of the busiest one asks it for a partition. The busy pipeline gives the
+ * partition whose load is closest to half the difference, but never its only active one, since
+ * that would only move the hot spot. The partition then moves without stopping anyone:
+ *   1. the victim points the partition to the thief. New messages of the partition go to the rings
+ *      of the thief, which holds them back as it does not own the partition yet
+ *   2. the victim waits until no producer can still be pushing to it with the old owner, then
+ *      until it consumed everything pushed to its rings so far, processing the messages of the
+ *      partition as usual
+ *   3. the victim hands the sessions of the partition, with their backlogs, to the thief, which
+ *      installs them and then processes the messages it held back
+ * So the messages of each producer to a session are still processed in the order they were
+ * pushed. A pipeline takes part in one move at a time.
+ *
+ * A pipeline with nothing to do wakes up every rebalance interval to look for work, set
+ * RuntimeConfig::rebalance to false to park it until its ingress arrives.
+ *
+ * TSession is created by the session factory the first time a message of the session arrives.
+ * It has the interface of a PriorityThrottler: try_send_message(message) returning the delay until
+ * it can send again, send_queued_messages(DrainBudget) and queued(). A std::variant message is
+ * visited and its alternative is passed on.
+ *
+ * @tparam TMessage the message pushed by the producers, stored in place in the rings
+ * @tparam TSession the state of a session, usually a PriorityThrottler
+ */
+template <typename TMessage, typename TSession>
+class Runtime
+{
+public:
+  using clock_t = Scheduler::clock_t;
+  using time_point = clock_t::time_point;
+  using session_factory_t = std::function<std::unique_ptr<TSession>(session_id_t)>;
+
+  /**
+   * A message in the ingress rings
+   */
+  struct Envelope
+  {
+    session_id_t session;
+    TMessage message;
+  };
+
+  /**
+   * The handle of a producer thread. Each producer thread uses its own handle
+   */
+  class Producer
+  {
+  public:
+    /**
+     * Pushes a message of the session to the pipeline owning the session and wakes it up.
+     * Yields the thread while the ring to that pipeline is full
+     */
+    void push(session_id_t session, TMessage&& message)
+    {
+      std::size_t const partition = _runtime->_partition_of(session);
+
+      // odd while routing, a pipeline moving a partition away waits until the producers that
+      // could have read the old owner are done, see GracePeriod
+      _epoch.value.fetch_add(1, std::memory_order_seq_cst);
+      uint32_t const pipeline = _runtime->_owners[partition].load(std::memory_order_seq_cst);
+      _runtime->_pipelines[pipeline]->ring(_index).push(Envelope{session, std::move(message)});
+      _epoch.value.fetch_add(1, std::memory_order_release);
+
+      _runtime->_pipelines[pipeline]->notify();
+    }
+
+    [[nodiscard]] std::size_t index() const noexcept { return _index; }
+
+  private:
+    friend class Runtime;
+
+    Producer(Runtime* runtime, std::size_t index) : _runtime(runtime), _index(index) {}
+
+    // read by the pipelines moving a partition, on its own line
+    struct alignas(cache_line_size) Epoch
+    {
+      std::atomic<uint64_t> value{0};
+    };
+
+    Epoch _epoch;
+    Runtime* _runtime;
+    std::size_t _index;
+  };
+
+  /**
+   * @param config the pipelines, producers and rebalancing
+   * @param session_factory creates the session of a session id, called by the pipeline owning it
+   */
+  Runtime(RuntimeConfig config, session_factory_t session_factory)
+    : _config(std::move(config)), _session_factory(std::move(session_factory))
+  {
+    std::size_t partitions{1};
+    while (partitions < _config.partitions)
+    {
+      partitions <<= 1;
+    }
+    _partition_mask = partitions - 1;
+
+    ConsistentHashRing const ring{_config.pipelines, _config.virtual_nodes};
+    _owners = std::make_unique<std::atomic<uint32_t>[]>(partitions);
+    for (std::size_t partition = 0; partition < partitions; ++partition)
+    {
+      _owners[partition].store(ring.node_of(mix_hash(partition)), std::memory_order_relaxed);
+    }
+
+    _producers.reserve(_config.producers);
+    for (std::size_t i = 0; i < _config.producers; ++i)
+    {
+      _producers.emplace_back(new Producer{this, i});
+    }
+
+    _pipelines.reserve(_config.pipelines);
+    for (std::size_t i = 0; i < _config.pipelines; ++i)
+    {
+      _pipelines.push_back(std::make_unique<Pipeline>(*this, static_cast<uint32_t>(i)));
+    }
+  }
+
+  // the producers and the pipelines point to the runtime
+  Runtime(Runtime const&) = delete;
+  Runtime& operator=(Runtime const&) = delete;
+
+  ~Runtime() { stop(); }
+
+  /**
+   * Starts the pipeline threads
+   */
+  void run()
+  {
+    for (auto& pipeline : _pipelines)
+    {
+      pipeline->run();
+    }
+  }
+
+  /**
+   * Stops the pipeline threads and waits for them. The messages still in the rings and the
+   * backlogs are not sent
+   */
+  void stop()
+  {
+    for (auto& pipeline : _pipelines)
+    {
+      pipeline->request_stop();
+    }
+
+    join();
+  }
+
+  /**
+   * Waits for the pipeline threads, they only finish after stop() is called
+   */
+  void join()
+  {
+    for (auto& pipeline : _pipelines)
+    {
+      pipeline->join();
+    }
+  }
+
+  [[nodiscard]] Producer& producer(std::size_t i) noexcept { return *_producers[i]; }
+
+  [[nodiscard]] std::size_t producers() const noexcept { return _producers.size(); }
+
+  [[nodiscard]] std::size_t pipelines() const noexcept { return _pipelines.size(); }
+
+  [[nodiscard]] std::size_t partitions() const noexcept { return _partition_mask + 1; }
+
+  /**
+   * @return the pipeline new messages of the session are routed to
+   */
+  [[nodiscard]] std::size_t pipeline_of(session_id_t session) const noexcept
+  {
+    return _owners[_partition_of(session)].load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] PipelineStats stats(std::size_t pipeline) const noexcept { return _pipelines[pipeline]->stats(); }
+
+private:
+  /**
+   * A partition being moved from a victim to a thief. Created by the thief when it asks, filled
+   * by the victim, which gives it back by setting the state
+   */
+  struct Migration
+  {
+    enum class State : uint8_t
+    {
+      Pending,
+      Declined,
+      Done
+    };
+
+    explicit Migration(uint32_t thief, uint64_t thief_load) : thief(thief), thief_load(thief_load) {}
+
+    uint32_t thief;
+    uint64_t thief_load;
+    std::size_t partition{0};
+    std::vector<std::pair<session_id_t, std::unique_ptr<TSession>>> sessions;
+    std::atomic<State> state{State::Pending};
+  };
+
+  /**
+   * A session and its place in the backlog list of its pipeline
+   */
+  struct SessionEntry
+  {
+    SessionEntry(session_id_t id, std::size_t partition, std::unique_ptr<TSession> session)
+      : id(id), partition(partition), session(std::move(session))
+    {
+    }
+
+    session_id_t id;
+    std::size_t partition;
+    std::unique_ptr<TSession> session;
+    bool backlogged{false};
+  };
+
+  class Pipeline
+  {
+  public:
+    Pipeline(Runtime& runtime, uint32_t index)
+      : _runtime(runtime),
+        _index(index),
+        _scheduler(runtime._config.spin_duration),
+        _partitions(runtime.partitions())
+    {
+      _rings.reserve(runtime._config.producers);
+      for (std::size_t i = 0; i < runtime._config.producers; ++i)
+      {
+        _rings.push_back(std::make_unique<SpscQueue<Envelope>>(runtime._config.ring_capacity));
+      }
+
+      for (std::size_t partition = 0; partition < _partitions.size(); ++partition)
+      {
+        _partitions[partition].owned = runtime._owners[partition].load(std::memory_order_relaxed) == index;
+      }
+    }
+
+    ~Pipeline() { join(); }
+
+    void run()
+    {
+      std::thread worker{[this]() { _main_loop(); }};
+      _worker.swap(worker);
+    }
+
+    void request_stop()
+    {
+      _stop.store(true, std::memory_order_relaxed);
+      _scheduler.notify();
+    }
+
+    void join()
+    {
+      if (_worker.joinable())
+      {
+        _worker.join();
+      }
+    }
+
+    void notify() noexcept { _scheduler.notify(); }
+
+    [[nodiscard]] SpscQueue<Envelope>& ring(std::size_t producer) noexcept { return *_rings[producer]; }
+
+    [[nodiscard]] uint64_t load() const noexcept { return _load.value.load(std::memory_order_relaxed); }
+
+    /**
+     * Asks the pipeline for a partition, fails if another pipeline is already asking
+     */
+    [[nodiscard]] bool request_steal(Migration* migration) noexcept
+    {
+      Migration* expected{nullptr};
+      if (!_steal_request.value.compare_exchange_strong(expected, migration, std::memory_order_release,
+                                                        std::memory_order_relaxed))
+      {
+        return false;
+      }
+
+      _scheduler.notify();
+      return true;
+    }
+
+    [[nodiscard]] PipelineStats stats() const noexcept
+    {
+      return PipelineStats{_stats.processed.load(std::memory_order_relaxed),
+                           _stats.sessions.load(std::memory_order_relaxed),
+                           _stats.partitions_in.load(std::memory_order_relaxed),
+                           _stats.partitions_out.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    void _main_loop()
+    {
+      _pin();
+
+      _next_rebalance = clock_t::now() + _runtime._config.rebalance_interval;
+
+      while (!_stop.load(std::memory_order_relaxed))
+      {
+        // read any messages from the rings and pass them to their sessions
+        _process_rings();
+
+        // moving a partition to or from another pipeline
+        _serve_steal_request();
+        _progress_outgoing();
+        _progress_incoming();
+
+        // send a slice of the backlogs that are due
+        _send_queued_messages();
+
+        _rebalance();
+
+        // park until new messages arrive, a backlog is due or it is time to rebalance
+        _schedule();
+        _scheduler.wait();
+      }
+    }
+
+    void _pin()
+    {
+      std::vector<int> const& cpus = _runtime._config.cpus;
+      if ((_index >= cpus.size()) || (cpus[_index] < 0))
+      {
+        return;
+      }
+
+#if defined(__linux__)
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(cpus[_index], &cpu_set);
+
+      // a cpu that is not available leaves the thread unpinned
+      (void)pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+    }
+
+    void _process_rings()
+    {
+      time_point const now = clock_t::now();
+
+      // one batch from each ring in turns, so a busy producer does not hold back the others and
+      // the loop gets back to the backlogs and the steal requests under a constant flow
+      _ingress_pending = false;
+      for (auto& ring : _rings)
+      {
+        std::size_t const consumed = ring->consume([this, now](Envelope& envelope) { _process(envelope, now); },
+                                                   _runtime._config.max_batch_size);
+
+        _ingress_pending |= (consumed == _runtime._config.max_batch_size);
+      }
+    }
+
+    void _process(Envelope& envelope, time_point now)
+    {
+      std::size_t const partition = _runtime._partition_of(envelope.session);
+      PartitionState& partition_state = _partitions[partition];
+
+      if (!partition_state.owned)
+      {
+        // the partition is moving here, hold the message back until its sessions arrive
+        _held_back.push_back(std::move(envelope));
+        return;
+      }
+
+      partition_state.load += 1;
+      _load_total += 1;
+      _stats.processed.store(_stats.processed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      SessionEntry& entry = _session(envelope.session, partition);
+      std::chrono::nanoseconds const delay = _try_send_message(*entry.session, envelope.message);
+
+      if (delay.count() != 0)
+      {
+        // the message got throttled, the backlog of the session is sent after the delay
+        _add_backlogged(entry);
+        _wake_at(now + delay);
+      }
+    }
+
+    [[nodiscard]] static std::chrono::nanoseconds _try_send_message(TSession& session, TMessage& message)
+    {
+      if constexpr (is_variant_v<TMessage>)
+      {
+        return std::visit([&session](auto& alternative) { return session.try_send_message(std::move(alternative)); },
+                          message);
+      }
+      else
+      {
+        return session.try_send_message(std::move(message));
+      }
+    }
+
+    [[nodiscard]] SessionEntry& _session(session_id_t id, std::size_t partition)
+    {
+      auto [entry, inserted] = _sessions.try_emplace(id);
+      if (inserted)
+      {
+        *entry = std::make_unique<SessionEntry>(id, partition, _runtime._session_factory(id));
+        _update_session_count();
+      }
+
+      return **entry;
+    }
+
+    void _add_backlogged(SessionEntry& entry)
+    {
+      if (!entry.backlogged)
+      {
+        entry.backlogged = true;
+        _backlogged.push_back(&entry);
+      }
+    }
+
+    /**
+     * Drains the backlogged sessions in turns, until the drain budget is spent
+     */
+    void _send_queued_messages()
+    {
+      time_point const now = clock_t::now();
+      if ((_drain_deadline == time_point{}) || (now < _drain_deadline))
+      {
+        return;
+      }
+
+      _drain_deadline = time_point{};
+
+      std::size_t budget = _runtime._config.max_drain_size;
+      for (std::size_t n = _backlogged.size(); (n != 0) && (budget != 0); --n)
+      {
+        SessionEntry* entry = _backlogged.front();
+        _backlogged.pop_front();
+
+        auto const status = entry->session->send_queued_messages(DrainBudget{budget});
+        budget -= std::min(budget, status.sent);
+
+        if (entry->session->queued() == 0)
+        {
+          entry->backlogged = false;
+          continue;
+        }
+
+        // still queued, it goes to the back so the next drain starts with the others
+        _backlogged.push_back(entry);
+        _wake_at(status.budget_exhausted ? now : now + status.delay);
+      }
+
+      if (!_backlogged.empty() && (budget == 0))
+      {
+        // more can be sent right after the next ingress batch
+        _wake_at(now);
+      }
+    }
+
+    void _wake_at(time_point deadline) noexcept
+    {
+      if ((_drain_deadline == time_point{}) || (deadline < _drain_deadline))
+      {
+        _drain_deadline = deadline;
+      }
+    }
+
+    void _schedule()
+    {
+      time_point deadline = _drain_deadline;
+
+      if (_ingress_pending || _outgoing)
+      {
+        // more ingress is ready, or poll until the producers and the rings let the partition go
+        deadline = clock_t::now();
+      }
+      else if (_runtime._config.rebalance && ((deadline == time_point{}) || (_next_rebalance < deadline)))
+      {
+        deadline = _next_rebalance;
+      }
+
+      if (deadline == time_point{})
+      {
+        _scheduler.cancel();
+      }
+      else
+      {
+        _scheduler.schedule_at(deadline);
+      }
+    }
+
+    /**
+     * Publishes the load of the pipeline and asks the busiest pipeline for a partition
+     */
+    void _rebalance()
+    {
+      time_point const now = clock_t::now();
+      if (now < _next_rebalance)
+      {
+        return;
+      }
+
+      _next_rebalance = now + _runtime._config.rebalance_interval;
+
+      // the load decays by half every interval
+      _load.value.store(_load_total, std::memory_order_relaxed);
+      _load_total = 0;
+      for (PartitionState& partition_state : _partitions)
+      {
+        partition_state.load >>= 1;
+        _load_total += partition_state.load;
+      }
+
+      if (!_runtime._config.rebalance || _outgoing || _incoming)
+      {
+        return;
+      }
+
+      uint64_t const own_load = load();
+      Pipeline* victim{nullptr};
+      for (auto& pipeline : _runtime._pipelines)
+      {
+        if ((pipeline.get() != this) && (!victim || (pipeline->load() > victim->load())))
+        {
+          victim = pipeline.get();
+        }
+      }
+
+      if (!victim || (victim->load() < _runtime._config.steal_threshold) || (victim->load() <= 2 * own_load))
+      {
+        return;
+      }
+
+      auto migration = std::make_unique<Migration>(_index, own_load);
+      if (victim->request_steal(migration.get()))
+      {
+        _incoming = std::move(migration);
+      }
+    }
+
+    /**
+     * Answers a pipeline asking for a partition. Points the partition to the thief, the sessions
+     * follow once the producers and the rings let it go, see _progress_outgoing()
+     */
+    void _serve_steal_request()
+    {
+      if (_steal_request.value.load(std::memory_order_relaxed) == nullptr)
+      {
+        return;
+      }
+
+      Migration* migration = _steal_request.value.exchange(nullptr, std::memory_order_acquire);
+      Pipeline& thief = *_runtime._pipelines[migration->thief];
+
+      std::size_t partition{0};
+      if (_outgoing || _incoming || !_pick_partition(migration->thief_load, partition))
+      {
+        migration->state.store(Migration::State::Declined, std::memory_order_release);
+        thief.notify();
+        return;
+      }
+
+      migration->partition = partition;
+      _outgoing = migration;
+      _runtime._owners[partition].store(migration->thief, std::memory_order_seq_cst);
+
+      // the producers that might have routed to this pipeline before the store above
+      _grace.begin(_runtime._producers);
+      _drain_marks.clear();
+    }
+
+    /**
+     * Picks the owned partition whose load is closest to half the difference of the loads
+     * @return false if the pipeline has less than two active partitions
+     */
+    [[nodiscard]] bool _pick_partition(uint64_t thief_load, std::size_t& partition) const noexcept
+    {
+      uint64_t const own_load = load();
+      uint64_t const target = own_load > thief_load ? (own_load - thief_load) / 2 : 0;
+
+      std::size_t active{0};
+      uint64_t best_distance{UINT64_MAX};
+      for (std::size_t i = 0; i < _partitions.size(); ++i)
+      {
+        PartitionState const& partition_state = _partitions[i];
+        if (!partition_state.owned || (partition_state.load == 0))
+        {
+          continue;
+        }
+
+        active += 1;
+        uint64_t const distance =
+          partition_state.load > target ? partition_state.load - target : target - partition_state.load;
+        if (distance < best_distance)
+        {
+          best_distance = distance;
+          partition = i;
+        }
+      }
+
+      return active >= 2;
+    }
+
+    void _progress_outgoing()
+    {
+      if (!_outgoing)
+      {
+        return;
+      }
+
+      if (_drain_marks.empty())
+      {
+        if (!_grace.passed(_runtime._producers))
+        {
+          return;
+        }
+
+        // nothing can be pushed here for the partition any more, the rings only have to be
+        // consumed up to this point
+        for (auto& ring : _rings)
+        {
+          _drain_marks.push_back(ring->pushed());
+        }
+      }
+
+      for (std::size_t i = 0; i < _rings.size(); ++i)
+      {
+        if (_rings[i]->consumed() < _drain_marks[i])
+        {
+          return;
+        }
+      }
+
+      _hand_over(*_outgoing);
+      _outgoing = nullptr;
+      _drain_marks.clear();
+    }
+
+    void _hand_over(Migration& migration)
+    {
+      std::size_t const partition = migration.partition;
+
+      // take the sessions of the partition out of the backlog list
+      for (std::size_t n = _backlogged.size(); n != 0; --n)
+      {
+        SessionEntry* entry = _backlogged.front();
+        _backlogged.pop_front();
+        if (entry->partition != partition)
+        {
+          _backlogged.push_back(entry);
+        }
+      }
+
+      _sessions.erase_if(
+        [&migration, partition](session_id_t id, std::unique_ptr<SessionEntry>& entry)
+        {
+          if (entry->partition != partition)
+          {
+            return false;
+          }
+
+          migration.sessions.emplace_back(id, std::move(entry->session));
+          return true;
+        });
+
+      _load_total -= std::min(_load_total, _partitions[partition].load);
+      _partitions[partition] = PartitionState{};
+      _update_session_count();
+      _stats.partitions_out.store(_stats.partitions_out.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      uint32_t const thief = migration.thief;
+      migration.state.store(Migration::State::Done, std::memory_order_release);
+
+      // the migration belongs to the thief again and can not be used after the store above
+      _runtime._pipelines[thief]->notify();
+    }
+
+    void _progress_incoming()
+    {
+      if (!_incoming)
+      {
+        return;
+      }
+
+      typename Migration::State const state = _incoming->state.load(std::memory_order_acquire);
+      if (state == Migration::State::Pending)
+      {
+        return;
+      }
+
+      if (state == Migration::State::Done)
+      {
+        _install(*_incoming);
+      }
+
+      _incoming.reset();
+    }
+
+    void _install(Migration& migration)
+    {
+      std::size_t const partition = migration.partition;
+      time_point const now = clock_t::now();
+
+      for (auto& [id, session] : migration.sessions)
+      {
+        std::unique_ptr<SessionEntry>* entry = _sessions.try_emplace(id).first;
+        *entry = std::make_unique<SessionEntry>(id, partition, std::move(session));
+
+        if ((*entry)->session->queued() != 0)
+        {
+          // the backlog is drained by this pipeline from now on
+          _add_backlogged(**entry);
+          _wake_at(now);
+        }
+      }
+
+      _partitions[partition].owned = true;
+      _update_session_count();
+      _stats.partitions_in.store(_stats.partitions_in.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      // the messages pushed after the partition was pointed here come after the ones the victim
+      // processed
+      while (!_held_back.empty())
+      {
+        _process(_held_back.front(), now);
+        _held_back.pop_front();
+      }
+    }
+
+    void _update_session_count() noexcept { _stats.sessions.store(_sessions.size(), std::memory_order_relaxed); }
+
+  private:
+    struct PartitionState
+    {
+      // messages processed, decayed by half every rebalance interval
+      uint64_t load{0};
+      bool owned{false};
+    };
+
+    /**
+     * Tells when every producer that could have read the old owner of a partition has finished
+     * its push. A producer in the middle of a push has an odd epoch, the grace period is over for
+     * it once its epoch was even or has changed since the owner was replaced
+     */
+    class GracePeriod
+    {
+    public:
+      void begin(std::vector<std::unique_ptr<Producer>> const& producers)
+      {
+        _epochs.clear();
+        for (auto const& producer : producers)
+        {
+          _epochs.push_back(producer->_epoch.value.load(std::memory_order_seq_cst));
+        }
+      }
+
+      [[nodiscard]] bool passed(std::vector<std::unique_ptr<Producer>> const& producers) const noexcept
+      {
+        for (std::size_t i = 0; i < producers.size(); ++i)
+        {
+          if (((_epochs[i] & 1) != 0) && (producers[i]->_epoch.value.load(std::memory_order_acquire) == _epochs[i]))
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+    private:
+      std::vector<uint64_t> _epochs;
+    };
+
+    // written by the pipeline, read by the other pipelines looking for one to steal from
+    struct alignas(cache_line_size) Load
+    {
+      std::atomic<uint64_t> value{0};
+    };
+
+    // written by the thieves
+    struct alignas(cache_line_size) StealRequest
+    {
+      std::atomic<Migration*> value{nullptr};
+    };
+
+    struct alignas(cache_line_size) Stats
+    {
+      std::atomic<std::size_t> processed{0};
+      std::atomic<std::size_t> sessions{0};
+      std::atomic<std::size_t> partitions_in{0};
+      std::atomic<std::size_t> partitions_out{0};
+    };
+
+    Runtime& _runtime;
+    uint32_t _index;
+    std::vector<std::unique_ptr<SpscQueue<Envelope>>> _rings;
+    Scheduler _scheduler;
+    Load _load;
+    StealRequest _steal_request;
+    Stats _stats;
+    std::atomic<bool> _stop{false};
+    std::thread _worker;
+
+    // owned by the pipeline thread
+    FlatHashMap<session_id_t, std::unique_ptr<SessionEntry>> _sessions;
+    RingQueue<SessionEntry*> _backlogged;
+    std::vector<PartitionState> _partitions;
+    uint64_t _load_total{0};
+    time_point _drain_deadline{};
+    time_point _next_rebalance{};
+    bool _ingress_pending{false};
+
+    // the partition moving away and the ring positions it waits for
+    Migration* _outgoing{nullptr};
+    GracePeriod _grace;
+    std::vector<std::size_t> _drain_marks;
+
+    // the partition asked for and the messages held back until it arrives
+    std::unique_ptr<Migration> _incoming;
+    RingQueue<Envelope> _held_back;
+  };
+
+  template <typename T>
+  struct is_variant : std::false_type
+  {
+  };
+
+  template <typename... Ts>
+  struct is_variant<std::variant<Ts...>> : std::true_type
+  {
+  };
+
+  template <typename T>
+  static constexpr bool is_variant_v = is_variant<T>::value;
+
+  [[nodiscard]] std::size_t _partition_of(session_id_t session) const noexcept
+  {
+    return mix_hash(session) & _partition_mask;
+  }
+
+private:
+  RuntimeConfig _config;
+  session_factory_t _session_factory;
+  std::size_t _partition_mask{0};
+
+  // the pipeline owning each partition, read by the producers on every push
+  std::unique_ptr<std::atomic<uint32_t>[]> _owners;
+
+  std::vector<std::unique_ptr<Producer>> _producers;
+  std::vector<std::unique_ptr<Pipeline>> _pipelines;
+};
+} // namespace ets
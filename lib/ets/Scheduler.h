@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #include <immintrin.h>
+#endif
+
+#include "CacheLine.h"
+
+namespace ets
+{
+/**
+ * Parks a processor thread until it has work to do.
+ *
+ * The processor thread owns the scheduler. It schedules when it needs to wake up, usually the
+ * delay returned by a throttler, and calls wait() when it runs out of work. Producer threads call
+ * notify() after they push new ingress for the processor thread.
+ *
+ * wait() first busy polls for the configured spin duration, so latency sensitive deployments
+ * can keep the thread hot, and then parks on a condition variable until either a notification
+ * arrives or the scheduled time is reached. notify() only takes the lock when the processor
+ * thread is parked.
+ */
+class Scheduler
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  /**
+   * @param spin_duration how long to busy poll before parking the thread, 0 to park immediately
+   */
+  explicit Scheduler(std::chrono::nanoseconds spin_duration = std::chrono::nanoseconds{0})
+    : _spin_duration(spin_duration)
+  {
+  }
+
+  /**
+   * Wakes up the processor thread. Can be called by any thread
+   */
+  void notify() noexcept
+  {
+    _notified.value.store(true, std::memory_order_seq_cst);
+
+    if (_parked.load(std::memory_order_seq_cst))
+    {
+      // take the lock so the notification can not be lost between the parked thread checking the
+      // flag and starting to wait
+      {
+        std::lock_guard lock{_mutex};
+      }
+      _cv.notify_one();
+    }
+  }
+
+  /**
+   * Schedules the processor thread to wake up after `delay`, replacing any previous schedule
+   */
+  void schedule(std::chrono::nanoseconds delay) noexcept { _deadline = clock_t::now() + delay; }
+
+  /**
+   * Schedules the processor thread to wake up at `deadline`, replacing any previous schedule
+   */
+  void schedule_at(clock_t::time_point deadline) noexcept { _deadline = deadline; }
+
+  /**
+   * Removes the scheduled wake up, the thread only wakes up on notify()
+   */
+  void cancel() noexcept { _deadline = clock_t::time_point{}; }
+
+  [[nodiscard]] bool is_scheduled() const noexcept { return _deadline != clock_t::time_point{}; }
+
+  /**
+   * @return true if the scheduled time is reached
+   */
+  [[nodiscard]] bool is_due(clock_t::time_point now = clock_t::now()) const noexcept
+  {
+    return is_scheduled() && now >= _deadline;
+  }
+
+  /**
+   * Blocks the processor thread until a notification arrives or the scheduled time is reached.
+   * Returns immediately if there was a notification since the last call
+   */
+  void wait()
+  {
+    if (_spin_duration.count() != 0)
+    {
+      // busy poll first
+      auto const spin_end = clock_t::now() + _spin_duration;
+      auto now = clock_t::now();
+      while (now < spin_end)
+      {
+        if (_consume_notification() || is_due(now))
+        {
+          return;
+        }
+
+        _pause();
+        now = clock_t::now();
+      }
+    }
+
+    _parked.store(true, std::memory_order_seq_cst);
+
+    if (!_notified.value.load(std::memory_order_seq_cst) && !is_due())
+    {
+      std::unique_lock lock{_mutex};
+      auto const is_notified = [this]() { return _notified.value.load(std::memory_order_seq_cst); };
+
+      if (is_scheduled())
+      {
+        _cv.wait_until(lock, _deadline, is_notified);
+      }
+      else
+      {
+        _cv.wait(lock, is_notified);
+      }
+    }
+
+    _parked.store(false, std::memory_order_relaxed);
+    (void)_consume_notification();
+  }
+
+private:
+  [[nodiscard]] bool _consume_notification() noexcept
+  {
+    // check with a load first to not write the cache line when there is nothing
+    return _notified.value.load(std::memory_order_relaxed) &&
+      _notified.value.exchange(false, std::memory_order_acquire);
+  }
+
+  static void _pause() noexcept
+  {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#endif
+  }
+
+private:
+  // written by the producers
+  struct alignas(cache_line_size) NotifiedFlag
+  {
+    std::atomic<bool> value{false};
+  };
+
+  NotifiedFlag _notified;
+
+  // owned by the processor thread
+  alignas(cache_line_size) std::atomic<bool> _parked{false};
+  std::chrono::nanoseconds _spin_duration;
+  clock_t::time_point _deadline{};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+};
+} // namespace ets
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BatchAdmission.h"
+#include "CacheLine.h"
+#include "TimestampRing.h"
+
+namespace ets
+{
+/**
+ * A ConcurrentSlidingWindow whose state lives in a named POSIX shared memory segment, so many
+ * processes, e.g. several gateways trading on one exchange login, draw from one window. A
+ * request is the same few atomic operations as in process, there is no lock and no round trip
+ * to a central limiter.
+ *
+ * The first process to open the name creates and initializes the segment, the others check that
+ * its layout version, max_messages and interval match and throw std::runtime_error otherwise.
+ * The segment outlives the processes, remove() deletes it, e.g. when the venue resets the limit.
+ *
+ * Crash recovery:
+ *  - a process that dies while initializing the segment is detected by its pid once the
+ *    init timeout passes, and the next process to open the segment initializes it again
+ *  - a process that dies after claiming a message but before writing its timestamp is detected
+ *    by the other senders once the stale claim timeout passes, and the claim is completed with
+ *    the time of the sender that found it, which only delays the following messages
+ *
+ * The clock must give the same time in all the processes, e.g. steady_clock on one host.
+ *
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h
+ */
+template <typename TClock = std::chrono::steady_clock>
+class SharedSlidingWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  static constexpr uint32_t layout_version = 1;
+
+  /**
+   * Opens the segment with the given name, creating it if it does not exist
+   * @param name POSIX shared memory name, e.g. "/ets.login.1"
+   * @param stale_timeout how long to wait for another process before assuming it died
+   */
+  SharedSlidingWindow(std::string const& name, std::size_t max_messages, std::chrono::nanoseconds interval,
+                      std::chrono::nanoseconds stale_timeout = std::chrono::seconds{1})
+    : _max_messages(std::max<std::size_t>(max_messages, 1)),
+      _size(_segment_size(_max_messages)),
+      _ring(_open(name, interval, stale_timeout))
+  {
+  }
+
+  SharedSlidingWindow(SharedSlidingWindow&& other) noexcept
+    : _max_messages(other._max_messages),
+      _size(other._size),
+      _segment(std::exchange(other._segment, nullptr)),
+      _ring(std::move(other._ring))
+  {
+  }
+
+  SharedSlidingWindow(SharedSlidingWindow const&) = delete;
+  SharedSlidingWindow& operator=(SharedSlidingWindow const&) = delete;
+  SharedSlidingWindow& operator=(SharedSlidingWindow&&) = delete;
+
+  ~SharedSlidingWindow()
+  {
+    if (_segment != nullptr)
+    {
+      ::munmap(_segment, _size);
+    }
+  }
+
+  /**
+   * Deletes the segment. Processes that have it open keep using it, new processes create a new one
+   * @return true if the segment existed
+   */
+  static bool remove(std::string const& name) noexcept { return ::shm_unlink(name.c_str()) == 0; }
+
+  /**
+   * Request to send a new message. Can be called by any thread of any process
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time. Can be called by any thread of any process
+   * @param now current time of TClock
+   * @return how many nanoseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now) { return request_n(1, now).delay; }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    return _ring.request_n(n, std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+  }
+
+private:
+  static constexpr uint64_t magic = 0x6574732e77696e64; // "ets.wind"
+
+  enum State : uint32_t
+  {
+    uninitialized = 0,
+    initializing = 1,
+    ready = 2
+  };
+
+  // the layout of the segment, the slots of the ring follow the header
+  struct Header
+  {
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> initializer_pid;
+    uint32_t layout_version;
+    uint64_t magic;
+    uint64_t max_messages;
+    int64_t interval_ns;
+
+    alignas(cache_line_size) std::atomic<uint64_t> sequence;
+  };
+
+  static constexpr std::size_t slots_offset = (sizeof(Header) + cache_line_size - 1) / cache_line_size * cache_line_size;
+
+  [[nodiscard]] static std::size_t _segment_size(std::size_t max_messages) noexcept
+  {
+    return slots_offset + max_messages * sizeof(TimestampRing::Slot);
+  }
+
+  [[nodiscard]] Header& _header() const noexcept { return *static_cast<Header*>(_segment); }
+
+  [[nodiscard]] TimestampRing::Slot* _slots() const noexcept
+  {
+    return reinterpret_cast<TimestampRing::Slot*>(static_cast<std::byte*>(_segment) + slots_offset);
+  }
+
+  [[nodiscard]] TimestampRing _open(std::string const& name, std::chrono::nanoseconds interval,
+                                    std::chrono::nanoseconds stale_timeout)
+  {
+    _map(name);
+    _initialize(interval, stale_timeout);
+    return TimestampRing{_header().sequence, _slots(), _max_messages, interval, stale_timeout};
+  }
+
+  void _map(std::string const& name)
+  {
+    int const fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0660);
+    if (fd == -1)
+    {
+      throw std::system_error(errno, std::system_category(), "shm_open " + name);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) == -1)
+    {
+      int const error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::system_category(), "fstat " + name);
+    }
+
+    // a new segment is empty, extending it fills it with zeros
+    if ((st.st_size == 0) && (::ftruncate(fd, static_cast<off_t>(_size)) == -1))
+    {
+      int const error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::system_category(), "ftruncate " + name);
+    }
+
+    if ((st.st_size != 0) && (static_cast<std::size_t>(st.st_size) != _size))
+    {
+      ::close(fd);
+      throw std::runtime_error("ets::SharedSlidingWindow: " + name + " has a different max_messages");
+    }
+
+    void* segment = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int const error = errno;
+    ::close(fd);
+
+    if (segment == MAP_FAILED)
+    {
+      throw std::system_error(error, std::system_category(), "mmap " + name);
+    }
+
+    _segment = segment;
+  }
+
+  void _initialize(std::chrono::nanoseconds interval, std::chrono::nanoseconds stale_timeout)
+  {
+    Header& header = _header();
+    auto const wait_start = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+      uint32_t state = header.state.load(std::memory_order_acquire);
+
+      if (state == ready)
+      {
+        break;
+      }
+
+      if ((state == uninitialized) &&
+          header.state.compare_exchange_strong(state, initializing, std::memory_order_acquire))
+      {
+        _write_header(interval);
+        break;
+      }
+
+      if ((state == initializing) && (std::chrono::steady_clock::now() - wait_start >= stale_timeout))
+      {
+        // the initializer is gone if it did not publish its pid or its process does not exist
+        int32_t pid = header.initializer_pid.load(std::memory_order_relaxed);
+        bool const is_dead = (pid == 0) || ((::kill(pid, 0) == -1) && (errno == ESRCH));
+
+        if (is_dead && header.initializer_pid.compare_exchange_strong(pid, ::getpid(), std::memory_order_acquire))
+        {
+          _write_header(interval);
+          break;
+        }
+      }
+
+      std::this_thread::yield();
+    }
+
+    if ((header.magic != magic) || (header.layout_version != layout_version) ||
+        (header.max_messages != _max_messages) || (header.interval_ns != interval.count()))
+    {
+      ::munmap(std::exchange(_segment, nullptr), _size);
+      throw std::runtime_error("ets::SharedSlidingWindow: the segment has a different layout or limit");
+    }
+  }
+
+  void _write_header(std::chrono::nanoseconds interval)
+  {
+    Header& header = _header();
+    header.initializer_pid.store(::getpid(), std::memory_order_relaxed);
+
+    // reset the ring, a previous initializer might have died half way
+    header.sequence.store(0, std::memory_order_relaxed);
+    TimestampRing::Slot* slots = _slots();
+    for (std::size_t i = 0; i < _max_messages; ++i)
+    {
+      ::new (static_cast<void*>(&slots[i])) TimestampRing::Slot{{0}, {0}};
+    }
+
+    header.magic = magic;
+    header.layout_version = layout_version;
+    header.max_messages = _max_messages;
+    header.interval_ns = interval.count();
+
+    // publish the configuration to the other processes
+    header.state.store(ready, std::memory_order_release);
+  }
+
+private:
+  std::size_t _max_messages;
+  std::size_t _size;
+  void* _segment{nullptr};
+  TimestampRing _ring;
+};
+} // namespace ets
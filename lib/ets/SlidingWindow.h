@@ -1,5 +1,11 @@
+#pragma once
+
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include "BatchAdmission.h"
 #include "CircularBuffer.h"
 
 namespace ets
@@ -7,12 +13,25 @@ namespace ets
 /**
  * Tracks send messages in the configured sliding window
  * This class uses a circular buffer where it stores timestamps.
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h
  */
+template <typename TClock = std::chrono::steady_clock>
 class SlidingWindow
 {
 public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
   SlidingWindow(std::size_t max_messages, std::chrono::nanoseconds interval)
-    : _max_messages(max_messages), _interval(interval), _buffer(_max_messages)
+    : _interval(interval), _buffer(max_messages)
+  {
+  }
+
+  /**
+   * @param resource where the timestamps are allocated, e.g. on the NUMA node of the session
+   */
+  SlidingWindow(std::size_t max_messages, std::chrono::nanoseconds interval, std::pmr::memory_resource* resource)
+    : _interval(interval), _buffer(max_messages, resource)
   {
   }
 
@@ -21,16 +40,24 @@ public:
    * @return how many milliseconds left until we can send a message or 0 if the message was
    * sent without any delay
    */
-  [[nodiscard]] std::chrono::nanoseconds request()
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time. Used when the caller already read the
+   * clock, e.g. to send many messages with a single clock read
+   * @param now current time of TClock
+   * @return how many milliseconds left until we can send a message or 0 if the message was
+   * sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now)
   {
     // The back message in the buffer is the oldest.
     // We compare the current time with the back message.
     // If it now falls outside the window we can send a new message.
     // If it doesn't and the buffer is full of messages, then we have hit the limit
-    auto const now = std::chrono::steady_clock::now();
     auto const dif_from_oldest = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _buffer.back());
 
-    if ((dif_from_oldest <= _interval) && _buffer.is_full())
+    if ((dif_from_oldest < _interval) && _buffer.is_full())
     {
       // we can not send more messages, return the milliseconds we can send a new message
       return _interval - dif_from_oldest;
@@ -41,9 +68,309 @@ public:
     return std::chrono::nanoseconds{0};
   }
 
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now)
+  {
+    BatchAdmission result;
+    result.admitted = admissible(n, now);
+    commit(result.admitted, now);
+
+    if (result.admitted < n)
+    {
+      // the buffer is full, the rest can be sent when the oldest message leaves the window
+      result.delay = delay(now);
+    }
+
+    return result;
+  }
+
+  /**
+   * How long until one more message can be sent at the given time, without sending it.
+   * delay(), admissible() and commit() let a caller check several windows before sending, see
+   * CompositeWindow.h
+   * @param now current time of TClock
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now) const
+  {
+    auto const dif_from_oldest = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _buffer.back());
+    return ((dif_from_oldest < _interval) && _buffer.is_full()) ? _interval - dif_from_oldest : std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * @return how many of `n` messages can be sent at the given time, without sending them
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now) const
+  {
+    // free slots can always be used, then every timestamp that fell outside the window can be
+    // replaced. The timestamps are ordered from the oldest so we stop at the first one in the window
+    std::size_t const free_slots = _buffer.capacity() - _buffer.size();
+    std::size_t expired{0};
+    while ((free_slots + expired < n) && (expired < _buffer.size()) && (now - _buffer[expired] >= _interval))
+    {
+      ++expired;
+    }
+
+    return std::min(n, free_slots + expired);
+  }
+
+  /**
+   * Records `n` messages sent at the given time
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now) noexcept { _buffer.insert_n(now, n); }
+
+  /**
+   * @return how many messages were sent in the last `duration`, e.g. for pre-trade risk checks
+   */
+  [[nodiscard]] std::size_t count_in_window(std::chrono::nanoseconds duration) const
+  {
+    return count_in_window(duration, TClock::now());
+  }
+
+  /**
+   * @return how many messages were sent in the `duration` before the given time, found with a
+   * binary search of the sorted timestamps, at most max_messages
+   */
+  [[nodiscard]] std::size_t count_in_window(std::chrono::nanoseconds duration, time_point now) const noexcept
+  {
+    return count_greater(_buffer, std::chrono::time_point_cast<typename time_point::duration>(now - duration));
+  }
+
+  /**
+   * @return how many messages can be sent now, e.g. to route to the session with most room
+   */
+  [[nodiscard]] std::size_t remaining_capacity() const { return remaining_capacity(TClock::now()); }
+
+  /**
+   * @return how many messages can be sent at the given time
+   */
+  [[nodiscard]] std::size_t remaining_capacity(time_point now) const noexcept
+  {
+    return _buffer.capacity() - count_in_window(_interval, now);
+  }
+
+  /**
+   * @return number of recorded timestamps, at most max_messages
+   */
+  [[nodiscard]] std::size_t size() const noexcept { return _buffer.size(); }
+
+  /**
+   * @return the i-th oldest recorded timestamp, used to take a snapshot, see Snapshot.h
+   */
+  [[nodiscard]] time_point timestamp(std::size_t i) const noexcept { return _buffer[i]; }
+
+  /**
+   * Records a message sent at the given time, used to restore a snapshot. The timestamps must be
+   * restored from the oldest
+   */
+  void restore(time_point timestamp) noexcept { _buffer.insert(timestamp); }
+
+  /**
+   * Changes the limit without losing the messages sent so far, e.g. when the venue changes its
+   * limits intraday or asks to slow down, see AdaptiveWindow.h. The newest timestamps that fit
+   * in the new limit are kept, so a smaller limit delays the next messages right away
+   * @param max_messages new max number of messages in the window
+   * @param interval new window length
+   */
+  void set_limit(std::size_t max_messages, std::chrono::nanoseconds interval)
+  {
+    if (max_messages != _buffer.capacity())
+    {
+      _buffer.resize(max_messages);
+    }
+
+    _interval = interval;
+  }
+
+  [[nodiscard]] std::size_t max_messages() const noexcept { return _buffer.capacity(); }
+
+  [[nodiscard]] std::chrono::nanoseconds interval() const noexcept { return _interval; }
+
 private:
-  std::size_t _max_messages;
+  // the limit is the capacity of the buffer, so the whole window fits in one cache line
   std::chrono::nanoseconds _interval;
-  CircularBuffer<std::chrono::steady_clock::time_point> _buffer;
+  CircularBuffer<time_point> _buffer;
+};
+
+/**
+ * An interval known at compile time, used as a template argument of FixedSlidingWindow. Any
+ * std::chrono::duration converts to it, e.g. FixedSlidingWindow<3, std::chrono::seconds{1}>
+ */
+struct FixedInterval
+{
+  template <typename TRep, typename TPeriod>
+  constexpr FixedInterval(std::chrono::duration<TRep, TPeriod> interval) noexcept
+    : ns(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count())
+  {
+  }
+
+  int64_t ns;
+};
+
+/**
+ * A SlidingWindow whose limit is known at compile time. The timestamps are stored inline in a
+ * CircularBuffer<time_point, MaxMessages> and the interval is a constant, so request() is a
+ * load, a compare and a store without any pointer chase.
+ *
+ * It is default constructible, pass it to the throttler constructor which takes a window.
+ * @tparam MaxMessages max number of messages in the window
+ * @tparam Interval the window length
+ * @tparam TClock clock policy used to timestamp the messages, see Clock.h
+ */
+template <std::size_t MaxMessages, FixedInterval Interval, typename TClock = std::chrono::steady_clock>
+class FixedSlidingWindow
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+
+  static constexpr std::size_t max_messages = MaxMessages;
+  static constexpr std::chrono::nanoseconds interval{Interval.ns};
+
+  static_assert(interval.count() > 0, "the interval must be positive");
+
+  /**
+   * Request to send a new message
+   * @return how long until we can send a message or 0 if the message was sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request() { return request(TClock::now()); }
+
+  /**
+   * Request to send a new message at the given time
+   * @param now current time of TClock
+   * @return how long until we can send a message or 0 if the message was sent without any delay
+   */
+  [[nodiscard]] std::chrono::nanoseconds request(time_point now) noexcept
+  {
+    auto const dif_from_oldest = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _buffer.back());
+
+    if ((dif_from_oldest < interval) && _buffer.is_full())
+    {
+      return interval - dif_from_oldest;
+    }
+
+    _buffer.insert(now);
+
+    return std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * Request to send `n` messages at once with a single clock read
+   * @param n number of messages
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n) { return request_n(n, TClock::now()); }
+
+  /**
+   * Request to send `n` messages at once at the given time
+   * @param n number of messages
+   * @param now current time of TClock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, time_point now) noexcept
+  {
+    BatchAdmission result;
+    result.admitted = admissible(n, now);
+    commit(result.admitted, now);
+
+    if (result.admitted < n)
+    {
+      result.delay = delay(now);
+    }
+
+    return result;
+  }
+
+  /**
+   * How long until one more message can be sent at the given time, without sending it
+   * @param now current time of TClock
+   */
+  [[nodiscard]] std::chrono::nanoseconds delay(time_point now) const noexcept
+  {
+    auto const dif_from_oldest = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _buffer.back());
+    return ((dif_from_oldest < interval) && _buffer.is_full()) ? interval - dif_from_oldest : std::chrono::nanoseconds{0};
+  }
+
+  /**
+   * @return how many of `n` messages can be sent at the given time, without sending them
+   */
+  [[nodiscard]] std::size_t admissible(std::size_t n, time_point now) const noexcept
+  {
+    std::size_t const free_slots = max_messages - _buffer.size();
+    std::size_t expired{0};
+    while ((free_slots + expired < n) && (expired < _buffer.size()) && (now - _buffer[expired] >= interval))
+    {
+      ++expired;
+    }
+
+    return std::min(n, free_slots + expired);
+  }
+
+  /**
+   * Records `n` messages sent at the given time
+   * @param n at most admissible(n, now)
+   */
+  void commit(std::size_t n, time_point now) noexcept { _buffer.insert_n(now, n); }
+
+  /**
+   * @return how many messages were sent in the last `duration`, e.g. for pre-trade risk checks
+   */
+  [[nodiscard]] std::size_t count_in_window(std::chrono::nanoseconds duration) const
+  {
+    return count_in_window(duration, TClock::now());
+  }
+
+  /**
+   * @return how many messages were sent in the `duration` before the given time, found with a
+   * binary search of the sorted timestamps, at most max_messages
+   */
+  [[nodiscard]] std::size_t count_in_window(std::chrono::nanoseconds duration, time_point now) const noexcept
+  {
+    return count_greater(_buffer, std::chrono::time_point_cast<typename time_point::duration>(now - duration));
+  }
+
+  /**
+   * @return how many messages can be sent now, e.g. to route to the session with most room
+   */
+  [[nodiscard]] std::size_t remaining_capacity() const { return remaining_capacity(TClock::now()); }
+
+  /**
+   * @return how many messages can be sent at the given time
+   */
+  [[nodiscard]] std::size_t remaining_capacity(time_point now) const noexcept
+  {
+    return max_messages - count_in_window(interval, now);
+  }
+
+  /**
+   * @return number of recorded timestamps, at most max_messages
+   */
+  [[nodiscard]] std::size_t size() const noexcept { return _buffer.size(); }
+
+  /**
+   * @return the i-th oldest recorded timestamp, used to take a snapshot, see Snapshot.h
+   */
+  [[nodiscard]] time_point timestamp(std::size_t i) const noexcept { return _buffer[i]; }
+
+  /**
+   * Records a message sent at the given time, used to restore a snapshot. The timestamps must be
+   * restored from the oldest
+   */
+  void restore(time_point timestamp) noexcept { _buffer.insert(timestamp); }
+
+private:
+  CircularBuffer<time_point, MaxMessages> _buffer;
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ets
+{
+/**
+ * Snapshots of the state of a throttler for a warm restart.
+ *
+ * A gateway that restarts mid session starts with an empty window, which can breach the venue
+ * limit in the first interval. A snapshot saves the timestamps of the window and the queued
+ * messages in a file, and restoring it on startup lets the gateway resume at the full rate the
+ * window allows right away.
+ *
+ * The window clock usually only makes sense within a process, e.g. steady_clock, so the
+ * timestamps are saved relative to the wall clock TWallClock and converted back to the window
+ * clock when restored. A timestamp that would be in the future is restored as now.
+ *
+ * The queued messages are saved by a user serializer, which writes each message type with its
+ * own tag and fields:
+ *   save(SnapshotWriter&, TMessage const&)   for each queued message type
+ *   load(SnapshotReader&, TThrottler&)       reads one message and calls queue_message() on
+ *                                            the throttler
+ *
+ * The file is written to a temporary file that is renamed over the snapshot, so a crash while
+ * saving leaves the previous snapshot, and both saving and restoring copy the file through a
+ * memory mapping.
+ */
+
+/**
+ * Appends the serialized messages of a snapshot
+ */
+class SnapshotWriter
+{
+public:
+  void write_bytes(void const* data, std::size_t size)
+  {
+    auto const* bytes = static_cast<std::byte const*>(data);
+    _bytes.insert(_bytes.end(), bytes, bytes + size);
+  }
+
+  template <typename T>
+  void write(T const& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable values can be written as bytes");
+    write_bytes(&value, sizeof(T));
+  }
+
+  /**
+   * Writes the size and the characters of a string
+   */
+  void write_string(std::string_view value)
+  {
+    write(static_cast<uint64_t>(value.size()));
+    write_bytes(value.data(), value.size());
+  }
+
+  [[nodiscard]] std::span<std::byte const> bytes() const noexcept { return _bytes; }
+
+private:
+  std::vector<std::byte> _bytes;
+};
+
+/**
+ * Reads the serialized messages of a snapshot. Throws std::runtime_error when reading past the
+ * end of the snapshot
+ */
+class SnapshotReader
+{
+public:
+  explicit SnapshotReader(std::span<std::byte const> bytes) noexcept : _bytes(bytes) {}
+
+  void read_bytes(void* data, std::size_t size)
+  {
+    if (size > _bytes.size())
+    {
+      throw std::runtime_error("ets::SnapshotReader: the snapshot is truncated");
+    }
+
+    std::memcpy(data, _bytes.data(), size);
+    _bytes = _bytes.subspan(size);
+  }
+
+  template <typename T>
+  [[nodiscard]] T read()
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable values can be read as bytes");
+    T value;
+    read_bytes(&value, sizeof(T));
+    return value;
+  }
+
+  [[nodiscard]] std::string read_string()
+  {
+    auto const size = read<uint64_t>();
+    if (size > _bytes.size())
+    {
+      throw std::runtime_error("ets::SnapshotReader: the snapshot is truncated");
+    }
+
+    std::string value(size, '\0');
+    read_bytes(value.data(), value.size());
+    return value;
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return _bytes.empty(); }
+
+private:
+  std::span<std::byte const> _bytes;
+};
+
+struct SnapshotLayout
+{
+  static constexpr uint64_t magic = 0x3150414e53535445; // "ETSSNAP1" in little endian
+  static constexpr uint32_t layout_version = 1;
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t layout_version;
+    uint32_t timestamps;
+    uint64_t payload_size;
+  };
+
+  // the wall clock timestamps in nanoseconds follow the header, then the payload
+  static_assert(sizeof(Header) % alignof(int64_t) == 0);
+
+  /**
+   * Writes a snapshot file
+   */
+  static void save(std::string const& path, std::span<int64_t const> timestamps, std::span<std::byte const> payload)
+  {
+    Header const header{magic, layout_version, static_cast<uint32_t>(timestamps.size()), payload.size()};
+    std::size_t const size = sizeof(Header) + timestamps.size_bytes() + payload.size();
+    std::string const temporary_path = path + ".tmp";
+
+    int const fd = ::open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+      throw std::system_error(errno, std::system_category(), "open " + temporary_path);
+    }
+
+    if (::ftruncate(fd, static_cast<off_t>(size)) == -1)
+    {
+      int const error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::system_category(), "ftruncate " + temporary_path);
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int const error = errno;
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+      throw std::system_error(error, std::system_category(), "mmap " + temporary_path);
+    }
+
+    auto* bytes = static_cast<std::byte*>(mapping);
+    std::memcpy(bytes, &header, sizeof(Header));
+    if (!timestamps.empty())
+    {
+      std::memcpy(bytes + sizeof(Header), timestamps.data(), timestamps.size_bytes());
+    }
+    if (!payload.empty())
+    {
+      std::memcpy(bytes + sizeof(Header) + timestamps.size_bytes(), payload.data(), payload.size());
+    }
+    ::munmap(mapping, size);
+
+    if (::rename(temporary_path.c_str(), path.c_str()) == -1)
+    {
+      throw std::system_error(errno, std::system_category(), "rename " + temporary_path);
+    }
+  }
+
+  /**
+   * A read only mapping of a snapshot file
+   */
+  class Mapping
+  {
+  public:
+    /**
+     * @return false if the file does not exist
+     */
+    [[nodiscard]] bool open(std::string const& path)
+    {
+      int const fd = ::open(path.c_str(), O_RDONLY);
+      if (fd == -1)
+      {
+        if (errno == ENOENT)
+        {
+          return false;
+        }
+        throw std::system_error(errno, std::system_category(), "open " + path);
+      }
+
+      struct stat st{};
+      if (::fstat(fd, &st) == -1)
+      {
+        int const error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::system_category(), "fstat " + path);
+      }
+
+      _size = static_cast<std::size_t>(st.st_size);
+      if (_size < sizeof(Header))
+      {
+        ::close(fd);
+        throw std::runtime_error("ets::Snapshot: " + path + " is truncated");
+      }
+
+      void* mapping = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      int const error = errno;
+      ::close(fd);
+
+      if (mapping == MAP_FAILED)
+      {
+        throw std::system_error(error, std::system_category(), "mmap " + path);
+      }
+
+      _mapping = static_cast<std::byte const*>(mapping);
+      std::memcpy(&_header, _mapping, sizeof(Header));
+
+      if ((_header.magic != magic) || (_header.layout_version != layout_version) ||
+          (_size != sizeof(Header) + _header.timestamps * sizeof(int64_t) + _header.payload_size))
+      {
+        throw std::runtime_error("ets::Snapshot: " + path + " has a different layout");
+      }
+
+      return true;
+    }
+
+    Mapping() = default;
+    Mapping(Mapping const&) = delete;
+    Mapping& operator=(Mapping const&) = delete;
+
+    ~Mapping()
+    {
+      if (_mapping != nullptr)
+      {
+        ::munmap(const_cast<std::byte*>(_mapping), _size);
+      }
+    }
+
+    [[nodiscard]] std::size_t timestamps() const noexcept { return _header.timestamps; }
+
+    [[nodiscard]] int64_t timestamp(std::size_t i) const noexcept
+    {
+      int64_t value;
+      std::memcpy(&value, _mapping + sizeof(Header) + i * sizeof(int64_t), sizeof(int64_t));
+      return value;
+    }
+
+    [[nodiscard]] std::span<std::byte const> payload() const noexcept
+    {
+      return {_mapping + sizeof(Header) + _header.timestamps * sizeof(int64_t), _header.payload_size};
+    }
+
+  private:
+    std::byte const* _mapping{nullptr};
+    std::size_t _size{0};
+    Header _header{};
+  };
+};
+
+/**
+ * Saves the timestamps of a window and a payload to a file
+ * @param path the snapshot file, replaced if it exists
+ * @param window a window with the snapshot interface of SlidingWindow: size(), timestamp(i) and
+ * restore(timestamp)
+ * @param write_payload called with a SnapshotWriter to append the payload
+ */
+template <typename TWallClock = std::chrono::system_clock, typename TWindow, typename TWritePayload>
+void save_snapshot(std::string const& path, TWindow const& window, TWritePayload&& write_payload)
+{
+  using window_clock_t = typename TWindow::clock_t;
+
+  auto const now = window_clock_t::now();
+  auto const wall_now = TWallClock::now();
+
+  std::vector<int64_t> timestamps;
+  timestamps.reserve(window.size());
+  for (std::size_t i = 0; i < window.size(); ++i)
+  {
+    auto const wall_timestamp =
+      wall_now - std::chrono::duration_cast<typename TWallClock::duration>(now - window.timestamp(i));
+    timestamps.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(wall_timestamp.time_since_epoch()).count());
+  }
+
+  SnapshotWriter writer;
+  write_payload(writer);
+
+  SnapshotLayout::save(path, timestamps, writer.bytes());
+}
+
+template <typename TWallClock = std::chrono::system_clock, typename TWindow>
+void save_snapshot(std::string const& path, TWindow const& window)
+{
+  save_snapshot<TWallClock>(path, window, [](SnapshotWriter&) {});
+}
+
+/**
+ * Restores the timestamps of a window and reads the payload from a file written by
+ * save_snapshot(). The window should be empty
+ * @param read_payload called with a SnapshotReader of the payload
+ * @return false if there is no snapshot file
+ */
+template <typename TWallClock = std::chrono::system_clock, typename TWindow, typename TReadPayload>
+[[nodiscard]] bool restore_snapshot(std::string const& path, TWindow& window, TReadPayload&& read_payload)
+{
+  using window_clock_t = typename TWindow::clock_t;
+
+  SnapshotLayout::Mapping mapping;
+  if (!mapping.open(path))
+  {
+    return false;
+  }
+
+  auto const now = window_clock_t::now();
+  auto const wall_now = TWallClock::now();
+
+  for (std::size_t i = 0; i < mapping.timestamps(); ++i)
+  {
+    auto const age = wall_now - typename TWallClock::time_point{std::chrono::duration_cast<typename TWallClock::duration>(
+                                  std::chrono::nanoseconds{mapping.timestamp(i)})};
+    auto const since = std::max(std::chrono::duration_cast<typename window_clock_t::duration>(age),
+                                typename window_clock_t::duration{0});
+    window.restore(now - since);
+  }
+
+  SnapshotReader reader{mapping.payload()};
+  read_payload(reader);
+
+  return true;
+}
+
+template <typename TWallClock = std::chrono::system_clock, typename TWindow>
+[[nodiscard]] bool restore_snapshot(std::string const& path, TWindow& window)
+{
+  return restore_snapshot<TWallClock>(path, window, [](SnapshotReader&) {});
+}
+
+/**
+ * Saves the window and the queued messages of a throttler. The tiers of the throttler must store
+ * typed messages, see PriorityThrottler::for_each_queued()
+ * @param serializer writes the queued messages, see above
+ */
+template <typename TWallClock = std::chrono::system_clock, typename TThrottler, typename TSerializer>
+void save_throttler_snapshot(std::string const& path, TThrottler const& throttler, TSerializer& serializer)
+{
+  save_snapshot<TWallClock>(path, throttler.window(),
+                            [&throttler, &serializer](SnapshotWriter& writer)
+                            {
+                              throttler.for_each_queued([&serializer, &writer](auto const& message)
+                                                        { serializer.save(writer, message); });
+                            });
+}
+
+/**
+ * Restores the window and the queued messages of a throttler saved by save_throttler_snapshot().
+ * The throttler should be new
+ * @param serializer reads the queued messages and queues them in the throttler, see above
+ * @return false if there is no snapshot file
+ */
+template <typename TWallClock = std::chrono::system_clock, typename TThrottler, typename TSerializer>
+[[nodiscard]] bool restore_throttler_snapshot(std::string const& path, TThrottler& throttler, TSerializer& serializer)
+{
+  return restore_snapshot<TWallClock>(path, throttler.window(),
+                                      [&throttler, &serializer](SnapshotReader& reader)
+                                      {
+                                        while (!reader.empty())
+                                        {
+                                          serializer.load(reader, throttler);
+                                        }
+                                      });
+}
+} // namespace ets
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "CacheLine.h"
+
+namespace ets
+{
+/**
+ * A bounded lock free single producer single consumer queue.
+ *
+ * Items are constructed in place in a ring of power of two capacity. The producer and the
+ * consumer each own one counter on its own cache line and keep a cached copy of the counter of
+ * the other side, so the shared line is only read again when the ring looks full to the producer
+ * or empty to the consumer. There is no compare and swap and no sequence number per cell as in
+ * MpscQueue.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(std::size_t capacity)
+  {
+    std::size_t rounded_capacity{2};
+    while (rounded_capacity < capacity)
+    {
+      rounded_capacity <<= 1;
+    }
+
+    _mask = rounded_capacity - 1;
+    _cells = std::make_unique<Cell[]>(rounded_capacity);
+  }
+
+  SpscQueue(SpscQueue const&) = delete;
+  SpscQueue& operator=(SpscQueue const&) = delete;
+
+  ~SpscQueue()
+  {
+    // destroy any items that were never consumed
+    consume([](T&) {});
+  }
+
+  /**
+   * Tries to construct a new item at the back of the queue. Must only be called by the producer
+   * thread
+   * @return false if the queue is full
+   */
+  template <typename... Args>
+  [[nodiscard]] bool try_emplace(Args&&... args)
+  {
+    std::size_t const tail = _producer.tail.load(std::memory_order_relaxed);
+
+    if (tail - _producer.cached_head > _mask)
+    {
+      // looks full, read the position of the consumer again
+      _producer.cached_head = _consumer.head.load(std::memory_order_acquire);
+      if (tail - _producer.cached_head > _mask)
+      {
+        return false;
+      }
+    }
+
+    ::new (static_cast<void*>(_cells[tail & _mask].storage)) T(std::forward<Args>(args)...);
+
+    // publish the item to the consumer
+    _producer.tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+  /**
+   * Pushes a new item, yields the thread while the queue is full. Must only be called by the
+   * producer thread
+   */
+  void push(T&& item)
+  {
+    while (!try_emplace(std::move(item)))
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * Consumes up to max_items ready items in order. Must only be called by the consumer thread
+   * @param func invoked with a reference to each item, the item is destroyed after the call
+   * @param max_items maximum items to consume in this batch
+   * @return number of consumed items
+   */
+  template <typename TFunc>
+  std::size_t consume(TFunc&& func, std::size_t max_items = SIZE_MAX)
+  {
+    std::size_t head = _consumer.head.load(std::memory_order_relaxed);
+
+    std::size_t consumed{0};
+    while (consumed < max_items)
+    {
+      if (head == _consumer.cached_tail)
+      {
+        // looks empty, read the position of the producer again
+        _consumer.cached_tail = _producer.tail.load(std::memory_order_acquire);
+        if (head == _consumer.cached_tail)
+        {
+          break;
+        }
+      }
+
+      T* item = std::launder(reinterpret_cast<T*>(_cells[head & _mask].storage));
+      func(*item);
+      std::destroy_at(item);
+
+      head += 1;
+      ++consumed;
+    }
+
+    // release the consumed cells to the producer at once
+    _consumer.head.store(head, std::memory_order_release);
+    return consumed;
+  }
+
+  /**
+   * @return true if there is no item ready to consume. Must only be called by the consumer thread
+   */
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return _consumer.head.load(std::memory_order_relaxed) == _producer.tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return the number of items pushed so far. Can be called by any thread, an item pushed before
+   * the call returned is counted
+   */
+  [[nodiscard]] std::size_t pushed() const noexcept { return _producer.tail.load(std::memory_order_acquire); }
+
+  /**
+   * @return the number of items consumed so far. Must only be called by the consumer thread
+   */
+  [[nodiscard]] std::size_t consumed() const noexcept { return _consumer.head.load(std::memory_order_relaxed); }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return _mask + 1; }
+
+private:
+  struct Cell
+  {
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  // the producer and the consumer each write their own counter on a separate cache line
+  struct alignas(cache_line_size) ProducerSide
+  {
+    std::atomic<std::size_t> tail{0};
+    std::size_t cached_head{0};
+  };
+
+  struct alignas(cache_line_size) ConsumerSide
+  {
+    std::atomic<std::size_t> head{0};
+    std::size_t cached_tail{0};
+  };
+
+private:
+  ProducerSide _producer;
+  ConsumerSide _consumer;
+  std::size_t _mask{0};
+  std::unique_ptr<Cell[]> _cells;
+};
+} // namespace ets
@@ -1,69 +1,273 @@
-#include <vector>
-#include <memory>
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
+#include "BatchAdmission.h"
+#include "Coalescing.h"
+#include "Expiry.h"
+#include "GcraWindow.h"
+#include "MessageStorage.h"
+#include "Metrics.h"
+#include "PriorityMap.h"
 #include "SlidingWindow.h"
 
 namespace ets
 {
+/**
+ * Limits how much work one drain of the backlog does, so the event loop can handle the ingress
+ * between the drains of a large backlog
+ */
+struct DrainBudget
+{
+  // max number of messages sent by the drain
+  std::size_t max_messages{std::numeric_limits<std::size_t>::max()};
+
+  // max time spent in the drain, checked before each message with the clock of the throttler
+  std::chrono::nanoseconds max_time{std::chrono::nanoseconds::max()};
+};
+
+/**
+ * The result of a drain with a budget
+ * @tparam Tiers number of tiers of the throttler
+ */
+template <std::size_t Tiers>
+struct DrainStatus
+{
+  // number of messages sent by the drain
+  std::size_t sent{0};
+
+  // the delay until the window admits the next message if the drain was throttled, otherwise 0
+  std::chrono::nanoseconds delay{0};
+
+  // the drain stopped because of its budget, the next drain can be run right away
+  bool budget_exhausted{false};
+
+  // the queued messages left in each tier
+  std::array<std::size_t, Tiers> remaining{};
+
+  [[nodiscard]] std::size_t remaining_total() const noexcept
+  {
+    std::size_t total{0};
+    for (std::size_t const queued : remaining)
+    {
+      total += queued;
+    }
+    return total;
+  }
+};
+
 /**
  * This is a message throttler class that also stores and queues messages.
  *
  * Usually each incoming message can be of a different type. Therefore, this class is templated to
  * support multiple type of messages.
  *
- * We pass the high priority message type as template parameter in order to prioritise that type
- * of messages over others.
+ * Throttled messages are queued by priority. TPriorityMap maps each message type to a tier at
+ * compile time, see PriorityMap.h. The messages of a tier are sent before the messages of lower
+ * tiers, and a bitmask of the non empty tiers lets the drain find the next tier in O(1).
+ *
+ * TWindow is the rate limit policy, either the exact SlidingWindow or the constant memory
+ * GcraWindow. Its clock_t is the clock policy, see Clock.h
+ *
+ * TCoalescing lets queued messages of the same order supersede each other, see Coalescing.h
+ *
+ * TMetrics is the instrumentation policy, see Metrics.h. By default nothing is recorded
  *
- * The rest messages are type erased and stored in vector and we access them later via a
- * virtual function
+ * TExpiry gives the queued messages a time to live, the drain releases the messages past their
+ * deadline without sending them, see Expiry.h
+ *
+ * A callback with an on_send_batch(std::span<TMessage const>) overload gets the messages of that
+ * type admitted together as one batch: the admitted prefix of try_send_batch() and the queued
+ * messages of a Tier<TMessage> sent by one drain, which are passed from the backlog without
+ * copying. Other messages still go to on_send(). Batches are not used in coalescing mode
  */
-template <typename THighPriorityMessage, typename TOnSendCallback>
-class Throttler
+template <typename TOnSendCallback, typename TPriorityMap, typename TWindow = SlidingWindow<>,
+          typename TCoalescing = NoCoalescing, typename TMetrics = NoMetrics, typename TExpiry = NoExpiry>
+class PriorityThrottler
 {
 public:
-  Throttler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback)
+  using window_t = TWindow;
+  using clock_t = typename TWindow::clock_t;
+  using priority_map_t = TPriorityMap;
+  using coalescing_t = TCoalescing;
+  using expiry_t = TExpiry;
+  using metrics_t = typename TMetrics::template recorder<TPriorityMap::tiers>;
+
+  static_assert(TCoalescing::template supports<TPriorityMap>,
+                "the priority map sends the amends before their new orders, see Coalescing.h");
+
+  PriorityThrottler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback)
   : sw(max_messages, interval), _on_send_callback(on_send_callback)
   {
   }
 
+  /**
+   * Constructs a throttler using an already configured window, e.g. a GcraWindow with a burst
+   */
+  PriorityThrottler(TWindow window, TOnSendCallback on_send_callback)
+  : sw(std::move(window)), _on_send_callback(on_send_callback)
+  {
+  }
+
+  /**
+   * Constructs a throttler whose window and backlog allocate from `resource`, e.g. a resource
+   * bound to the NUMA node of the thread using the throttler. The window uses it if it can be
+   * constructed with a resource like SlidingWindow, see also ArenaStorage in MessageStorage.h
+   */
+  PriorityThrottler(std::size_t max_messages, std::chrono::nanoseconds interval, TOnSendCallback on_send_callback,
+                    std::pmr::memory_resource* resource)
+  : sw(_make_window(max_messages, interval, resource)),
+    _tiers(_make_tiers(resource, std::make_index_sequence<TPriorityMap::tiers>{})),
+    _on_send_callback(on_send_callback)
+  {
+  }
+
+  /**
+   * Constructs a throttler using an already configured window and a backlog allocating from
+   * `resource`
+   */
+  PriorityThrottler(TWindow window, TOnSendCallback on_send_callback, std::pmr::memory_resource* resource)
+  : sw(std::move(window)),
+    _tiers(_make_tiers(resource, std::make_index_sequence<TPriorityMap::tiers>{})),
+    _on_send_callback(on_send_callback)
+  {
+  }
+
   /**
    * Tries to send a new message. If the message is throttled then returns the delay until the
-   * end of the sliding window
+   * end of the sliding window. An rvalue message is moved to the backlog when it is throttled,
+   * and to the callback if it accepts an rvalue, see send_message() in MessageStorage.h
    * @tparam TMessage
    * @param message
-   * @return 0 if the message was sent, otherwise the delay until the next message can be send
+   * @return 0 if the message was sent, otherwise the delay until the next message can be send.
+   * In coalescing mode 0 is also returned for a cancel dropped with the queued order it cancels,
+   * and an amend of a queued new order is queued behind it
    */
   template <typename TMessage>
-  [[nodiscard]] std::chrono::nanoseconds try_send_message(TMessage const& message)
+  [[nodiscard]] std::chrono::nanoseconds try_send_message(TMessage&& message)
   {
-    // first attempt to send the message
-    std::chrono::nanoseconds const delay = sw.request();
-    if (delay.count() == 0)
+    auto const now = clock_t::now();
+
+    if constexpr (TCoalescing::enabled)
     {
-      // we can send the message right now
-      _on_send_callback.on_send(message);
-      return std::chrono::nanoseconds{0};
+      // a message that supersedes queued messages might not need a slot of its own
+      std::optional<std::chrono::nanoseconds> const coalesced = _coalesce(std::forward<TMessage>(message), now);
+      if (coalesced)
+      {
+        return *coalesced;
+      }
     }
 
-    // we throttled, but we know we can send a new message in next_message_ms milliseconds
+    return _send_or_store(std::forward<TMessage>(message), now);
+  }
 
-    // store the message
-    if constexpr (std::is_same_v<TMessage, THighPriorityMessage>)
+  /**
+   * Same as try_send_message() for a message constructed from `args`. A throttled message is
+   * constructed in place in the backlog. In coalescing mode the message is constructed first
+   * since its order id is needed to coalesce it, and with an expiry policy since its time to
+   * live is needed for its deadline
+   * @tparam TMessage
+   * @param args the constructor arguments of the message
+   * @return 0 if the message was sent, otherwise the delay until the next message can be send
+   */
+  template <typename TMessage, typename... Args>
+  [[nodiscard]] std::chrono::nanoseconds try_emplace_message(Args&&... args)
+  {
+    if constexpr (TCoalescing::enabled || TExpiry::enabled)
     {
-      // this is a high priority message and we store it as a high priority
-      _high_priority_messages.push_back(message);
+      return try_send_message(TMessage(std::forward<Args>(args)...));
     }
     else
     {
-      // to support and store any other message type we type erase it
-      using stored_message_t = StoredMessage<TMessage>;
-      _rest_messages.push_back(std::make_unique<stored_message_t>(_on_send_callback, message));
+      auto const now = clock_t::now();
+
+      std::chrono::nanoseconds const delay = sw.request(now);
+      if (delay.count() == 0)
+      {
+        _metrics.on_admitted(1);
+        send_message(_on_send_callback, TMessage(std::forward<Args>(args)...));
+        return std::chrono::nanoseconds{0};
+      }
+
+      constexpr std::size_t tier = _tier_of<TMessage>();
+      std::get<tier>(_tiers).template emplace<TMessage>(std::forward<Args>(args)...);
+      _queued(tier, now);
+
+      return delay;
     }
+  }
 
-    // our thread needs to look our queue in next_message_ms
-    return delay;
+  /**
+   * Tries to send a batch of messages with a single request to the window. The admitted prefix
+   * of the batch is sent right away and the rest messages are queued.
+   *
+   * In coalescing mode a batch of amends or cancels is sent message by message, each coalescing
+   * with the backlog first. Then `admitted` counts the messages passed to the callback, which are
+   * not always a prefix of the batch, e.g. a cancel dropped with its queued order is not counted
+   * @tparam TMessage
+   * @param messages
+   * @return how many messages were sent and the delay until the next message can be send
+   */
+  template <typename TMessage, std::size_t Extent>
+  [[nodiscard]] BatchAdmission try_send_batch(std::span<TMessage, Extent> messages)
+  {
+    auto const now = clock_t::now();
+
+    if constexpr (_supersedes<std::remove_const_t<TMessage>>())
+    {
+      BatchAdmission result;
+      for (TMessage const& message : messages)
+      {
+        std::optional<std::chrono::nanoseconds> const coalesced = _coalesce(message, now);
+        std::chrono::nanoseconds const delay = coalesced ? *coalesced : _send_or_store(message, now);
+
+        result.admitted += (!coalesced && (delay.count() == 0)) ? 1 : 0;
+        result.delay = delay.count() == 0 ? result.delay : delay;
+      }
+      return result;
+    }
+    BatchAdmission const result = sw.request_n(messages.size(), now);
+
+    if (result.admitted < messages.size())
+    {
+      _throttled(now, result.delay);
+    }
+
+    _metrics.on_admitted(result.admitted);
+
+    if constexpr (accepts_batches<TOnSendCallback, std::remove_const_t<TMessage>>)
+    {
+      if (result.admitted != 0)
+      {
+        _on_send_callback.on_send_batch(std::span<TMessage const>{messages.data(), result.admitted});
+      }
+    }
+    else
+    {
+      for (std::size_t i = 0; i < result.admitted; ++i)
+      {
+        _on_send_callback.on_send(messages[i]);
+      }
+    }
+
+    for (std::size_t i = result.admitted; i < messages.size(); ++i)
+    {
+      _store_message(messages[i], now);
+    }
+
+    return result;
   }
 
   /**
@@ -73,86 +277,653 @@ public:
    */
   [[nodiscard]] std::chrono::nanoseconds send_queued_messages()
   {
-    // first check and send any high priority messages
-    std::chrono::nanoseconds delay = _send_queued_messages(_high_priority_messages);
+    // read the clock once for the whole drain
+    UnlimitedBudget budget;
+    return _send_queued_messages(clock_t::now(), budget);
+  }
+
+  /**
+   * Send the queued messages until the budget is spent, so a large backlog is sent over several
+   * drains interleaved with the ingress:
+   *
+   *   auto const status = throttler.send_queued_messages(DrainBudget{64});
+   *   if (status.budget_exhausted) { drain again after the ingress }
+   *   else if (status.delay.count() != 0) { drain again after status.delay }
+   *
+   * @return how many messages were sent, why the drain stopped and the backlog left per tier
+   */
+  [[nodiscard]] DrainStatus<TPriorityMap::tiers> send_queued_messages(DrainBudget budget)
+  {
+    auto const now = clock_t::now();
+    LimitedBudget limited{budget, now};
+
+    DrainStatus<TPriorityMap::tiers> status;
+    status.delay = _send_queued_messages(now, limited);
+    status.sent = limited.sent;
+    status.budget_exhausted = limited.exhausted;
+    _remaining(status.remaining, std::make_index_sequence<TPriorityMap::tiers>{});
+
+    return status;
+  }
+
+  /**
+   * Queues a message without requesting the window, e.g. to restore the backlog of a snapshot.
+   * It is sent by send_queued_messages() in priority order like a throttled message
+   */
+  template <typename TMessage>
+  void queue_message(TMessage&& message)
+  {
+    _store_message(std::forward<TMessage>(message), clock_t::now());
+  }
+
+  /**
+   * Calls visitor(message) for each queued message in the order they are sent, e.g. to save the
+   * backlog in a snapshot, see Snapshot.h. Superseded messages are skipped. The tiers must store
+   * typed messages, the messages of a TypeErasedStorage can not be visited
+   */
+  template <typename TVisitor>
+  void for_each_queued(TVisitor&& visitor) const
+  {
+    _for_each_queued(visitor, std::make_index_sequence<TPriorityMap::tiers>{});
+  }
+
+  /**
+   * @return number of queued messages. In coalescing mode the superseded messages are counted
+   * until the drain releases them
+   */
+  [[nodiscard]] std::size_t queued() const noexcept
+  {
+    return std::apply([](auto const&... tiers) { return (std::size_t{0} + ... + tiers.size()); }, _tiers);
+  }
+
+  [[nodiscard]] window_t& window() noexcept { return sw; }
+  [[nodiscard]] window_t const& window() const noexcept { return sw; }
+
+  /**
+   * The recorder of the metrics policy. With AtomicMetrics a monitoring thread can call
+   * snapshot() on it while the throttler is used
+   */
+  [[nodiscard]] metrics_t const& metrics() const noexcept { return _metrics; }
+
+private:
+  template <typename TMessage>
+  [[nodiscard]] static constexpr std::size_t _tier_of() noexcept
+  {
+    constexpr std::size_t tier = TPriorityMap::template tier_of<TMessage>;
+    static_assert(tier < TPriorityMap::tiers, "no tier of the priority map accepts the message type");
+    return tier;
+  }
 
+  /**
+   * Sends the message if the window admits it, otherwise queues it
+   * @return 0 if the message was sent, otherwise the delay until the next message can be send
+   */
+  template <typename TMessage>
+  [[nodiscard]] std::chrono::nanoseconds _send_or_store(TMessage&& message, typename clock_t::time_point now)
+  {
+    // first attempt to send the message
+    std::chrono::nanoseconds const delay = sw.request(now);
     if (delay.count() == 0)
     {
-      // we sent all high priority messages so continue to send the next messages
-      delay = _send_queued_messages(_rest_messages);
+      // we can send the message right now
+      _metrics.on_admitted(1);
+      send_message(_on_send_callback, std::forward<TMessage>(message));
+      return std::chrono::nanoseconds{0};
     }
 
+    // we throttled, but we know we can send a new message in next_message_ms milliseconds
+    _throttled(now, delay);
+    _store_message(std::forward<TMessage>(message), now);
+
+    // our thread needs to look our queue in next_message_ms
     return delay;
   }
 
-private:
-  template <typename TMessageContainer>
-  [[nodiscard]] std::chrono::nanoseconds _send_queued_messages(TMessageContainer& message_container)
+  template <typename TMessage>
+  void _store_message(TMessage&& message, typename clock_t::time_point now)
   {
-    for (auto message_it = std::begin(message_container); message_it != std::end(message_container);)
+    using message_t = std::remove_cvref_t<TMessage>;
+    constexpr std::size_t tier = _tier_of<message_t>();
+
+    if constexpr (TCoalescing::enabled)
     {
-      std::chrono::nanoseconds const delay = sw.request();
+      // index the queued orders so later messages of the same order can supersede them
+      if constexpr (std::is_same_v<message_t, typename TCoalescing::new_order_t>)
+      {
+        auto const id = TCoalescing::id_of(message);
+        _coalescing.pending(id).new_order = _coalescing.push(tier, id, coalescing_index_t::Kind::NewOrder);
+      }
+      else if constexpr (std::is_same_v<message_t, typename TCoalescing::amend_order_t>)
+      {
+        auto const id = TCoalescing::id_of(message);
+        _coalescing.pending(id).amend = _coalescing.push(tier, id, coalescing_index_t::Kind::Amend);
+      }
+      else
+      {
+        (void)_coalescing.push(tier, typename TCoalescing::id_t{}, coalescing_index_t::Kind::Other);
+      }
+    }
 
-      if (delay.count() != 0)
+    if constexpr (TExpiry::enabled)
+    {
+      _expiry.push(tier, expiry_index_t::deadline_of(_to_ns(now), TExpiry::ttl(std::as_const(message))));
+    }
+
+    std::get<tier>(_tiers).push(std::forward<TMessage>(message));
+    _queued(tier, now);
+  }
+
+  void _queued(std::size_t tier, typename clock_t::time_point now)
+  {
+    _non_empty_tiers |= uint64_t{1} << tier;
+    _metrics.on_queued(tier, _to_ns(now));
+  }
+
+  template <typename TMessage>
+  [[nodiscard]] static constexpr bool _supersedes() noexcept
+  {
+    if constexpr (TCoalescing::enabled)
+    {
+      return std::is_same_v<TMessage, typename TCoalescing::amend_order_t> ||
+        std::is_same_v<TMessage, typename TCoalescing::cancel_order_t>;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  /**
+   * Applies the message to the queued messages of its order
+   * @return the result of try_send_message if the message was coalesced with the backlog
+   */
+  template <typename TMessage>
+  [[nodiscard]] std::optional<std::chrono::nanoseconds> _coalesce(TMessage&& message, typename clock_t::time_point now)
+  {
+    using message_t = std::remove_cvref_t<TMessage>;
+
+    if constexpr (std::is_same_v<message_t, typename TCoalescing::amend_order_t>)
+    {
+      auto* pending_order = _coalescing.find(TCoalescing::id_of(message));
+      if (pending_order == nullptr)
       {
-        // message throttled return the delay until we can send the next message
-        return delay;
+        return std::nullopt;
       }
 
-      if constexpr (std::is_same_v<THighPriorityMessage, typename TMessageContainer::value_type>)
+      if (pending_order->amend != coalescing_index_t::npos)
       {
-        _on_send_callback.on_send(*message_it);
+        // the newer amend takes the place of the queued one, with a deadline of its own
+        constexpr std::size_t tier = TPriorityMap::template tier_of<message_t>;
+        std::size_t const index = _coalescing.index_of(tier, pending_order->amend);
+
+        if constexpr (TExpiry::enabled)
+        {
+          _expiry.set(tier, index, expiry_index_t::deadline_of(_to_ns(now), TExpiry::ttl(std::as_const(message))));
+        }
+
+        std::get<tier>(_tiers).replace(index, std::forward<TMessage>(message));
+        _metrics.on_coalesced(tier);
       }
       else
       {
-        // we need to send the message via the virtual function
-        (*message_it)->send();
+        // the new order is still queued, the amend must wait behind it even if the window is open
+        _store_message(std::forward<TMessage>(message), now);
+      }
+
+      auto const throttled_for = std::chrono::duration_cast<std::chrono::nanoseconds>(_throttled_until - now);
+      return std::max(throttled_for, std::chrono::nanoseconds{1});
+    }
+    else if constexpr (std::is_same_v<message_t, typename TCoalescing::cancel_order_t>)
+    {
+      auto const id = TCoalescing::id_of(message);
+      auto* pending_order = _coalescing.find(id);
+      if (pending_order == nullptr)
+      {
+        return std::nullopt;
+      }
+
+      constexpr std::size_t new_order_tier = TPriorityMap::template tier_of<typename TCoalescing::new_order_t>;
+      constexpr std::size_t amend_tier = TPriorityMap::template tier_of<typename TCoalescing::amend_order_t>;
+
+      bool const never_sent = pending_order->new_order != coalescing_index_t::npos;
+      if (never_sent)
+      {
+        _coalescing.kill(new_order_tier, pending_order->new_order);
+        _metrics.on_coalesced(new_order_tier);
+      }
+
+      if (pending_order->amend != coalescing_index_t::npos)
+      {
+        _coalescing.kill(amend_tier, pending_order->amend);
+        _metrics.on_coalesced(amend_tier);
+      }
+
+      _coalescing.erase(id);
+
+      if (never_sent)
+      {
+        _metrics.on_coalesced(TPriorityMap::template tier_of<message_t>);
       }
 
-      // also need to remove the message from the front of our vector
-      message_it = message_container.erase(message_it);
+      // the venue never saw an order that was still queued, there is nothing to cancel
+      return never_sent ? std::optional<std::chrono::nanoseconds>{std::chrono::nanoseconds{0}} : std::nullopt;
     }
+    else
+    {
+      return std::nullopt;
+    }
+  }
 
-    // we send all messages in this container, we can just return 0
-    return std::chrono::nanoseconds{0};
+  [[nodiscard]] static int64_t _to_ns(typename clock_t::time_point tp) noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
   }
 
-private:
-  class StoredMessageBase
+  void _throttled(typename clock_t::time_point now, std::chrono::nanoseconds delay) noexcept
   {
-  public:
-    explicit StoredMessageBase(TOnSendCallback& on_send_callback) : _on_send_callback(on_send_callback) {};
-    virtual ~StoredMessageBase() = default;
-    virtual void send() = 0;
+    if constexpr (TCoalescing::enabled)
+    {
+      _throttled_until = now + std::chrono::duration_cast<typename clock_t::duration>(delay);
+    }
+  }
 
-  protected:
-    TOnSendCallback& _on_send_callback;
+  /**
+   * The budget of send_queued_messages() without a budget, it compiles to nothing
+   */
+  struct UnlimitedBudget
+  {
+    [[nodiscard]] static constexpr bool allows() noexcept { return true; }
+
+    [[nodiscard]] static constexpr std::size_t allowance(std::size_t n) noexcept { return n; }
+
+    static constexpr void spend(std::size_t = 1) noexcept {}
+
+    static constexpr void exhaust() noexcept {}
+
+    static constexpr bool exhausted{false};
   };
 
-  template <typename TMessage>
-  class StoredMessage : public StoredMessageBase
+  /**
+   * Counts the messages and the time spent by a drain
+   */
+  struct LimitedBudget
   {
-  public:
-    StoredMessage(TOnSendCallback& on_send_callback, TMessage const& message) :
-    StoredMessageBase(on_send_callback), _message(message) {}
+    LimitedBudget(DrainBudget budget, typename clock_t::time_point now)
+      : max_messages(budget.max_messages),
+        timed(budget.max_time != std::chrono::nanoseconds::max()),
+        deadline(timed ? now + std::chrono::duration_cast<typename clock_t::duration>(budget.max_time) : now)
+    {
+    }
+
+    /**
+     * @return true if one more message can be sent
+     */
+    [[nodiscard]] bool allows()
+    {
+      exhausted = (sent >= max_messages) || (timed && (clock_t::now() >= deadline));
+      return !exhausted;
+    }
+
+    /**
+     * @return how many of `n` messages can be sent as one batch. The budget is only exhausted once
+     * the window admitted all of them, see exhaust()
+     */
+    [[nodiscard]] std::size_t allowance(std::size_t n)
+    {
+      if (!allows())
+      {
+        return 0;
+      }
 
-    void send() override { this->_on_send_callback.on_send(_message); }
+      return std::min(n, max_messages - sent);
+    }
 
-  private:
-    TMessage _message;
+    void spend(std::size_t n = 1) noexcept { sent += n; }
+
+    /**
+     * Marks the budget as the reason the drain stopped
+     */
+    void exhaust() noexcept { exhausted = true; }
+
+    std::size_t max_messages;
+    bool timed;
+    typename clock_t::time_point deadline;
+    std::size_t sent{0};
+    bool exhausted{false};
   };
 
-protected:
-  // protected to access for testing
-  TOnSendCallback _on_send_callback;
+  template <typename TBudget>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_messages(typename clock_t::time_point now, TBudget& budget)
+  {
+    std::chrono::nanoseconds delay{0};
+
+    // send the tiers from the highest priority until one is throttled
+    while (_non_empty_tiers != 0)
+    {
+      auto const tier = static_cast<std::size_t>(std::countr_zero(_non_empty_tiers));
+      delay = _send_queued_tier(now, tier, budget, std::make_index_sequence<TPriorityMap::tiers>{});
+
+      if ((delay.count() != 0) || budget.exhausted)
+      {
+        break;
+      }
+
+      _non_empty_tiers &= ~(uint64_t{1} << tier);
+    }
+
+    return delay;
+  }
+
+  template <typename TBudget, std::size_t... Tiers>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_tier(typename clock_t::time_point now, std::size_t tier,
+                                                           TBudget& budget, std::index_sequence<Tiers...>)
+  {
+    std::chrono::nanoseconds delay{0};
+    (void)((tier == Tiers ? (delay = _send_queued_messages<Tiers>(now, budget), true) : false) || ...);
+    return delay;
+  }
+
+  template <std::size_t... Tiers>
+  void _remaining(std::array<std::size_t, TPriorityMap::tiers>& remaining, std::index_sequence<Tiers...>) const noexcept
+  {
+    ((remaining[Tiers] = std::get<Tiers>(_tiers).size()), ...);
+  }
+
+  template <std::size_t Tier, typename TBudget>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_messages(typename clock_t::time_point now, TBudget& budget)
+  {
+    using container_t = std::tuple_element_t<Tier, decltype(_tiers)>;
+
+    if constexpr (!TCoalescing::enabled &&
+                  requires(container_t& container, TOnSendCallback& callback) { container.send_batch(std::size_t{0}, callback); })
+    {
+      return _send_queued_batch<Tier>(now, budget);
+    }
+    else
+    {
+      return _send_queued_each<Tier>(now, budget);
+    }
+  }
+
+  /**
+   * Sends the admitted messages of the tier to the callback in one batch with a single request.
+   * With an expiry policy each run of messages up to the next expired one is a batch
+   */
+  template <std::size_t Tier, typename TBudget>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_batch(typename clock_t::time_point now, TBudget& budget)
+  {
+    auto& message_container = std::get<Tier>(_tiers);
+
+    for (;;)
+    {
+      if constexpr (TExpiry::enabled)
+      {
+        _expire_front<Tier>(now);
+        if (message_container.empty())
+        {
+          return std::chrono::nanoseconds{0};
+        }
+      }
+
+      std::size_t const queued = message_container.size();
+      std::size_t const allowance = budget.allowance(queued);
+
+      std::size_t batch = allowance;
+      if constexpr (TExpiry::enabled)
+      {
+        // only the deadlines of the messages the window admits now are checked, so a drain of a
+        // deep backlog costs what it sends. The front is live, a full window still requests it
+        // to get the delay
+        std::size_t const admissible = std::max(_admissible(allowance, now), std::min<std::size_t>(allowance, 1));
+        batch = _expiry.live_prefix(Tier, admissible, _to_ns(now));
+      }
+
+      BatchAdmission const result = sw.request_n(batch, now);
+      if (result.admitted != 0)
+      {
+        message_container.send_batch(result.admitted, _on_send_callback);
+        for (std::size_t i = 0; i < result.admitted; ++i)
+        {
+          _metrics.on_sent(Tier, _to_ns(now));
+        }
+        budget.spend(result.admitted);
+        message_container.pop_front(result.admitted);
+
+        if constexpr (TExpiry::enabled)
+        {
+          _expiry.pop_front(Tier, result.admitted);
+        }
+      }
+
+      if ((result.admitted == allowance) && (allowance < queued))
+      {
+        // the window admitted everything the budget allowed, the budget stopped the drain
+        budget.exhaust();
+        return result.delay;
+      }
+
+      if ((result.admitted < batch) || message_container.empty())
+      {
+        return result.delay;
+      }
+    }
+  }
+
+  /**
+   * @return how many of `n` messages the window admits at `now`, or `n` if the window can not
+   * tell without sending them
+   */
+  [[nodiscard]] std::size_t _admissible(std::size_t n, typename clock_t::time_point now)
+  {
+    if constexpr (requires { sw.admissible(n, now); })
+    {
+      return sw.admissible(n, now);
+    }
+    else
+    {
+      return n;
+    }
+  }
+
+  /**
+   * Releases the messages past their deadline at the front of the tier at once
+   */
+  template <std::size_t Tier>
+  void _expire_front(typename clock_t::time_point now)
+  {
+    auto& message_container = std::get<Tier>(_tiers);
+
+    std::size_t expired{0};
+    while ((expired != message_container.size()) && _expiry.is_expired(Tier, expired, _to_ns(now)))
+    {
+      message_container.expire(expired, _on_send_callback);
+      _metrics.on_expired(Tier);
+      ++expired;
+    }
+
+    message_container.pop_front(expired);
+    _expiry.pop_front(Tier, expired);
+  }
+
+  template <std::size_t Tier, typename TBudget>
+  [[nodiscard]] std::chrono::nanoseconds _send_queued_each(typename clock_t::time_point now, TBudget& budget)
+  {
+    auto& message_container = std::get<Tier>(_tiers);
+    std::chrono::nanoseconds delay{0};
+
+    // send from the front of the queue and release everything we sent at once at the end
+    std::size_t sent{0};
+    while (sent != message_container.size())
+    {
+      if constexpr (TCoalescing::enabled)
+      {
+        if (!_coalescing.is_alive(Tier, sent))
+        {
+          // superseded messages are released without using a slot
+          _metrics.on_dropped(Tier);
+          ++sent;
+          continue;
+        }
+      }
+
+      if constexpr (TExpiry::enabled)
+      {
+        if (_expiry.is_expired(Tier, sent, _to_ns(now)))
+        {
+          // expired messages are released without using a slot, even if the window is full
+          message_container.expire(sent, _on_send_callback);
+          _metrics.on_expired(Tier);
+          ++sent;
+          continue;
+        }
+      }
+
+      if (!budget.allows())
+      {
+        // the rest is sent by the next drain
+        break;
+      }
+
+      delay = sw.request(now);
+
+      if (delay.count() != 0)
+      {
+        // message throttled return the delay until we can send the next message
+        _throttled(now, delay);
+        break;
+      }
+
+      message_container.send(sent, _on_send_callback);
+      _metrics.on_sent(Tier, _to_ns(now));
+      budget.spend();
+      ++sent;
+    }
+
+    message_container.pop_front(sent);
+
+    if constexpr (TCoalescing::enabled)
+    {
+      _coalescing.pop_front(Tier, sent);
+    }
+
+    if constexpr (TExpiry::enabled)
+    {
+      _expiry.pop_front(Tier, sent);
+    }
+
+    // a zero delay here means we sent all messages in this container
+    return delay;
+  }
+
+  template <typename TVisitor, std::size_t... Tiers>
+  void _for_each_queued(TVisitor& visitor, std::index_sequence<Tiers...>) const
+  {
+    (_for_each_queued_in<Tiers>(visitor), ...);
+  }
+
+  template <std::size_t Tier, typename TVisitor>
+  void _for_each_queued_in(TVisitor& visitor) const
+  {
+    auto const& message_container = std::get<Tier>(_tiers);
+    static_assert(requires { message_container.visit(std::size_t{0}, visitor); },
+                  "the storage of the tier can not visit its messages");
+
+    for (std::size_t i = 0; i < message_container.size(); ++i)
+    {
+      if constexpr (TCoalescing::enabled)
+      {
+        if (!_coalescing.is_alive(Tier, i))
+        {
+          continue;
+        }
+      }
+
+      message_container.visit(i, visitor);
+    }
+  }
+
+  // distinct empty types so both members take no space without coalescing
+  template <int>
+  struct Empty
+  {
+  };
+
+  template <typename TCoalescingPolicy, bool = TCoalescingPolicy::enabled>
+  struct CoalescingIndexOf
+  {
+    using type = Empty<0>;
+  };
+
+  template <typename TCoalescingPolicy>
+  struct CoalescingIndexOf<TCoalescingPolicy, true>
+  {
+    using type = CoalescingIndex<typename TCoalescingPolicy::id_t, TPriorityMap::tiers>;
+  };
+
+  using coalescing_index_t = typename CoalescingIndexOf<TCoalescing>::type;
+  using throttled_until_t = std::conditional_t<TCoalescing::enabled, typename clock_t::time_point, Empty<1>>;
+  using expiry_index_t = std::conditional_t<TExpiry::enabled, ExpiryIndex<TPriorityMap::tiers>, Empty<2>>;
+
+  template <typename TTiers>
+  struct TierContainers;
+
+  template <std::size_t... Tiers>
+  struct TierContainers<std::index_sequence<Tiers...>>
+  {
+    using type = std::tuple<
+      typename TPriorityMap::template tier_t<Tiers>::template container<TOnSendCallback>...>;
+  };
+
+  using tiers_t = typename TierContainers<std::make_index_sequence<TPriorityMap::tiers>>::type;
+
+  [[nodiscard]] static TWindow _make_window(std::size_t max_messages, std::chrono::nanoseconds interval,
+                                            std::pmr::memory_resource* resource)
+  {
+    if constexpr (std::is_constructible_v<TWindow, std::size_t, std::chrono::nanoseconds, std::pmr::memory_resource*>)
+    {
+      return TWindow(max_messages, interval, resource);
+    }
+    else
+    {
+      return TWindow(max_messages, interval);
+    }
+  }
+
+  template <std::size_t... Tiers>
+  [[nodiscard]] static tiers_t _make_tiers(std::pmr::memory_resource* resource, std::index_sequence<Tiers...>)
+  {
+    return tiers_t{std::tuple_element_t<Tiers, tiers_t>(resource)...};
+  }
 
 private:
-  SlidingWindow sw;
+  // the state of an admission comes first so it shares the first cache line of the throttler:
+  // the window and a bit per tier that has queued messages. Then one queue per tier
+  TWindow sw;
+  uint64_t _non_empty_tiers{0};
+  tiers_t _tiers;
+
+  // the index of the queued orders and when the window allows the next message
+  [[no_unique_address]] coalescing_index_t _coalescing;
+  [[no_unique_address]] throttled_until_t _throttled_until{};
+
+  // the deadlines of the queued messages
+  [[no_unique_address]] expiry_index_t _expiry;
 
-  // store highest priority messages in a separate vector to send them first.
-  std::vector<THighPriorityMessage> _high_priority_messages;
+  [[no_unique_address]] metrics_t _metrics;
 
-  // any other message type is stored in the same vector and pushed at the back
-  std::vector<std::unique_ptr<StoredMessageBase>> _rest_messages;
+protected:
+  // protected to access for testing, last as the admission does not read it
+  TOnSendCallback _on_send_callback;
 };
-}
\ No newline at end of file
+
+/**
+ * A throttler with two tiers. The THighPriorityMessage type is sent first and any other message
+ * type is stored in the same queue according to the TRestStorage policy. By default the rest
+ * messages are type erased and we access them later via a virtual function, see MessageStorage.h
+ * for an allocation free alternative.
+ */
+template <typename THighPriorityMessage, typename TOnSendCallback, typename TRestStorage = TypeErasedStorage,
+          typename TWindow = SlidingWindow<>>
+using Throttler =
+  PriorityThrottler<TOnSendCallback, PriorityMap<Tier<THighPriorityMessage>, AnyTier<TRestStorage>>, TWindow>;
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "CacheLine.h"
+#include "SlidingWindow.h"
+#include "Throttler.h"
+
+namespace ets
+{
+/**
+ * Where a message was routed by a ThrottlerPool and the result of sending it there
+ */
+struct RoutedSend
+{
+  // the index of the session the message was sent or queued on
+  std::size_t session{0};
+
+  // 0 if the message was sent, otherwise the delay until the session can send its next message
+  std::chrono::nanoseconds delay{0};
+};
+
+/**
+ * Routes the messages over several sessions of the same venue, each with its own limit and
+ * backlog, so the gateway sends at the sum of their limits without probing each session.
+ *
+ * Each session is a PriorityThrottler. The sessions are kept in a binary heap ordered by their
+ * load, the number of queued messages first and then the time their window admits the next
+ * message. The least loaded session is the top of the heap and only the session that sent
+ * or queued a message moves in the heap, so routing a message is O(log sessions):
+ *   - a session that can send now is used, the one that has been able to send for the longest
+ *     first, which spreads the messages over the idle sessions
+ *   - otherwise the message is queued on the session with the shortest backlog, which then sends
+ *     it at its soonest slot
+ *
+ * The window of a session admits its next message at a time that only changes when the session
+ * sends, so the order of the heap stays valid while time passes.
+ *
+ * Messages which must go to a given session, e.g. the cancel of an order sent on it, are sent
+ * with try_send_message_on(). The callback is called with the session and the message:
+ * on_send(session, message)
+ *
+ * @tparam TOnSendCallback the callback of the sent messages of all sessions
+ * @tparam TPriorityMap the tiers of the backlog of each session, see PriorityMap.h
+ * @tparam TWindow the rate limit policy of each session, see SlidingWindow.h
+ */
+template <typename TOnSendCallback, typename TPriorityMap, typename TWindow = SlidingWindow<>>
+class ThrottlerPool
+{
+  /**
+   * The callback of a session, it tags the messages with the session index
+   */
+  class SessionCallback
+  {
+  public:
+    SessionCallback(TOnSendCallback* on_send_callback, std::size_t session)
+      : _on_send_callback(on_send_callback), _session(session)
+    {
+    }
+
+    template <typename TMessage>
+    void on_send(TMessage&& message)
+    {
+      _on_send_callback->on_send(_session, std::forward<TMessage>(message));
+    }
+
+  private:
+    TOnSendCallback* _on_send_callback;
+    std::size_t _session;
+  };
+
+public:
+  using window_t = TWindow;
+  using clock_t = typename TWindow::clock_t;
+  using time_point = typename clock_t::time_point;
+  using session_t = PriorityThrottler<SessionCallback, TPriorityMap, TWindow>;
+
+  /**
+   * @param windows the already configured window of each session, at least one
+   */
+  ThrottlerPool(std::vector<TWindow> windows, TOnSendCallback on_send_callback)
+    : _on_send_callback(std::move(on_send_callback))
+  {
+    _sessions.reserve(windows.size());
+    for (std::size_t i = 0; i < windows.size(); ++i)
+    {
+      _sessions.emplace_back(std::move(windows[i]), SessionCallback{&_on_send_callback, i});
+    }
+
+    _init_heap();
+  }
+
+  /**
+   * Constructs `sessions` sessions with the same limit
+   */
+  ThrottlerPool(std::size_t sessions, std::size_t max_messages, std::chrono::nanoseconds interval,
+                TOnSendCallback on_send_callback)
+    : _on_send_callback(std::move(on_send_callback))
+  {
+    _sessions.reserve(sessions);
+    for (std::size_t i = 0; i < sessions; ++i)
+    {
+      _sessions.emplace_back(max_messages, interval, SessionCallback{&_on_send_callback, i});
+    }
+
+    _init_heap();
+  }
+
+  // the sessions point to the callback of the pool
+  ThrottlerPool(ThrottlerPool const&) = delete;
+  ThrottlerPool& operator=(ThrottlerPool const&) = delete;
+
+  /**
+   * Sends the message on the least loaded session, or queues it there if every session is
+   * throttled
+   * @return the session of the message, and 0 if the message was sent, otherwise the delay until
+   * that session can send its next message
+   */
+  template <typename TMessage>
+  [[nodiscard]] RoutedSend try_send_message(TMessage&& message)
+  {
+    std::size_t const session = _heap.front();
+    std::chrono::nanoseconds const delay = _sessions[session].value.try_send_message(std::forward<TMessage>(message));
+    _update(session, clock_t::now());
+
+    return RoutedSend{session, delay};
+  }
+
+  /**
+   * Sends the message on the given session, or queues it there if the session is throttled
+   * @return 0 if the message was sent, otherwise the delay until the session can send its next
+   * message
+   */
+  template <typename TMessage>
+  [[nodiscard]] std::chrono::nanoseconds try_send_message_on(std::size_t session, TMessage&& message)
+  {
+    std::chrono::nanoseconds const delay = _sessions[session].value.try_send_message(std::forward<TMessage>(message));
+    _update(session, clock_t::now());
+
+    return delay;
+  }
+
+  /**
+   * Sends the queued messages of every session
+   * @return a zero delay if every backlog was sent, otherwise the earliest delay until one of the
+   * sessions can send more
+   */
+  [[nodiscard]] std::chrono::nanoseconds send_queued_messages()
+  {
+    std::chrono::nanoseconds delay{0};
+    for (std::size_t session = 0; session < _sessions.size(); ++session)
+    {
+      if (_loads[session].queued == 0)
+      {
+        continue;
+      }
+
+      std::chrono::nanoseconds const session_delay = _sessions[session].value.send_queued_messages();
+      _update(session, clock_t::now());
+
+      if ((session_delay.count() != 0) && ((delay.count() == 0) || (session_delay < delay)))
+      {
+        delay = session_delay;
+      }
+    }
+
+    return delay;
+  }
+
+  /**
+   * @return the session the next message would be routed to
+   */
+  [[nodiscard]] std::size_t least_loaded() const noexcept { return _heap.front(); }
+
+  [[nodiscard]] std::size_t sessions() const noexcept { return _sessions.size(); }
+
+  [[nodiscard]] session_t& session(std::size_t i) noexcept { return _sessions[i].value; }
+
+  [[nodiscard]] session_t const& session(std::size_t i) const noexcept { return _sessions[i].value; }
+
+protected:
+  // protected to access for testing
+  TOnSendCallback _on_send_callback;
+
+private:
+  struct Load
+  {
+    std::size_t queued{0};
+    time_point next_free{};
+
+    [[nodiscard]] bool operator<(Load const& other) const noexcept
+    {
+      return std::tie(queued, next_free) < std::tie(other.queued, other.next_free);
+    }
+  };
+
+  void _init_heap()
+  {
+    _loads.assign(_sessions.size(), Load{});
+    _heap.resize(_sessions.size());
+    _positions.resize(_sessions.size());
+    for (std::size_t i = 0; i < _sessions.size(); ++i)
+    {
+      _heap[i] = i;
+      _positions[i] = i;
+    }
+  }
+
+  /**
+   * Recomputes the load of the session after it sent or queued messages and moves it in the heap
+   */
+  void _update(std::size_t session, time_point now)
+  {
+    session_t& throttler = _sessions[session].value;
+    auto const delay = std::chrono::duration_cast<typename clock_t::duration>(throttler.window().delay(now));
+    _loads[session] = Load{throttler.queued(), now + delay};
+
+    std::size_t const position = _sift_up(_positions[session]);
+    _sift_down(position);
+  }
+
+  std::size_t _sift_up(std::size_t position) noexcept
+  {
+    while (position > 0)
+    {
+      std::size_t const parent = (position - 1) / 2;
+      if (!(_loads[_heap[position]] < _loads[_heap[parent]]))
+      {
+        break;
+      }
+
+      _swap(position, parent);
+      position = parent;
+    }
+
+    return position;
+  }
+
+  void _sift_down(std::size_t position) noexcept
+  {
+    for (;;)
+    {
+      std::size_t smallest = position;
+      for (std::size_t child = 2 * position + 1; child <= 2 * position + 2; ++child)
+      {
+        if ((child < _heap.size()) && (_loads[_heap[child]] < _loads[_heap[smallest]]))
+        {
+          smallest = child;
+        }
+      }
+
+      if (smallest == position)
+      {
+        return;
+      }
+
+      _swap(position, smallest);
+      position = smallest;
+    }
+  }
+
+  void _swap(std::size_t a, std::size_t b) noexcept
+  {
+    std::swap(_heap[a], _heap[b]);
+    _positions[_heap[a]] = a;
+    _positions[_heap[b]] = b;
+  }
+
+private:
+  // each session starts on its own cache line, see CacheAligned
+  std::vector<CacheAligned<session_t>> _sessions;
+
+  // the load of each session, the heap of the session indexes and the heap position of each session
+  std::vector<Load> _loads;
+  std::vector<std::size_t> _heap;
+  std::vector<std::size_t> _positions;
+};
+} // namespace ets
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ets
+{
+/**
+ * A hierarchical timer wheel. Used to wake up many throttlers, each at the time its next queued
+ * message can be sent, without scanning all of them or keeping a heap.
+ *
+ * Time is split in ticks of a configured duration. There are 4 levels of 256 slots, the first
+ * level holds the timers expiring in the next 256 ticks and each next level covers 256 times
+ * the range of the previous one. Scheduling, cancelling and firing a timer are O(1), and a timer
+ * of a higher level is moved down once each time its level turns.
+ *
+ * Each timer carries a value, e.g. a pointer or an index to a throttler. The timers are kept in
+ * a vector and addressed by id, so scheduling does not allocate once the vector has grown.
+ *
+ * Timers fire on the first advance() at or after their deadline rounded up to the tick.
+ * TValue must be default constructible.
+ */
+template <typename TValue, typename TClock = std::chrono::steady_clock>
+class TimerWheel
+{
+public:
+  using clock_t = TClock;
+  using time_point = typename TClock::time_point;
+  using timer_id = uint32_t;
+
+  static constexpr std::size_t levels = 4;
+  static constexpr std::size_t slot_bits = 8;
+  static constexpr std::size_t slots = std::size_t{1} << slot_bits;
+
+  /**
+   * @param tick resolution of the wheel
+   * @param start time of the first tick
+   */
+  explicit TimerWheel(std::chrono::nanoseconds tick, time_point start = TClock::now())
+    : _tick(tick), _start(start)
+  {
+    _heads.fill(npos);
+  }
+
+  /**
+   * Creates a new timer that is not scheduled
+   * @return the id of the timer
+   */
+  [[nodiscard]] timer_id add(TValue value)
+  {
+    timer_id id;
+    if (_free != npos)
+    {
+      id = _free;
+      _free = _nodes[id].next;
+      _nodes[id] = Node{std::move(value)};
+    }
+    else
+    {
+      id = static_cast<timer_id>(_nodes.size());
+      _nodes.push_back(Node{std::move(value)});
+    }
+
+    return id;
+  }
+
+  /**
+   * Cancels and destroys a timer, its id can be reused by a later add()
+   */
+  void remove(timer_id id)
+  {
+    cancel(id);
+    _nodes[id].value = TValue{};
+    _nodes[id].next = _free;
+    _free = id;
+  }
+
+  /**
+   * Schedules the timer to fire at the deadline, replacing any previous schedule
+   */
+  void schedule(timer_id id, time_point deadline)
+  {
+    cancel(id);
+
+    // round up so a timer never fires before its deadline
+    auto const since_start = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - _start);
+    uint64_t expiry = since_start.count() <= 0
+      ? 0
+      : static_cast<uint64_t>((since_start.count() + _tick.count() - 1) / _tick.count());
+
+    _nodes[id].expiry = expiry;
+    _insert(id);
+    _size += 1;
+  }
+
+  /**
+   * Schedules the timer to fire after the delay from now
+   */
+  void schedule_after(timer_id id, std::chrono::nanoseconds delay, time_point now = TClock::now())
+  {
+    schedule(id, now + delay);
+  }
+
+  /**
+   * Cancels the timer if it is scheduled
+   */
+  void cancel(timer_id id) noexcept
+  {
+    if (_nodes[id].list != npos)
+    {
+      _unlink(id);
+      _size -= 1;
+    }
+  }
+
+  [[nodiscard]] bool is_scheduled(timer_id id) const noexcept { return _nodes[id].list != npos; }
+
+  [[nodiscard]] TValue& value(timer_id id) noexcept { return _nodes[id].value; }
+
+  /**
+   * Moves time forward and fires every timer that is due. A fired timer is no longer scheduled
+   * and it can be scheduled again from the callback
+   * @param now current time
+   * @param on_expire invoked as on_expire(id, value) for each timer that is due
+   * @return number of fired timers
+   */
+  template <typename TFunc>
+  std::size_t advance(time_point now, TFunc&& on_expire)
+  {
+    auto const since_start = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _start);
+    if (since_start.count() < 0)
+    {
+      return 0;
+    }
+
+    uint64_t const target = static_cast<uint64_t>(since_start.count() / _tick.count());
+    std::size_t fired{0};
+
+    while (_current <= target)
+    {
+      if (_size == 0)
+      {
+        // nothing to fire, jump straight to the target
+        _current = target + 1;
+        break;
+      }
+
+      if ((_level_0_size == 0) && ((_current & (slots - 1)) != 0))
+      {
+        // the first level is empty, skip to where the next level turns or to the target
+        _current = std::min(((_current >> slot_bits) + 1) << slot_bits, target + 1);
+        continue;
+      }
+
+      uint64_t const tick = _current;
+
+      // when a level turns, move the timers of its next slot down. Higher levels go first as
+      // their timers might end up in the slots of the lower levels we are about to move
+      for (std::size_t level = levels - 1; level > 0; --level)
+      {
+        uint64_t const lower_mask = (uint64_t{1} << (slot_bits * level)) - 1;
+        if ((tick & lower_mask) == 0)
+        {
+          _cascade(level, _slot(level, tick));
+        }
+      }
+
+      // detach the due slot so the timers rescheduled from the callback are not fired again
+      _current = tick + 1;
+      _move_list(_list_index(0, _slot(0, tick)), firing_list);
+
+      while (_heads[firing_list] != npos)
+      {
+        timer_id const id = _heads[firing_list];
+        _unlink(id);
+        _size -= 1;
+        fired += 1;
+        on_expire(id, _nodes[id].value);
+      }
+    }
+
+    return fired;
+  }
+
+  /**
+   * @return a lower bound of the earliest deadline of the scheduled timers. For timers in the
+   * first level this is exact at the tick resolution
+   */
+  [[nodiscard]] std::optional<time_point> next_expiry() const noexcept
+  {
+    if (_size == 0)
+    {
+      return std::nullopt;
+    }
+
+    for (std::size_t level = 0; level < levels; ++level)
+    {
+      uint64_t const level_shift = slot_bits * level;
+      for (uint64_t i = 0; i < slots; ++i)
+      {
+        uint64_t const block = (_current >> level_shift) + i;
+        if (_heads[_list_index(level, block & (slots - 1))] != npos)
+        {
+          uint64_t const tick = std::max(block << level_shift, _current);
+          return _start + std::chrono::duration_cast<typename TClock::duration>(
+                            _tick * static_cast<std::chrono::nanoseconds::rep>(tick));
+        }
+      }
+    }
+
+    return _start;
+  }
+
+  /**
+   * @return number of scheduled timers
+   */
+  [[nodiscard]] std::size_t size() const noexcept { return _size; }
+
+private:
+  static constexpr uint32_t npos = UINT32_MAX;
+  static constexpr uint32_t firing_list = levels * slots;
+
+  struct Node
+  {
+    TValue value{};
+    uint64_t expiry{0};
+    uint32_t prev{npos};
+    uint32_t next{npos};
+    uint32_t list{npos};
+  };
+
+  [[nodiscard]] static std::size_t _slot(std::size_t level, uint64_t tick) noexcept
+  {
+    return static_cast<std::size_t>((tick >> (slot_bits * level)) & (slots - 1));
+  }
+
+  [[nodiscard]] static uint32_t _list_index(std::size_t level, std::size_t slot) noexcept
+  {
+    return static_cast<uint32_t>(level * slots + slot);
+  }
+
+  void _insert(timer_id id) noexcept
+  {
+    Node& node = _nodes[id];
+
+    // a timer that is already due fires on the next processed tick
+    uint64_t const expiry = std::max(node.expiry, _current);
+
+    // the level is the highest slot digit that differs from the current tick, so the slot of the
+    // timer is always moved down before the timer expires. Timers beyond the range of the wheel
+    // go to the top level and are moved again when their slot turns
+    uint64_t const diff = expiry ^ _current;
+    std::size_t level{0};
+    while ((level < levels - 1) && (diff >> (slot_bits * (level + 1))) != 0)
+    {
+      ++level;
+    }
+
+    uint32_t const list = _list_index(level, _slot(level, expiry));
+    _push(list, id);
+  }
+
+  void _cascade(std::size_t level, std::size_t slot) noexcept
+  {
+    uint32_t const list = _list_index(level, slot);
+    uint32_t id = _heads[list];
+    _heads[list] = npos;
+
+    while (id != npos)
+    {
+      uint32_t const next = _nodes[id].next;
+      _nodes[id].list = npos;
+      _insert(id);
+      id = next;
+    }
+  }
+
+  void _move_list(uint32_t from, uint32_t to) noexcept
+  {
+    _heads[to] = std::exchange(_heads[from], npos);
+    for (uint32_t id = _heads[to]; id != npos; id = _nodes[id].next)
+    {
+      _nodes[id].list = to;
+      _level_0_size -= (from < slots) ? 1 : 0;
+      _level_0_size += (to < slots) ? 1 : 0;
+    }
+  }
+
+  void _push(uint32_t list, timer_id id) noexcept
+  {
+    Node& node = _nodes[id];
+    node.list = list;
+    node.prev = npos;
+    node.next = _heads[list];
+
+    if (node.next != npos)
+    {
+      _nodes[node.next].prev = id;
+    }
+
+    _heads[list] = id;
+    _level_0_size += (list < slots) ? 1 : 0;
+  }
+
+  void _unlink(timer_id id) noexcept
+  {
+    Node& node = _nodes[id];
+
+    if (node.prev != npos)
+    {
+      _nodes[node.prev].next = node.next;
+    }
+    else
+    {
+      _heads[node.list] = node.next;
+    }
+
+    if (node.next != npos)
+    {
+      _nodes[node.next].prev = node.prev;
+    }
+
+    _level_0_size -= (node.list < slots) ? 1 : 0;
+    node.prev = npos;
+    node.next = npos;
+    node.list = npos;
+  }
+
+private:
+  std::chrono::nanoseconds _tick;
+  time_point _start;
+
+  // the next tick to process
+  uint64_t _current{0};
+  std::size_t _size{0};
+  std::size_t _level_0_size{0};
+
+  std::vector<Node> _nodes;
+  uint32_t _free{npos};
+
+  // one list per slot of each level plus the list of the timers firing right now
+  std::array<uint32_t, levels * slots + 1> _heads;
+};
+} // namespace ets
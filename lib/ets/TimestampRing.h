@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "BatchAdmission.h"
+
+namespace ets
+{
+/**
+ * The lock free sliding window algorithm of ConcurrentSlidingWindow and SharedSlidingWindow.
+ *
+ * The timestamps are kept in a ring of max_messages slots indexed by a global message sequence.
+ * Message `seq` goes to the slot of message `seq - max_messages`, which is the oldest message of
+ * the window. A sender checks that timestamp and claims the sequence with a single compare and
+ * swap, so senders only contend on the sequence counter. A failed claim means another sender got
+ * the slot first and the request is retried with the new oldest message.
+ *
+ * Each slot is tagged with the sequence that wrote it, so a sender never checks a slot that
+ * a previous claimer did not finish writing yet. A claim that is not finished after the stale
+ * claim timeout is assumed to belong to a sender that died, e.g. a crashed process sharing the
+ * ring, and it is completed by the waiting sender with its own time, which only delays the
+ * following messages.
+ *
+ * The ring does not own its memory so it can be placed in shared memory. The memory must be
+ * zero initialized.
+ */
+class TimestampRing
+{
+public:
+  struct Slot
+  {
+    // the sequence + 1 of the message whose timestamp is in the slot, 0 if never written. The
+    // busy bit is set while the timestamp is written
+    std::atomic<uint64_t> tag;
+    std::atomic<int64_t> timestamp;
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int64_t>::is_always_lock_free,
+                "the ring needs address free atomics to be shared between processes");
+
+  /**
+   * @param sequence the global message sequence
+   * @param slots max_messages slots
+   * @param stale_claim_timeout how long to wait for an unfinished claim before completing it
+   */
+  TimestampRing(std::atomic<uint64_t>& sequence, Slot* slots, std::size_t max_messages,
+                std::chrono::nanoseconds interval,
+                std::chrono::nanoseconds stale_claim_timeout = std::chrono::nanoseconds::max()) noexcept
+    : _sequence(&sequence),
+      _slots(slots),
+      _max_messages(max_messages),
+      _interval(interval),
+      _stale_claim_timeout(stale_claim_timeout)
+  {
+  }
+
+  /**
+   * Request to send `n` messages at once at the given time. Can be called by any thread
+   * @param n number of messages
+   * @param now_ns current time in nanoseconds since the epoch of the clock
+   * @return how many of the messages can be sent now and the delay until the rest can be sent
+   */
+  [[nodiscard]] BatchAdmission request_n(std::size_t n, int64_t now_ns)
+  {
+    uint64_t sequence = _sequence->load(std::memory_order_relaxed);
+    Stall stall;
+
+    while (true)
+    {
+      // count how many of the oldest messages fell outside the window, the slots that were
+      // never written are always free
+      BatchAdmission result;
+      bool retry{false};
+
+      while (result.admitted < n)
+      {
+        if (result.admitted == _max_messages)
+        {
+          // the rest would only fit in the window after the messages we are about to send
+          result.delay = _interval;
+          break;
+        }
+
+        uint64_t const next = sequence + result.admitted;
+        if (next < _max_messages)
+        {
+          ++result.admitted;
+          continue;
+        }
+
+        Slot& slot = _slots[next % _max_messages];
+        uint64_t const expected_tag = next - _max_messages + 1;
+        uint64_t const tag = slot.tag.load(std::memory_order_acquire);
+
+        if (tag != expected_tag)
+        {
+          // either the writer of the oldest message did not finish or our sequence is stale
+          retry = true;
+          if ((tag & ~busy_bit) < expected_tag)
+          {
+            _wait_for_claim(slot, tag, expected_tag, now_ns, stall);
+          }
+          break;
+        }
+
+        auto const dif_from_oldest = std::chrono::nanoseconds{now_ns - slot.timestamp.load(std::memory_order_relaxed)};
+        if (dif_from_oldest < _interval)
+        {
+          // the buffer is full, the rest can be sent when the oldest message leaves the window
+          result.delay = _interval - dif_from_oldest;
+          break;
+        }
+
+        ++result.admitted;
+      }
+
+      if (retry)
+      {
+        sequence = _sequence->load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (result.admitted == 0)
+      {
+        return result;
+      }
+
+      if (_sequence->compare_exchange_weak(sequence, sequence + result.admitted, std::memory_order_relaxed))
+      {
+        // the claimed slots are ours until the sequence goes around the ring again
+        for (std::size_t i = 0; i < result.admitted; ++i)
+        {
+          uint64_t const claimed = sequence + i;
+          uint64_t const previous_tag = claimed < _max_messages ? 0 : claimed - _max_messages + 1;
+          _write(_slots[claimed % _max_messages], previous_tag, claimed + 1, now_ns);
+        }
+
+        return result;
+      }
+
+      // another sender claimed first, the sequence was reloaded by the failed exchange
+    }
+  }
+
+private:
+  static constexpr uint64_t busy_bit = uint64_t{1} << 63;
+
+  struct Stall
+  {
+    uint64_t tag{0};
+    std::chrono::steady_clock::time_point since{};
+  };
+
+  /**
+   * Writes the timestamp of a claimed message. The write is skipped if the slot was completed
+   * by another sender in the meantime
+   */
+  static void _write(Slot& slot, uint64_t previous_tag, uint64_t tag, int64_t now_ns) noexcept
+  {
+    if (slot.tag.compare_exchange_strong(previous_tag, tag | busy_bit, std::memory_order_acquire))
+    {
+      slot.timestamp.store(now_ns, std::memory_order_relaxed);
+      slot.tag.store(tag, std::memory_order_release);
+    }
+  }
+
+  void _wait_for_claim(Slot& slot, uint64_t tag, uint64_t expected_tag, int64_t now_ns, Stall& stall)
+  {
+    auto const now = std::chrono::steady_clock::now();
+    if ((stall.since == std::chrono::steady_clock::time_point{}) || (stall.tag != tag))
+    {
+      // a new stall, start measuring it
+      stall.tag = tag;
+      stall.since = now;
+    }
+    else if (now - stall.since >= _stale_claim_timeout)
+    {
+      // the claimer is gone, finish its claim as if the message was sent now
+      _write(slot, tag, expected_tag, now_ns);
+      stall = Stall{};
+      return;
+    }
+
+    std::this_thread::yield();
+  }
+
+private:
+  std::atomic<uint64_t>* _sequence;
+  Slot* _slots;
+  std::size_t _max_messages;
+  std::chrono::nanoseconds _interval;
+  std::chrono::nanoseconds _stale_claim_timeout;
+};
+} // namespace ets
@@ -1,10 +1,12 @@
+#include <chrono>
 #include <iostream>
-#include <mutex>
-#include <queue>
+#include <memory>
+#include <span>
 #include <string>
 #include <thread>
 #include <variant>
 
+#include "ets/Runtime.h"
 #include "ets/Throttler.h"
 
 /**
@@ -48,150 +50,35 @@ struct OnSendCallback
     // Here we just print the message instead of sending it
     std::cout << "Sending message: " << message.desc << std::endl;
   }
-};
-
-/**
- * A very simple inefficient queue for the threads to communicate, just to demonstrate the example
- */
-template <typename T>
-class ThreadSafeQueue
-{
-public:
-  void push(T&& item)
-  {
-    std::lock_guard lock{_mutex};
-    _queue.push(std::move(item));
-  }
-
-  T const* front()
-  {
-    std::lock_guard lock{_mutex};
-    return !_queue.empty() ? std::addressof(_queue.front()) : nullptr;
-  }
-
-  void pop()
-  {
-    std::lock_guard lock{_mutex};
-    _queue.pop();
-  }
-
-private:
-  std::mutex _mutex;
-  std::queue<T> _queue;
-};
-
-using message_queue_types_t =
-  std::variant<std::unique_ptr<NewOrder>, std::unique_ptr<AmendOrder>, std::unique_ptr<CancelOrder>>;
-using message_queue_t = ThreadSafeQueue<message_queue_types_t>;
-
-/**
- * This is the meal processor thread. This is the user of the throttle class
- */
-class MealProcessor
-{
-public:
-  explicit MealProcessor(message_queue_t& message_queue) : _message_queue(message_queue){};
-
-  ~MealProcessor()
-  {
-    if (_worker.joinable())
-    {
-      _worker.join();
-    }
-  }
-
-  void run()
-  {
-    std::thread worker{[this]() { _main_loop(); }};
-    _worker.swap(worker);
-  }
-
-private:
-  void _main_loop()
-  {
-    // This is a never ending loop so the program has to be killed manually.
-    while (true)
-    {
-      // read any messages from our queue and attempt to send them
-      _process_message_queue();
-
-      // check if we have any queued messages to send
-      _send_queued_orders();
-    }
-  }
 
   /**
-   * Process all incoming messages from clients. The messages will go through the Throttle class
-   * and will either get be sent or get queued for later
+   * The queued orders admitted in one drain come as a batch, written with a single flush
    */
-  void _process_message_queue()
+  template <typename TMessage>
+  void on_send_batch(std::span<TMessage const> messages)
   {
-    // Get the first message from the queue
-    message_queue_types_t const* next_message = _message_queue.front();
-
-    while (next_message)
+    for (TMessage const& message : messages)
     {
-      // type-matching visitor
-      std::visit(
-        [this](auto&& arg)
-        {
-          using TMessageType = std::decay_t<decltype(arg)>;
-          if constexpr (std::is_same_v<TMessageType, std::unique_ptr<NewOrder>> ||
-                        std::is_same_v<TMessageType, std::unique_ptr<AmendOrder>> ||
-                        std::is_same_v<TMessageType, std::unique_ptr<CancelOrder>>)
-          {
-            // Check if we can send this message via the throttler
-            std::chrono::nanoseconds const delay = _throttler.template try_send_message(*arg);
-
-            if (delay.count() != 0)
-            {
-              // if the returned delay is not zero it means some messages got throttled
-              _scheduled = std::chrono::steady_clock::now() + delay;
-            }
-            else
-            {
-              // else set _scheduled to empty to indicate there is nothing else
-              _scheduled = std::chrono::steady_clock::time_point{};
-            }
-          }
-        },
-        *next_message);
-
-      // remove this message and read the next
-      _message_queue.pop();
-      next_message = _message_queue.front();
+      std::cout << "Sending message: " << message.desc << '\n';
     }
-  };
+    std::cout.flush();
+  }
+};
 
-  /**
-   * Send any previously queued orders
-   */
-  void _send_queued_orders()
-  {
-    if ((_scheduled != std::chrono::steady_clock::time_point{}) && std::chrono::steady_clock::now() >= _scheduled)
-    {
-      // if we are past the point of sending orders send any queued orders
-      std::chrono::nanoseconds const delay = _throttler.send_queued_messages();
+using message_queue_types_t = std::variant<NewOrder, AmendOrder, CancelOrder>;
 
-      if (delay.count() != 0)
-      {
-        // if the delay is not zero it means some messages are still queued
-        _scheduled = std::chrono::steady_clock::now() + delay;
-      }
-      else
-      {
-        // else set _scheduled to empty to indicate there is nothing else
-        _scheduled = std::chrono::steady_clock::time_point{};
-      }
-    }
-  }
+/**
+ * Each client has its own session and throttler. Cancels go before amends before new orders, all
+ * stored in place without allocating
+ */
+using order_priorities_t = ets::PriorityMap<ets::Tier<CancelOrder>, ets::Tier<AmendOrder>, ets::Tier<NewOrder>>;
+using throttler_t = ets::PriorityThrottler<OnSendCallback, order_priorities_t>;
 
-private:
-  message_queue_t& _message_queue;
-  std::thread _worker;
-  ets::Throttler<CancelOrder, OnSendCallback> _throttler{3, std::chrono::seconds{1}, OnSendCallback{}};
-  std::chrono::steady_clock::time_point _scheduled{};
-};
+/**
+ * The meal processor threads. The sessions of the clients are spread over the pipelines, each
+ * pipeline reads its own ring from every client thread and drains the backlogs of its sessions
+ */
+using meal_processor_t = ets::Runtime<message_queue_types_t, throttler_t>;
 
 /**
  * A client thread producing order messages
@@ -199,8 +86,7 @@ private:
 class Client
 {
 public:
-  Client(message_queue_t& message_queue, uint32_t client_id)
-    : _message_queue(message_queue), _client_id(client_id){};
+  Client(meal_processor_t::Producer& producer, uint32_t client_id) : _producer(producer), _client_id(client_id){};
 
   ~Client()
   {
@@ -239,30 +125,30 @@ private:
 
   void push_new_order()
   {
-    auto new_order = std::make_unique<NewOrder>("New Order Id: " + std::to_string(_order_id) +
-                                                " from client " + std::to_string(_client_id));
-    _message_queue.push(std::move(new_order));
+    NewOrder new_order{"New Order Id: " + std::to_string(_order_id) +
+                       " from client " + std::to_string(_client_id)};
+    _producer.push(_client_id, std::move(new_order));
     _order_id += 1;
   }
 
   void push_amend_order()
   {
-    auto amend_order = std::make_unique<AmendOrder>("Amend Order Id: " + std::to_string(_order_id) +
-                                                    " from client " + std::to_string(_client_id));
-    _message_queue.push(std::move(amend_order));
+    AmendOrder amend_order{"Amend Order Id: " + std::to_string(_order_id) +
+                           " from client " + std::to_string(_client_id)};
+    _producer.push(_client_id, std::move(amend_order));
     _order_id += 1;
   }
 
   void push_cancel_order()
   {
-    auto cancel_order = std::make_unique<CancelOrder>("Cancel Order Id: " + std::to_string(_order_id) +
-                                                      " from client " + std::to_string(_client_id));
-    _message_queue.push(std::move(cancel_order));
+    CancelOrder cancel_order{"Cancel Order Id: " + std::to_string(_order_id) +
+                             " from client " + std::to_string(_client_id)};
+    _producer.push(_client_id, std::move(cancel_order));
     _order_id += 1;
   }
 
 private:
-  message_queue_t& _message_queue;
+  meal_processor_t::Producer& _producer;
   uint32_t _client_id;
   uint32_t _order_id{0};
   std::thread _worker;
@@ -270,16 +156,28 @@ private:
 
 int main()
 {
-  message_queue_t message_queue;
+  ets::RuntimeConfig config;
+  config.pipelines = 2;
+  config.producers = 2;
 
-  MealProcessor mp{message_queue};
+  // one core per pipeline, a core that is not available leaves the pipeline unpinned
+  config.cpus = {0, 1};
+
+  meal_processor_t mp{config,
+                      [](ets::session_id_t)
+                      { return std::make_unique<throttler_t>(3, std::chrono::seconds{1}, OnSendCallback{}); }};
   mp.run();
 
-  Client client_1{message_queue, 1};
-  client_1.run();
+  {
+    Client client_1{mp.producer(0), 1};
+    client_1.run();
+
+    //  Client client_2{mp.producer(1), 2};
+    //  client_2.run();
+  }
 
-  //  Client client_2{message_queue, 2};
-  //  client_2.run();
+  // The pipelines never stop so the program has to be killed manually.
+  mp.join();
 
   return 0;
 }
@@ -0,0 +1,138 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ets/BucketedWindow.h"
+#include "ets/Clock.h"
+#include "ets/GcraWindow.h"
+#include "ets/Replay.h"
+#include "ets/SlidingWindow.h"
+
+/**
+ * Replays an event log through a throttler to tune its limits, see ets/Replay.h
+ *
+ *   ets_replay generate <log> <events> <messages per second> [urgent percent]
+ *     writes a synthetic log with Poisson arrivals
+ *   ets_replay run <log> <max messages> <interval ms> [sliding|gcra|bucketed]
+ *     replays the log and prints the report
+ */
+
+namespace
+{
+int usage()
+{
+  std::cerr << "usage: ets_replay generate <log> <events> <messages per second> [urgent percent]\n"
+               "       ets_replay run <log> <max messages> <interval ms> [sliding|gcra|bucketed]\n";
+  return 2;
+}
+
+int generate(std::string const& path, uint64_t count, double rate, uint64_t urgent_percent)
+{
+  std::vector<ets::ReplayEvent> events;
+  events.reserve(count);
+
+  // a fixed seed so the same arguments give the same log
+  uint64_t random{88172645463325252ULL};
+  auto const next = [&random]()
+  {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+  };
+
+  double timestamp{1e9};
+  for (uint64_t i = 0; i < count; ++i)
+  {
+    // exponential inter arrival times
+    double const uniform = (static_cast<double>(next() >> 11) + 0.5) / 9007199254740992.0;
+    timestamp += -std::log(uniform) * 1e9 / rate;
+
+    uint16_t const priority = next() % 100 < urgent_percent ? 0 : 1;
+    events.push_back(ets::ReplayEvent{static_cast<int64_t>(timestamp), static_cast<uint32_t>(i), priority});
+  }
+
+  ets::write_event_log(path, events);
+  std::cout << "wrote " << count << " events to " << path << '\n';
+  return 0;
+}
+
+template <typename TWindow>
+int run(ets::EventLog const& log, TWindow window, std::size_t max_messages, std::chrono::nanoseconds interval)
+{
+  auto const start = std::chrono::steady_clock::now();
+  ets::ReplayReport const report = ets::replay(log.events(), std::move(window));
+  auto const wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+  auto const us = [](std::chrono::nanoseconds d) { return static_cast<double>(d.count()) / 1e3; };
+
+  std::cout << "messages:      " << report.messages << '\n'
+            << "queued:        " << report.queued << '\n'
+            << "sent:          " << report.sent << '\n'
+            << "duration:      " << static_cast<double>(report.duration.count()) / 1e9 << " s\n"
+            << "throughput:    " << report.throughput() << " msg/s\n"
+            << "utilization:   " << 100.0 * report.utilization(max_messages, interval) << " %\n"
+            << "delay mean:    " << us(report.delays.mean()) << " us\n"
+            << "delay p50:     " << us(report.delays.value_at(0.5)) << " us\n"
+            << "delay p99:     " << us(report.delays.value_at(0.99)) << " us\n"
+            << "delay p99.9:   " << us(report.delays.value_at(0.999)) << " us\n"
+            << "delay max:     " << static_cast<double>(report.delays.max) / 1e3 << " us\n"
+            << "replay rate:   " << static_cast<double>(report.messages) / wall.count() << " events/s\n";
+  return 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 5)
+  {
+    return usage();
+  }
+
+  try
+  {
+    std::string_view const command{argv[1]};
+    std::string const path{argv[2]};
+
+    if (command == "generate")
+    {
+      return generate(path, std::stoull(argv[3]), std::stod(argv[4]), argc > 5 ? std::stoull(argv[5]) : 10);
+    }
+
+    if (command != "run")
+    {
+      return usage();
+    }
+
+    std::size_t const max_messages = std::stoull(argv[3]);
+    std::chrono::nanoseconds const interval{std::chrono::milliseconds{std::stoll(argv[4])}};
+    std::string_view const policy{argc > 5 ? argv[5] : "sliding"};
+
+    ets::EventLog const log{path};
+
+    if (policy == "sliding")
+    {
+      return run(log, ets::SlidingWindow<ets::ManualClock>{max_messages, interval}, max_messages, interval);
+    }
+    if (policy == "gcra")
+    {
+      return run(log, ets::GcraWindow<ets::ManualClock>{max_messages, interval}, max_messages, interval);
+    }
+    if (policy == "bucketed")
+    {
+      return run(log, ets::BucketedWindow<ets::ManualClock>{max_messages, interval}, max_messages, interval);
+    }
+
+    return usage();
+  }
+  catch (std::exception const& e)
+  {
+    std::cerr << "ets_replay: " << e.what() << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,122 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+
+#include "ets/AdaptiveWindow.h"
+#include "ets/Clock.h"
+#include "ets/GcraWindow.h"
+#include "ets/SlidingWindow.h"
+
+TEST_SUITE_BEGIN("AdaptiveWindow");
+
+using namespace ets;
+
+/***/
+TEST_CASE("set_limit keeps the timestamps in the window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  SlidingWindow<ManualClock> sw{4, std::chrono::seconds{1}};
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    REQUIRE_EQ(sw.request().count(), 0);
+    ManualClock::advance(std::chrono::milliseconds{100});
+  }
+
+  // a smaller limit keeps the newest timestamps, the window is still full
+  sw.set_limit(2, std::chrono::seconds{1});
+  REQUIRE_EQ(sw.size(), 2);
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{800});
+
+  // a larger limit keeps all of them and admits right away
+  sw.set_limit(8, std::chrono::seconds{1});
+  REQUIRE_EQ(sw.size(), 2);
+  REQUIRE_EQ(sw.request_n(8).admitted, 6);
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{800});
+
+  // a shorter interval lets the old timestamps out earlier
+  sw.set_limit(8, std::chrono::milliseconds{500});
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{300});
+}
+
+/***/
+TEST_CASE("set_limit of the gcra window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  GcraWindow<ManualClock> gcra{10, std::chrono::seconds{1}};
+  REQUIRE_EQ(gcra.request().count(), 0);
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{100});
+
+  // the message already sent keeps its emission interval, the next ones are slower
+  gcra.set_limit(2, std::chrono::seconds{1});
+  ManualClock::advance(std::chrono::milliseconds{100});
+  REQUIRE_EQ(gcra.request().count(), 0);
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{500});
+}
+
+/***/
+TEST_CASE("decrease on reject and ramp up")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  AimdConfig config;
+  config.decrease = 0.5;
+  config.increase = 2;
+  config.period = std::chrono::seconds{1};
+  config.min_messages = 3;
+
+  AdaptiveWindow<SlidingWindow<ManualClock>> window{10, std::chrono::seconds{1}, config};
+  REQUIRE_EQ(window.request_n(10).admitted, 10);
+
+  window.on_reject();
+  REQUIRE_EQ(window.limit(), 5);
+
+  // the rejects of the same burst do not decrease again
+  ManualClock::advance(std::chrono::milliseconds{500});
+  window.on_reject();
+  REQUIRE_EQ(window.limit(), 5);
+
+  // the window keeps the newest 5 messages which are still in the window
+  REQUIRE_EQ(window.request(), std::chrono::milliseconds{500});
+
+  // one period after the decrease the limit grows by one step
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(window.request_n(10).admitted, 7);
+  REQUIRE_EQ(window.limit(), 7);
+
+  // a reject after the period decreases again, never below the minimum
+  window.on_reject();
+  REQUIRE_EQ(window.limit(), 3);
+  ManualClock::advance(std::chrono::seconds{1});
+  window.on_reject();
+  REQUIRE_EQ(window.limit(), 3);
+
+  // the limit ramps up to the ceiling and stays there
+  ManualClock::advance(std::chrono::seconds{10});
+  REQUIRE_EQ(window.request_n(20).admitted, 10);
+  REQUIRE_EQ(window.limit(), 10);
+}
+
+/***/
+TEST_CASE("change the ceiling")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  AdaptiveWindow<SlidingWindow<ManualClock>> window{10, std::chrono::seconds{1}};
+  REQUIRE_EQ(window.request_n(4).admitted, 4);
+
+  window.set_ceiling(4, std::chrono::seconds{1});
+  REQUIRE_EQ(window.limit(), 4);
+  REQUIRE_GT(window.request().count(), 0);
+
+  // a wider ceiling is reached by ramping up
+  window.set_ceiling(20, std::chrono::seconds{1});
+  REQUIRE_EQ(window.limit(), 4);
+  ManualClock::advance(std::chrono::seconds{3});
+  REQUIRE_EQ(window.request_n(20).admitted, 7);
+  REQUIRE_EQ(window.ceiling(), 20);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,166 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+
+#include "ets/Arena.h"
+#include "ets/Clock.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("Arena");
+
+using namespace ets;
+
+namespace
+{
+/**
+ * Counts the allocations going to the heap
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations{0};
+  std::size_t live{0};
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    ++allocations;
+    ++live;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* memory, std::size_t bytes, std::size_t alignment) override
+  {
+    --live;
+    std::pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+  }
+
+  [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+struct NewOrder
+{
+  std::string desc;
+};
+
+struct CancelOrder
+{
+  uint64_t order_id;
+};
+
+struct RecordingCallback
+{
+  void on_send(NewOrder const& order) { sent += order.desc; }
+  void on_send(CancelOrder const&) { sent += "C"; }
+
+  std::string sent;
+};
+
+template <typename TStorage>
+class MockThrottler : public Throttler<CancelOrder, RecordingCallback, TStorage, SlidingWindow<ManualClock>>
+{
+public:
+  using base_t = Throttler<CancelOrder, RecordingCallback, TStorage, SlidingWindow<ManualClock>>;
+  using base_t::base_t;
+
+  std::string const& sent() { return this->_on_send_callback.sent; }
+};
+} // namespace
+
+/***/
+TEST_CASE("arena reuses its chunks after a rewind")
+{
+  CountingResource upstream;
+
+  {
+    Arena arena{&upstream, 256};
+    void* first = arena.allocate(100, 8);
+    (void)arena.allocate(100, 8);
+
+    // a third allocation does not fit the first chunk
+    void* aligned = arena.allocate(100, 64);
+    REQUIRE_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 64, 0);
+    REQUIRE_EQ(arena.chunks(), 2);
+
+    arena.rewind();
+    REQUIRE_EQ(arena.allocate(100, 8), first);
+    (void)arena.allocate(1'000, 8);
+    REQUIRE_EQ(upstream.allocations, 3);
+  }
+
+  REQUIRE_EQ(upstream.live, 0);
+}
+
+/***/
+TEST_CASE_TEMPLATE("backlog allocated from a resource", TStorage, TypeErasedStorage, ArenaStorage,
+                   VariantStorage<NewOrder>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  CountingResource resource;
+
+  {
+    MockThrottler<TStorage> throttler{1, std::chrono::seconds{1}, RecordingCallback{}, &resource};
+
+    // the window and the queues of the tiers
+    std::size_t const allocations = resource.allocations;
+    REQUIRE_EQ(allocations, 3);
+
+    for (uint32_t round = 0; round < 3; ++round)
+    {
+      ManualClock::advance(std::chrono::seconds{1});
+      (void)throttler.try_send_message(NewOrder{"a"});
+      for (uint32_t i = 0; i < 8; ++i)
+      {
+        (void)throttler.try_send_message(NewOrder{std::string(32, 'b')});
+      }
+      (void)throttler.try_send_message(CancelOrder{1});
+
+      while (throttler.send_queued_messages().count() != 0)
+      {
+        ManualClock::advance(std::chrono::seconds{1});
+      }
+    }
+
+    // the cancel is queued last and sent first
+    std::string const round_sent = "aC" + std::string(32 * 8, 'b');
+    REQUIRE_EQ(throttler.sent(), round_sent + round_sent + round_sent);
+
+    if constexpr (std::is_same_v<TStorage, TypeErasedStorage>)
+    {
+      // one allocation per queued message
+      REQUIRE_EQ(resource.allocations, allocations + 24);
+    }
+    else
+    {
+      // the arena takes a single chunk and reuses it for each backlog, the messages of the
+      // variant are stored in the queue
+      REQUIRE_EQ(resource.allocations, allocations + (std::is_same_v<TStorage, ArenaStorage> ? 1 : 0));
+    }
+  }
+
+  REQUIRE_EQ(resource.live, 0);
+}
+
+/***/
+TEST_CASE("arena backed by huge pages")
+{
+  HugePageResource huge_pages;
+  Arena arena{&huge_pages, HugePageResource::huge_page_size};
+
+  auto* bytes = static_cast<std::byte*>(arena.allocate(1'000, 8));
+  bytes[999] = std::byte{1};
+  REQUIRE_EQ(arena.capacity(), HugePageResource::huge_page_size);
+
+  arena.release();
+  REQUIRE_EQ(arena.chunks(), 0);
+}
+
+TEST_SUITE_END();
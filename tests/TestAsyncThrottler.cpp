@@ -0,0 +1,150 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "ets/AsyncThrottler.h"
+#include "ets/Clock.h"
+#include "ets/SlidingWindow.h"
+
+TEST_SUITE_BEGIN("AsyncThrottler");
+
+using namespace ets;
+
+namespace
+{
+/**
+ * A coroutine that starts right away and destroys itself when it finishes
+ */
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+struct Order
+{
+  // GCC 12 miscompiles aggregate temporaries created in a co_await expression
+  explicit Order(std::string desc) : desc(std::move(desc)) {}
+
+  std::string desc;
+};
+
+struct OnSendCallback
+{
+  void on_send(Order&& order) { sent->push_back(std::move(order.desc)); }
+  void on_send(Order const& order) { sent->push_back(order.desc + "&"); }
+
+  std::vector<std::string>* sent;
+};
+
+using throttler_t = AsyncThrottler<OnSendCallback, SlidingWindow<ManualClock>>;
+
+Detached send_orders(throttler_t& throttler, std::string name, uint32_t n, uint32_t& done)
+{
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    co_await throttler.send(Order{name + std::to_string(i)});
+  }
+
+  ++done;
+}
+} // namespace
+
+/***/
+TEST_CASE("send without waiting")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::vector<std::string> sent;
+  throttler_t throttler{3, std::chrono::seconds{1}, OnSendCallback{&sent}};
+
+  uint32_t done{0};
+  send_orders(throttler, "a", 3, done);
+
+  REQUIRE_EQ(done, 1);
+  REQUIRE_EQ(throttler.waiting(), 0);
+  REQUIRE_EQ(sent, std::vector<std::string>{"a0", "a1", "a2"});
+  REQUIRE_EQ(throttler.resume_admitted().count(), 0);
+}
+
+/***/
+TEST_CASE("resume when the window admits")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::vector<std::string> sent;
+  throttler_t throttler{2, std::chrono::seconds{1}, OnSendCallback{&sent}};
+
+  uint32_t done{0};
+  send_orders(throttler, "a", 3, done);
+  send_orders(throttler, "b", 2, done);
+
+  // a0 and a1 are sent, a2 and b0 wait in the order they awaited
+  REQUIRE_EQ(done, 0);
+  REQUIRE_EQ(throttler.waiting(), 2);
+  REQUIRE_EQ(throttler.resume_admitted(), std::chrono::seconds{1});
+
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.resume_admitted(), std::chrono::milliseconds{500});
+  REQUIRE_EQ(sent.size(), 2);
+
+  // a2 and b0 are resumed in one batch, then b1 waits behind them
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.resume_admitted(), std::chrono::seconds{1});
+  REQUIRE_EQ(done, 1);
+  REQUIRE_EQ(throttler.waiting(), 1);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.resume_admitted().count(), 0);
+  REQUIRE_EQ(done, 2);
+  REQUIRE_EQ(sent, std::vector<std::string>{"a0", "a1", "a2", "b0", "b1"});
+}
+
+/***/
+TEST_CASE("resumed coroutines use the rest of the window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::vector<std::string> sent;
+  throttler_t throttler{4, std::chrono::seconds{1}, OnSendCallback{&sent}};
+
+  uint32_t done{0};
+  send_orders(throttler, "a", 7, done);
+  REQUIRE_EQ(sent.size(), 4);
+
+  // the window frees 4 slots, a4 is resumed alone and awaits again for a5 and a6
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.resume_admitted().count(), 0);
+  REQUIRE_EQ(done, 1);
+  REQUIRE_EQ(sent.size(), 7);
+}
+
+/***/
+TEST_CASE("lvalues are sent by reference")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::vector<std::string> sent;
+  throttler_t throttler{1, std::chrono::seconds{1}, OnSendCallback{&sent}};
+
+  Order const order{"x"};
+  auto send_twice = [&throttler, &order]() -> Detached
+  {
+    co_await throttler.send(order);
+    co_await throttler.send(order);
+  };
+  send_twice();
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.resume_admitted().count(), 0);
+  REQUIRE_EQ(sent, std::vector<std::string>{"x&", "x&"});
+}
+
+TEST_SUITE_END();
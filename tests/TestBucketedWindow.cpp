@@ -0,0 +1,101 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+#include "ets/BucketedWindow.h"
+#include "ets/Clock.h"
+
+TEST_SUITE_BEGIN("BucketedWindow");
+
+using namespace ets;
+
+/***/
+TEST_CASE("request and check")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  // 10 messages per second in buckets of 100ms
+  BucketedWindow<ManualClock> window{10, std::chrono::seconds{1}, 10};
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    REQUIRE_EQ(window.request().count(), 0);
+  }
+
+  // the messages leave the window at the end of their bucket
+  REQUIRE_EQ(window.request(), std::chrono::milliseconds{1'100});
+
+  ManualClock::advance(std::chrono::milliseconds{1'050});
+  REQUIRE_EQ(window.request(), std::chrono::milliseconds{50});
+
+  ManualClock::advance(std::chrono::milliseconds{50});
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    REQUIRE_EQ(window.request().count(), 0);
+  }
+  REQUIRE_GT(window.request().count(), 0);
+}
+
+/***/
+TEST_CASE("request_n")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  BucketedWindow<ManualClock> window{100, std::chrono::seconds{1}, 10};
+
+  auto result = window.request_n(60);
+  REQUIRE_EQ(result.admitted, 60);
+  REQUIRE_EQ(result.delay.count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{300});
+  result = window.request_n(60);
+  REQUIRE_EQ(result.admitted, 40);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{800});
+
+  // the first 60 leave the window, the next 40 are still in it
+  ManualClock::advance(std::chrono::milliseconds{800});
+  result = window.request_n(200);
+  REQUIRE_EQ(result.admitted, 60);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{300});
+}
+
+/***/
+TEST_CASE("never admits more than the limit in any interval")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  constexpr std::size_t max_messages = 20;
+  constexpr auto interval = std::chrono::milliseconds{100};
+  BucketedWindow<ManualClock> window{max_messages, interval, 7};
+  std::deque<ManualClock::time_point> sent;
+
+  for (uint32_t i = 0; i < 20'000; ++i)
+  {
+    ManualClock::advance(std::chrono::microseconds{(i * 7919) % 1'500});
+    if (window.request().count() == 0)
+    {
+      sent.push_back(ManualClock::now());
+    }
+
+    while (ManualClock::now() - sent.front() >= interval)
+    {
+      sent.pop_front();
+    }
+    REQUIRE_LE(sent.size(), max_messages);
+  }
+}
+
+/***/
+TEST_CASE("idle window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  BucketedWindow<ManualClock> window{2, std::chrono::seconds{1}, 4};
+
+  REQUIRE_EQ(window.request_n(5).admitted, 2);
+
+  // every bucket expired
+  ManualClock::advance(std::chrono::hours{1});
+  REQUIRE_EQ(window.request_n(5).admitted, 2);
+}
+
+TEST_SUITE_END();
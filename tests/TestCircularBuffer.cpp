@@ -2,6 +2,9 @@
 
 #include "ets/CircularBuffer.h"
 #include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
 
 TEST_SUITE_BEGIN("CircularBuffer");
 
@@ -83,4 +86,125 @@ TEST_CASE("check buffer is full")
   REQUIRE(buffer.is_full());
 }
 
+/***/
+TEST_CASE("insert_n wraps around")
+{
+  CircularBuffer<uint32_t> buffer {4};
+
+  buffer.insert(1);
+  buffer.insert_n(2, 2);
+  REQUIRE_FALSE(buffer.is_full());
+  REQUIRE_EQ(buffer.size(), 3);
+
+  buffer.insert_n(3, 3);
+  REQUIRE(buffer.is_full());
+  REQUIRE_EQ(buffer.size(), 4);
+
+  // oldest to newest
+  REQUIRE_EQ(buffer.back(), 2);
+  REQUIRE_EQ(buffer[0], 2);
+  REQUIRE_EQ(buffer[1], 3);
+  REQUIRE_EQ(buffer[2], 3);
+  REQUIRE_EQ(buffer[3], 3);
+
+  // more items than the buffer holds replaces everything
+  buffer.insert_n(4, 10);
+  REQUIRE(buffer.is_full());
+  REQUIRE_EQ(buffer.back(), 4);
+
+  buffer.insert(5);
+  REQUIRE_EQ(buffer[3], 5);
+  REQUIRE_EQ(buffer.back(), 4);
+}
+
+/***/
+TEST_CASE("fixed capacity keeps the same items as the runtime capacity")
+{
+  // 5 is stored in 8 slots, 4 uses its storage exactly
+  CircularBuffer<uint32_t> dynamic5 {5};
+  CircularBuffer<uint32_t, 5> fixed5;
+  CircularBuffer<uint32_t> dynamic4 {4};
+  CircularBuffer<uint32_t, 4> fixed4;
+
+  static_assert(CircularBuffer<uint32_t, 5>::storage_size == 8);
+  static_assert(CircularBuffer<uint32_t, 5>::capacity() == 5);
+
+  std::mt19937 random {42};
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    if (random() % 3 == 0)
+    {
+      std::size_t const n = random() % 12;
+      dynamic5.insert_n(i, n);
+      fixed5.insert_n(i, n);
+      dynamic4.insert_n(i, n);
+      fixed4.insert_n(i, n);
+    }
+    else
+    {
+      dynamic5.insert(i);
+      fixed5.insert(i);
+      dynamic4.insert(i);
+      fixed4.insert(i);
+    }
+
+    REQUIRE_EQ(fixed5.is_full(), dynamic5.is_full());
+    REQUIRE_EQ(fixed5.size(), dynamic5.size());
+    REQUIRE_EQ(fixed4.size(), dynamic4.size());
+    for (std::size_t j = 0; j < fixed5.size(); ++j)
+    {
+      REQUIRE_EQ(fixed5[j], dynamic5[j]);
+    }
+    for (std::size_t j = 0; j < fixed4.size(); ++j)
+    {
+      REQUIRE_EQ(fixed4[j], dynamic4[j]);
+    }
+    if (fixed5.size() > 0)
+    {
+      REQUIRE_EQ(fixed5.back(), dynamic5.back());
+    }
+  }
+}
+
+/***/
+TEST_CASE_TEMPLATE("segments and count_greater", TBuffer, CircularBuffer<int>, CircularBuffer<int, 5>)
+{
+  TBuffer buffer = [] {
+    if constexpr (std::is_same_v<TBuffer, CircularBuffer<int>>)
+    {
+      return TBuffer{5};
+    }
+    else
+    {
+      return TBuffer{};
+    }
+  }();
+
+  REQUIRE(buffer.segments()[0].empty());
+  REQUIRE(buffer.segments()[1].empty());
+  REQUIRE_EQ(count_greater(buffer, 0), 0);
+
+  for (int i = 1; i <= 9; ++i)
+  {
+    buffer.insert(i);
+
+    // the segments hold the items from the oldest
+    std::vector<int> items;
+    for (auto const segment : buffer.segments())
+    {
+      items.insert(items.end(), segment.begin(), segment.end());
+    }
+    REQUIRE_EQ(items.size(), buffer.size());
+    for (std::size_t j = 0; j < items.size(); ++j)
+    {
+      REQUIRE_EQ(items[j], buffer[j]);
+    }
+  }
+
+  // 5 to 9 are in the buffer
+  REQUIRE_EQ(count_greater(buffer, 0), 5);
+  REQUIRE_EQ(count_greater(buffer, 6), 3);
+  REQUIRE_EQ(count_greater(buffer, 9), 0);
+}
+
 TEST_SUITE_END();
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <thread>
+
+#include "ets/Clock.h"
+
+TEST_SUITE_BEGIN("Clock");
+
+using namespace ets;
+
+/***/
+TEST_CASE("manual clock")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{10}});
+  REQUIRE_EQ(ManualClock::now().time_since_epoch(), std::chrono::seconds{10});
+
+  ManualClock::advance(std::chrono::milliseconds{5});
+  REQUIRE_EQ(ManualClock::now().time_since_epoch(), std::chrono::milliseconds{10005});
+}
+
+/***/
+TEST_CASE("coarse clock only moves on refresh")
+{
+  using clock_t = CoarseClock<ManualClock>;
+
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  clock_t::refresh();
+
+  ManualClock::advance(std::chrono::milliseconds{1});
+  REQUIRE_EQ(clock_t::now().time_since_epoch(), std::chrono::seconds{1});
+
+  clock_t::refresh();
+  REQUIRE_EQ(clock_t::now().time_since_epoch(), std::chrono::milliseconds{1001});
+}
+
+/***/
+TEST_CASE("tsc clock follows steady clock")
+{
+  auto const tsc_start = TscClock::now();
+  auto const steady_start = std::chrono::steady_clock::now();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+
+  auto const tsc_elapsed = TscClock::now() - tsc_start;
+  auto const steady_elapsed = std::chrono::steady_clock::now() - steady_start;
+
+  REQUIRE_GT(tsc_elapsed, std::chrono::nanoseconds{0});
+
+  // allow some drift from the calibration
+  auto const drift = tsc_elapsed > steady_elapsed ? tsc_elapsed - steady_elapsed : steady_elapsed - tsc_elapsed;
+  REQUIRE_LT(drift, std::chrono::milliseconds{2});
+}
+
+TEST_SUITE_END();
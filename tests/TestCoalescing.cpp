@@ -0,0 +1,258 @@
+#include "doctest.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("Coalescing");
+
+using namespace ets;
+
+namespace
+{
+struct NewOrder
+{
+  uint64_t order_id;
+};
+
+struct AmendOrder
+{
+  uint64_t order_id;
+  uint32_t quantity;
+};
+
+struct CancelOrder
+{
+  uint64_t order_id;
+};
+
+struct Heartbeat
+{
+};
+
+struct RecordingCallback
+{
+  void on_send(NewOrder const& order) { sent.push_back("N" + std::to_string(order.order_id)); }
+
+  void on_send(AmendOrder const& order)
+  {
+    sent.push_back("A" + std::to_string(order.order_id) + ":" + std::to_string(order.quantity));
+  }
+
+  void on_send(CancelOrder const& order) { sent.push_back("C" + std::to_string(order.order_id)); }
+
+  void on_send(Heartbeat const&) { sent.push_back("H"); }
+
+  std::vector<std::string> sent;
+};
+
+// an amend must not overtake its new order, so the amends are sent after the new orders
+using order_priorities_t = PriorityMap<Tier<CancelOrder>, Tier<NewOrder>, Tier<AmendOrder>, AnyTier<>>;
+using coalescing_t = OrderCoalescing<NewOrder, AmendOrder, CancelOrder>;
+
+static_assert(coalescing_t::supports<order_priorities_t>);
+static_assert(coalescing_t::supports<PriorityMap<Tier<NewOrder, AmendOrder>, AnyTier<>>>);
+static_assert(!coalescing_t::supports<PriorityMap<Tier<CancelOrder>, Tier<AmendOrder>, Tier<NewOrder>, AnyTier<>>>);
+
+template <typename TPriorityMap = order_priorities_t>
+class MockThrottler
+  : public PriorityThrottler<RecordingCallback, TPriorityMap, SlidingWindow<ManualClock>, coalescing_t>
+{
+public:
+  using base_t = PriorityThrottler<RecordingCallback, TPriorityMap, SlidingWindow<ManualClock>, coalescing_t>;
+  using base_t::base_t;
+
+  std::vector<std::string> const& sent() { return this->_on_send_callback.sent; }
+
+  void drain()
+  {
+    while (this->send_queued_messages().count() != 0)
+    {
+      ManualClock::advance(std::chrono::seconds{1});
+    }
+  }
+};
+} // namespace
+
+/***/
+TEST_CASE("amend replaces a queued amend")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(Heartbeat{}).count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{200});
+  REQUIRE_EQ(throttler.try_send_message(AmendOrder{1, 10}), std::chrono::milliseconds{800});
+
+  // coalesced amends still report when the window opens
+  ManualClock::advance(std::chrono::milliseconds{300});
+  REQUIRE_EQ(throttler.try_send_message(AmendOrder{1, 20}), std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.try_send_message(AmendOrder{2, 5}), std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.try_send_message(AmendOrder{1, 30}), std::chrono::milliseconds{500});
+
+  ManualClock::advance(std::chrono::milliseconds{500});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "A1:30", "A2:5"});
+
+  // the amend was sent, a new one is queued again
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 40}).count(), 0);
+  throttler.drain();
+  REQUIRE_EQ(throttler.sent().back(), "A1:40");
+}
+
+/***/
+TEST_CASE("cancel drops the queued order")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1}).count(), 0);
+
+  // order 2 never reached the venue, the cancel is dropped with it
+  REQUIRE_NE(throttler.try_send_message(NewOrder{2}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 10}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{3}).count(), 0);
+  REQUIRE_EQ(throttler.try_send_message(CancelOrder{2}).count(), 0);
+
+  // order 1 was sent, its cancel drops the queued amend and is queued itself
+  REQUIRE_NE(throttler.try_send_message(CancelOrder{1}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"N1", "C1", "N3"});
+}
+
+/***/
+TEST_CASE("amend waits for its queued new order")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{0}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{1}).count(), 0);
+
+  // the window has room again but the new order of the amend was not drained yet
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 10}).count(), 0);
+  REQUIRE_EQ(throttler.queued(), 2);
+
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"N0", "N1", "A1:10"});
+}
+
+/***/
+TEST_CASE("batches of amends coalesce")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {2, std::chrono::seconds{1}, RecordingCallback {}};
+
+  std::array<AmendOrder, 4> const amends{AmendOrder{1, 1}, AmendOrder{2, 1}, AmendOrder{1, 2}, AmendOrder{1, 3}};
+  auto const result = throttler.try_send_batch(std::span{amends});
+  REQUIRE_EQ(result.admitted, 2);
+  REQUIRE_NE(result.delay.count(), 0);
+
+  std::array<NewOrder, 3> const orders{NewOrder{4}, NewOrder{5}, NewOrder{6}};
+  REQUIRE_EQ(throttler.try_send_batch(std::span{orders}).admitted, 0);
+  REQUIRE_EQ(throttler.try_send_message(CancelOrder{5}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"A1:1", "A2:1", "N4", "N6", "A1:3"});
+}
+
+/***/
+TEST_CASE("batches count the sent messages only")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {2, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1}).count(), 0);
+  throttler.queue_message(NewOrder{2});
+
+  // the cancel of the queued order is dropped with it, only the cancel of the sent order is sent
+  std::array<CancelOrder, 2> const cancels{CancelOrder{2}, CancelOrder{1}};
+  auto const result = throttler.try_send_batch(std::span{cancels});
+  REQUIRE_EQ(result.admitted, 1);
+  REQUIRE_EQ(result.delay.count(), 0);
+
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"N1", "C1"});
+}
+
+/***/
+TEST_CASE("cancel drops an amend queued in another tier than its sent new order")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<> throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(Heartbeat{}).count(), 0);
+
+  // the new order and the amend are both the first message of their tier
+  REQUIRE_NE(throttler.try_send_message(NewOrder{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 5}).count(), 0);
+
+  // only the new order fits in the window, the amend stays queued
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "N1"});
+
+  // the new order reached the venue, the cancel is queued and drops the amend
+  REQUIRE_NE(throttler.try_send_message(CancelOrder{1}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "N1", "C1"});
+}
+
+/***/
+TEST_CASE("amend replaces an amend queued in another tier than its sent new order")
+{
+  using new_first_t = PriorityMap<Tier<NewOrder>, Tier<AmendOrder>, Tier<CancelOrder>, AnyTier<>>;
+
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<new_first_t> throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+  REQUIRE_EQ(throttler.try_send_message(Heartbeat{}).count(), 0);
+
+  REQUIRE_NE(throttler.try_send_message(NewOrder{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 5}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "N1"});
+
+  // sending the new order must not have released the queued amend
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 7}).count(), 0);
+  REQUIRE_EQ(throttler.queued(), 1);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "N1", "A1:7"});
+
+  // a cancel still drops the amend once the new order is sent
+  REQUIRE_NE(throttler.try_send_message(NewOrder{2}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{2, 5}).count(), 0);
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.send_queued_messages().count(), 0);
+  REQUIRE_NE(throttler.try_send_message(CancelOrder{2}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.drain();
+
+  REQUIRE_EQ(throttler.sent(), std::vector<std::string>{"H", "N1", "A1:7", "N2", "C2"});
+}
@@ -0,0 +1,109 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+
+#include "ets/BucketedWindow.h"
+#include "ets/Clock.h"
+#include "ets/CompositeWindow.h"
+#include "ets/GcraWindow.h"
+#include "ets/SlidingWindow.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("CompositeWindow");
+
+using namespace ets;
+
+namespace
+{
+// 3 messages per 10ms, 5 per second and 8 per minute
+using layered_window_t = CompositeWindow<FixedSlidingWindow<3, std::chrono::milliseconds{10}, ManualClock>,
+                                         SlidingWindow<ManualClock>, BucketedWindow<ManualClock>>;
+
+layered_window_t make_layered_window()
+{
+  return layered_window_t{{}, {5, std::chrono::seconds{1}}, {8, std::chrono::minutes{1}, 60}};
+}
+} // namespace
+
+/***/
+TEST_CASE("every window must admit")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  layered_window_t window = make_layered_window();
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    REQUIRE_EQ(window.request().count(), 0);
+  }
+
+  // the 10ms window is full
+  REQUIRE_EQ(window.request(), std::chrono::milliseconds{10});
+
+  ManualClock::advance(std::chrono::milliseconds{10});
+  REQUIRE_EQ(window.request().count(), 0);
+  REQUIRE_EQ(window.request().count(), 0);
+
+  // the second window is full and the rejected request was not recorded by the 10ms window
+  REQUIRE_EQ(window.request(), std::chrono::milliseconds{990});
+  ManualClock::advance(std::chrono::milliseconds{10});
+  REQUIRE_EQ(window.window<0>().admissible(3, ManualClock::now()), 3);
+
+  ManualClock::advance(std::chrono::milliseconds{980});
+  REQUIRE_EQ(window.request().count(), 0);
+  REQUIRE_EQ(window.request().count(), 0);
+  REQUIRE_EQ(window.request().count(), 0);
+
+  // the minute window is full until the bucket of the first messages leaves it
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(window.request(), std::chrono::seconds{59});
+}
+
+/***/
+TEST_CASE("request_n admits the smallest admission")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  layered_window_t window = make_layered_window();
+
+  auto result = window.request_n(10);
+  REQUIRE_EQ(result.admitted, 3);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{10});
+
+  ManualClock::advance(std::chrono::milliseconds{10});
+  result = window.request_n(10);
+  REQUIRE_EQ(result.admitted, 2);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{990});
+}
+
+/***/
+TEST_CASE("nested composite in a throttler")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  struct Msg
+  {
+  };
+
+  struct OnSendCallback
+  {
+    void on_send(Msg const&) { ++*sent; }
+    uint32_t* sent;
+  };
+
+  uint32_t sent{0};
+  using window_t = CompositeWindow<CompositeWindow<GcraWindow<ManualClock>>, SlidingWindow<ManualClock>>;
+  PriorityThrottler<OnSendCallback, PriorityMap<Tier<Msg>>, window_t> throttler{
+    window_t{CompositeWindow<GcraWindow<ManualClock>>{{100, std::chrono::seconds{1}, 100}},
+             {2, std::chrono::seconds{1}}},
+    OnSendCallback{&sent}};
+
+  REQUIRE_EQ(throttler.try_send_message(Msg{}).count(), 0);
+  REQUIRE_EQ(throttler.try_send_message(Msg{}).count(), 0);
+  REQUIRE_GT(throttler.try_send_message(Msg{}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(sent, 3);
+}
+
+TEST_SUITE_END();
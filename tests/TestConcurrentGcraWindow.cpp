@@ -0,0 +1,74 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/ConcurrentGcraWindow.h"
+#include "ets/GcraWindow.h"
+
+TEST_SUITE_BEGIN("ConcurrentGcraWindow");
+
+using namespace ets;
+
+/***/
+TEST_CASE("request like a gcra window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  GcraWindow<ManualClock> gcra { 100, std::chrono::seconds {1}, 5 };
+  ConcurrentGcraWindow<ManualClock> concurrent_gcra { 100, std::chrono::seconds {1}, 5 };
+  REQUIRE_EQ(concurrent_gcra.emission_interval(), gcra.emission_interval());
+
+  for (uint32_t i = 0; i < 1'000; ++i)
+  {
+    REQUIRE_EQ(concurrent_gcra.request(), gcra.request());
+    ManualClock::advance(std::chrono::milliseconds{i % 7});
+  }
+
+  for (std::size_t n = 0; n < 20; ++n)
+  {
+    auto const expected = gcra.request_n(n);
+    auto const result = concurrent_gcra.request_n(n);
+    REQUIRE_EQ(result.admitted, expected.admitted);
+    REQUIRE_EQ(result.delay, expected.delay);
+    ManualClock::advance(std::chrono::milliseconds{n * 3});
+  }
+}
+
+/***/
+TEST_CASE("concurrent senders never exceed the burst")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  constexpr std::size_t burst = 50;
+  constexpr uint32_t senders = 4;
+  constexpr uint32_t requests_per_sender = 10'000;
+
+  ConcurrentGcraWindow<ManualClock> gcra { 1'000, std::chrono::seconds {1}, burst };
+  std::atomic<std::size_t> admitted{0};
+
+  std::vector<std::thread> threads;
+  for (uint32_t s = 0; s < senders; ++s)
+  {
+    threads.emplace_back(
+      [&gcra, &admitted]()
+      {
+        for (uint32_t i = 0; i < requests_per_sender; ++i)
+        {
+          admitted.fetch_add(gcra.request_n(i % 3).admitted, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  // the clock did not move so exactly the burst was admitted
+  REQUIRE_EQ(admitted.load(), burst);
+}
@@ -0,0 +1,96 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/ConcurrentSlidingWindow.h"
+
+TEST_SUITE_BEGIN("ConcurrentSlidingWindow");
+
+using namespace ets;
+
+/***/
+TEST_CASE("request like a sliding window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  ConcurrentSlidingWindow<ManualClock> sw { 3, std::chrono::seconds {1} };
+
+  REQUIRE_EQ(sw.request().count(), 0);
+  ManualClock::advance(std::chrono::milliseconds{100});
+  REQUIRE_EQ(sw.request().count(), 0);
+  REQUIRE_EQ(sw.request().count(), 0);
+
+  // the window is full, the oldest message leaves it in 900 ms
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{900});
+  ManualClock::advance(std::chrono::milliseconds{100});
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{800});
+
+  ManualClock::advance(std::chrono::milliseconds{800});
+  REQUIRE_EQ(sw.request().count(), 0);
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{100});
+}
+
+/***/
+TEST_CASE("request_n admits the expired prefix")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  ConcurrentSlidingWindow<ManualClock> sw { 10, std::chrono::seconds {1} };
+
+  auto result = sw.request_n(6);
+  REQUIRE_EQ(result.admitted, 6);
+  REQUIRE_EQ(result.delay.count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{500});
+  result = sw.request_n(6);
+  REQUIRE_EQ(result.admitted, 4);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{500});
+
+  // the first 6 messages left the window
+  ManualClock::advance(std::chrono::milliseconds{500});
+  result = sw.request_n(8);
+  REQUIRE_EQ(result.admitted, 6);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{500});
+}
+
+/***/
+TEST_CASE("concurrent senders never exceed the limit")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  constexpr std::size_t max_messages = 100;
+  constexpr uint32_t senders = 4;
+  constexpr uint32_t requests_per_sender = 10'000;
+
+  ConcurrentSlidingWindow<ManualClock> sw { max_messages, std::chrono::seconds {1} };
+  std::atomic<std::size_t> admitted{0};
+
+  std::vector<std::thread> threads;
+  for (uint32_t s = 0; s < senders; ++s)
+  {
+    threads.emplace_back(
+      [&sw, &admitted]()
+      {
+        for (uint32_t i = 0; i < requests_per_sender; ++i)
+        {
+          if (sw.request().count() == 0)
+          {
+            admitted.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  // the clock did not move so exactly the limit was admitted
+  REQUIRE_EQ(admitted.load(), max_messages);
+}
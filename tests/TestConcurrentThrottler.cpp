@@ -0,0 +1,177 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/ConcurrentThrottler.h"
+
+TEST_SUITE_BEGIN("ConcurrentThrottler");
+
+using namespace ets;
+
+namespace
+{
+struct HighPrioMsg
+{
+};
+
+struct LowPrioMsg
+{
+  uint32_t sequence{0};
+};
+
+struct Counters
+{
+  std::atomic<std::size_t> high{0};
+  std::atomic<std::size_t> low{0};
+  std::atomic<std::size_t> low_before_high{0};
+};
+
+struct OnSendCallback
+{
+  void on_send(HighPrioMsg const&) { counters->high.fetch_add(1); }
+
+  void on_send(LowPrioMsg const&)
+  {
+    counters->low.fetch_add(1);
+    if (counters->high.load() == 0)
+    {
+      counters->low_before_high.fetch_add(1);
+    }
+  }
+
+  Counters* counters;
+};
+} // namespace
+
+/***/
+TEST_CASE_TEMPLATE("concurrent senders and a drain thread", TWindow, ConcurrentSlidingWindow<ManualClock>,
+                   ConcurrentGcraWindow<ManualClock>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  constexpr std::size_t max_messages = 100;
+  constexpr uint32_t senders = 4;
+  constexpr uint32_t messages_per_sender = 500;
+
+  Counters counters;
+  ConcurrentThrottler<HighPrioMsg, OnSendCallback, TypeErasedStorage, TWindow> throttler {
+    max_messages, std::chrono::seconds {1}, OnSendCallback {&counters}, 2048};
+
+  std::vector<std::thread> threads;
+  for (uint32_t s = 0; s < senders; ++s)
+  {
+    threads.emplace_back(
+      [&throttler]()
+      {
+        for (uint32_t i = 0; i < messages_per_sender; ++i)
+        {
+          (void)throttler.try_send_message(LowPrioMsg{i});
+        }
+      });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  // the clock did not move, at most the limit was sent and the rest is queued
+  std::size_t const sent = counters.low.load();
+  REQUIRE_GE(sent, 1);
+  REQUIRE_LE(sent, max_messages);
+  REQUIRE_NE(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(counters.low.load(), sent);
+
+  // a throttled high priority message is sent before the queued rest
+  REQUIRE_NE(throttler.try_send_message(HighPrioMsg{}).count(), 0);
+
+  std::size_t const total = std::size_t{senders} * messages_per_sender;
+  while (counters.low.load() != total)
+  {
+    ManualClock::advance(std::chrono::seconds{1});
+    (void)throttler.send_queued_messages();
+  }
+
+  REQUIRE_EQ(counters.high.load(), 1);
+  REQUIRE_EQ(counters.low_before_high.load(), sent);
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+}
+
+/***/
+TEST_CASE("variant storage backlog")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  Counters counters;
+  ConcurrentThrottler<HighPrioMsg, OnSendCallback, VariantStorage<LowPrioMsg>, ConcurrentSlidingWindow<ManualClock>>
+    throttler {2, std::chrono::seconds {1}, OnSendCallback {&counters}, 16};
+
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    (void)throttler.try_send_message(LowPrioMsg{i});
+  }
+
+  REQUIRE_EQ(counters.low.load(), 2);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages(), std::chrono::seconds{1});
+  REQUIRE_EQ(counters.low.load(), 4);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(counters.low.load(), 5);
+}
+
+/***/
+TEST_CASE_TEMPLATE("window constructed in place", TWindow, ConcurrentSlidingWindow<ManualClock>,
+                   ConcurrentGcraWindow<ManualClock>)
+{
+  using throttler_t = ConcurrentThrottler<HighPrioMsg, OnSendCallback, TypeErasedStorage, TWindow>;
+
+  // the concurrent windows can not be moved into the throttler
+  static_assert(!std::is_constructible_v<throttler_t, TWindow, OnSendCallback>);
+
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  Counters counters;
+  throttler_t throttler {std::in_place, OnSendCallback {&counters}, 16, 2, std::chrono::seconds {1}};
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    (void)throttler.try_send_message(LowPrioMsg{i});
+  }
+
+  REQUIRE_GE(counters.low.load(), 1);
+  REQUIRE_LT(counters.low.load(), 3);
+
+  while (throttler.send_queued_messages().count() != 0)
+  {
+    ManualClock::advance(std::chrono::milliseconds{500});
+  }
+  REQUIRE_EQ(counters.low.load(), 3);
+}
+
+/***/
+TEST_CASE("gcra window with a burst constructed in place")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  Counters counters;
+  ConcurrentThrottler<HighPrioMsg, OnSendCallback, TypeErasedStorage, ConcurrentGcraWindow<ManualClock>> throttler {
+    std::in_place, OnSendCallback {&counters}, 16, 10, std::chrono::seconds {1}, 5};
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    (void)throttler.try_send_message(LowPrioMsg{i});
+  }
+
+  // the burst is sent right away, the rest is queued
+  REQUIRE_EQ(counters.low.load(), 5);
+}
@@ -0,0 +1,76 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "ets/ConsistentHashRing.h"
+
+TEST_SUITE_BEGIN("ConsistentHashRing");
+
+using namespace ets;
+
+/***/
+TEST_CASE("keys spread evenly over the nodes")
+{
+  constexpr uint32_t nodes = 4;
+  constexpr uint64_t keys = 40'000;
+
+  ConsistentHashRing const ring{nodes, 128};
+  REQUIRE_EQ(ring.points(), nodes * 128);
+
+  std::vector<uint64_t> keys_per_node(nodes, 0);
+  for (uint64_t key = 0; key < keys; ++key)
+  {
+    uint32_t const node = ring.node_of(mix_hash(key));
+    REQUIRE_LT(node, nodes);
+    keys_per_node[node] += 1;
+  }
+
+  // within 25% of a fair share
+  for (uint64_t const count : keys_per_node)
+  {
+    REQUIRE_GT(count, keys / nodes * 3 / 4);
+    REQUIRE_LT(count, keys / nodes * 5 / 4);
+  }
+}
+
+/***/
+TEST_CASE("adding a node only moves the keys it takes over")
+{
+  constexpr uint64_t keys = 10'000;
+
+  ConsistentHashRing ring{3};
+
+  std::vector<uint32_t> before;
+  for (uint64_t key = 0; key < keys; ++key)
+  {
+    before.push_back(ring.node_of(mix_hash(key)));
+  }
+
+  ring.add_node(3);
+
+  uint64_t moved{0};
+  for (uint64_t key = 0; key < keys; ++key)
+  {
+    uint32_t const node = ring.node_of(mix_hash(key));
+    if (node != before[key])
+    {
+      // a key only ever moves to the new node
+      REQUIRE_EQ(node, 3);
+      moved += 1;
+    }
+  }
+
+  // about a quarter of the keys
+  REQUIRE_GT(moved, keys / 8);
+  REQUIRE_LT(moved, keys / 2);
+
+  // removing the node gives the keys back
+  ring.remove_node(3);
+  for (uint64_t key = 0; key < keys; ++key)
+  {
+    REQUIRE_EQ(ring.node_of(mix_hash(key)), before[key]);
+  }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,266 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/Expiry.h"
+#include "ets/Metrics.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("Expiry");
+
+using namespace ets;
+
+namespace
+{
+struct CancelOrder
+{
+  uint64_t order_id;
+};
+
+struct NewOrder
+{
+  uint64_t order_id;
+};
+
+struct AmendOrder
+{
+  uint64_t order_id;
+  uint32_t quantity;
+};
+
+struct Quote
+{
+  uint64_t id;
+  std::chrono::nanoseconds ttl;
+};
+
+struct RecordingCallback
+{
+  void on_send(CancelOrder const& order) { sent.push_back("C" + std::to_string(order.order_id)); }
+  void on_send(NewOrder const& order) { sent.push_back("N" + std::to_string(order.order_id)); }
+  void on_send(Quote const& quote) { sent.push_back("Q" + std::to_string(quote.id)); }
+
+  void on_send(AmendOrder const& order)
+  {
+    sent.push_back("A" + std::to_string(order.order_id) + ":" + std::to_string(order.quantity));
+  }
+
+  void on_expire(NewOrder const& order) { expired.push_back("N" + std::to_string(order.order_id)); }
+  void on_expire(Quote const& quote) { expired.push_back("Q" + std::to_string(quote.id)); }
+
+  void on_expire(AmendOrder const& order)
+  {
+    expired.push_back("A" + std::to_string(order.order_id) + ":" + std::to_string(order.quantity));
+  }
+
+  std::vector<std::string> sent;
+  std::vector<std::string> expired;
+};
+
+/**
+ * Takes the quotes in batches and keeps the size of each batch
+ */
+struct BatchCallback : RecordingCallback
+{
+  using RecordingCallback::on_send;
+
+  void on_send_batch(std::span<Quote const> quotes)
+  {
+    batches.push_back(quotes.size());
+    for (Quote const& quote : quotes)
+    {
+      on_send(quote);
+    }
+  }
+
+  std::vector<std::size_t> batches;
+};
+
+using new_order_ttl_t = ExpiryByType<TtlOf<NewOrder, std::chrono::milliseconds{500}>>;
+
+/**
+ * A time to live per quote
+ */
+struct QuoteExpiry
+{
+  static constexpr bool enabled = true;
+
+  static std::chrono::nanoseconds ttl(Quote const& quote) { return quote.ttl; }
+
+  static std::chrono::nanoseconds ttl(auto const&) { return never_expires; }
+};
+
+template <typename TCallback, typename TPriorityMap, typename TExpiry, typename TMetrics = NoMetrics,
+          typename TCoalescing = NoCoalescing>
+class MockThrottler
+  : public PriorityThrottler<TCallback, TPriorityMap, SlidingWindow<ManualClock>, TCoalescing, TMetrics, TExpiry>
+{
+public:
+  using base_t = PriorityThrottler<TCallback, TPriorityMap, SlidingWindow<ManualClock>, TCoalescing, TMetrics, TExpiry>;
+  using base_t::base_t;
+
+  TCallback const& callback() const { return this->_on_send_callback; }
+};
+
+using order_priorities_t = PriorityMap<Tier<CancelOrder>, AnyTier<>>;
+} // namespace
+
+/***/
+TEST_CASE("time to live per type")
+{
+  static_assert(new_order_ttl_t::ttl(NewOrder{1}) == std::chrono::milliseconds{500});
+  static_assert(new_order_ttl_t::ttl(CancelOrder{1}) == never_expires);
+
+  static_assert(ExpiryIndex<1>::deadline_of(100, std::chrono::nanoseconds{20}) == 120);
+  static_assert(ExpiryIndex<1>::deadline_of(100, never_expires) == INT64_MAX);
+}
+
+/***/
+TEST_CASE("expired messages do not use a slot")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<RecordingCallback, order_priorities_t, new_order_ttl_t> throttler {
+    1, std::chrono::seconds {1}, RecordingCallback {}};
+
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{2}).count(), 0);
+  REQUIRE_NE(throttler.try_emplace_message<NewOrder>(uint64_t{3}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(CancelOrder{1}).count(), 0);
+
+  // the cancel never expires, the new orders queued a second ago are stale
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+
+  REQUIRE_EQ(throttler.callback().sent, std::vector<std::string>{"N1", "C1"});
+  REQUIRE_EQ(throttler.callback().expired, std::vector<std::string>{"N2", "N3"});
+  REQUIRE_EQ(throttler.queued(), 0);
+
+  // a new order sent before its deadline is sent
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{4}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{5}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.callback().sent, std::vector<std::string>{"N1", "C1", "N4"});
+  REQUIRE_EQ(throttler.callback().expired, std::vector<std::string>{"N2", "N3", "N5"});
+
+  // within the time to live the order is sent when the window opens
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{6}).count(), 0);
+  ManualClock::advance(std::chrono::milliseconds{600});
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{7}), std::chrono::milliseconds{400});
+  ManualClock::advance(std::chrono::milliseconds{400});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.callback().sent.back(), "N7");
+}
+
+/***/
+TEST_CASE("expired messages are released while the window is full")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<RecordingCallback, PriorityMap<AnyTier<>>, QuoteExpiry> throttler {
+    1, std::chrono::seconds {1}, RecordingCallback {}};
+
+  REQUIRE_EQ(throttler.try_send_message(Quote{1, never_expires}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(Quote{2, std::chrono::milliseconds{100}}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(Quote{3, std::chrono::milliseconds{200}}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(Quote{4, never_expires}).count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{600});
+  REQUIRE_EQ(throttler.send_queued_messages(), std::chrono::milliseconds{400});
+
+  REQUIRE_EQ(throttler.callback().expired, std::vector<std::string>{"Q2", "Q3"});
+  REQUIRE_EQ(throttler.queued(), 1);
+
+  ManualClock::advance(std::chrono::milliseconds{400});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.callback().sent, std::vector<std::string>{"Q1", "Q4"});
+}
+
+/***/
+TEST_CASE("batches stop at the expired messages")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<BatchCallback, PriorityMap<Tier<Quote>>, QuoteExpiry> throttler {
+    10, std::chrono::seconds {1}, BatchCallback {}};
+
+  for (uint64_t i = 0; i < 10; ++i)
+  {
+    REQUIRE_EQ(throttler.try_send_message(Quote{i, never_expires}).count(), 0);
+  }
+
+  // quotes 12, 13 and 17 expire before the window opens
+  for (uint64_t i = 10; i < 20; ++i)
+  {
+    bool const stale = (i == 12) || (i == 13) || (i == 17);
+    auto const ttl = stale ? std::chrono::nanoseconds{std::chrono::milliseconds{10}} : never_expires;
+    REQUIRE_NE(throttler.try_send_message(Quote{i, ttl}).count(), 0);
+  }
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+
+  REQUIRE_EQ(throttler.callback().batches, std::vector<std::size_t>{2, 3, 2});
+  REQUIRE_EQ(throttler.callback().expired, std::vector<std::string>{"Q12", "Q13", "Q17"});
+  REQUIRE_EQ(throttler.callback().sent.size(), 17);
+  REQUIRE_EQ(throttler.callback().sent.back(), "Q19");
+  REQUIRE_EQ(throttler.queued(), 0);
+}
+
+/***/
+TEST_CASE("a replaced amend gets a deadline of its own")
+{
+  using priorities_t = PriorityMap<Tier<CancelOrder>, Tier<NewOrder>, Tier<AmendOrder>>;
+  using amend_ttl_t = ExpiryByType<TtlOf<AmendOrder, std::chrono::milliseconds{500}>>;
+
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<RecordingCallback, priorities_t, amend_ttl_t, NoMetrics, OrderCoalescing<NewOrder, AmendOrder, CancelOrder>>
+    throttler {1, std::chrono::seconds {1}, RecordingCallback {}};
+
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 10}).count(), 0);
+
+  // the first amend would have expired when the window opens, the one replacing it has not
+  ManualClock::advance(std::chrono::milliseconds{600});
+  REQUIRE_NE(throttler.try_send_message(AmendOrder{1, 20}).count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{400});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+
+  REQUIRE_EQ(throttler.callback().sent, std::vector<std::string>{"N1", "A1:20"});
+  REQUIRE(throttler.callback().expired.empty());
+}
+
+/***/
+TEST_CASE("expired messages are counted")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<RecordingCallback, order_priorities_t, new_order_ttl_t, AtomicMetrics> throttler {
+    1, std::chrono::seconds {1}, RecordingCallback {}};
+
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{2}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(NewOrder{3}).count(), 0);
+
+  ManualClock::advance(std::chrono::seconds{2});
+  REQUIRE_EQ(throttler.send_queued_messages(DrainBudget{1}).sent, 0);
+
+  auto const snapshot = throttler.metrics().snapshot();
+  REQUIRE_EQ(snapshot.tiers[1].queued, 2);
+  REQUIRE_EQ(snapshot.tiers[1].expired, 2);
+  REQUIRE_EQ(snapshot.tiers[1].sent, 0);
+  REQUIRE_EQ(snapshot.tiers[1].depth, 0);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,92 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "ets/FlatHashMap.h"
+
+TEST_SUITE_BEGIN("FlatHashMap");
+
+using namespace ets;
+
+/***/
+TEST_CASE("insert find and erase")
+{
+  FlatHashMap<uint32_t, std::string> map {4};
+
+  auto [value, inserted] = map.try_emplace(1, "one");
+  REQUIRE(inserted);
+  REQUIRE_EQ(*value, "one");
+
+  std::tie(value, inserted) = map.try_emplace(1, "uno");
+  REQUIRE_FALSE(inserted);
+  REQUIRE_EQ(*value, "one");
+
+  // grow
+  for (uint32_t i = 2; i < 100; ++i)
+  {
+    map.try_emplace(i, std::to_string(i));
+  }
+
+  REQUIRE_EQ(map.size(), 99);
+  REQUIRE_EQ(*map.find(50), "50");
+  REQUIRE_EQ(map.find(100), nullptr);
+
+  REQUIRE(map.erase(50));
+  REQUIRE_FALSE(map.erase(50));
+  REQUIRE_EQ(map.find(50), nullptr);
+  REQUIRE_EQ(map.size(), 98);
+}
+
+/***/
+TEST_CASE("matches unordered_map under churn")
+{
+  FlatHashMap<uint64_t, uint64_t> map;
+  std::unordered_map<uint64_t, uint64_t> reference;
+
+  uint64_t seed{42};
+  auto next = [&seed]()
+  {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+  };
+
+  for (uint32_t i = 0; i < 50'000; ++i)
+  {
+    uint64_t const key = next() % 512;
+
+    if (next() % 3 == 0)
+    {
+      REQUIRE_EQ(map.erase(key), reference.erase(key) == 1);
+    }
+    else
+    {
+      map.try_emplace(key, i);
+      reference.try_emplace(key, i);
+    }
+  }
+
+  REQUIRE_EQ(map.size(), reference.size());
+  for (auto const& [key, value] : reference)
+  {
+    REQUIRE_NE(map.find(key), nullptr);
+    REQUIRE_EQ(*map.find(key), value);
+  }
+
+  // erase all odd values
+  std::size_t const erased = map.erase_if([](uint64_t const&, uint64_t const& value) { return value % 2 == 1; });
+  std::size_t const reference_erased = std::erase_if(reference, [](auto const& item) { return item.second % 2 == 1; });
+  REQUIRE_EQ(erased, reference_erased);
+
+  std::size_t visited{0};
+  map.for_each(
+    [&](uint64_t const& key, uint64_t const& value)
+    {
+      REQUIRE_EQ(reference.at(key), value);
+      ++visited;
+    });
+  REQUIRE_EQ(visited, reference.size());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,146 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+#include "ets/Clock.h"
+#include "ets/GcraWindow.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("GcraWindow");
+
+using namespace ets;
+
+/***/
+TEST_CASE("request evenly spaced")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  // Accept 100 requests per second, one every 10 ms
+  GcraWindow<ManualClock> gcra { 100, std::chrono::seconds {1} };
+  REQUIRE_EQ(gcra.emission_interval(), std::chrono::milliseconds{10});
+
+  REQUIRE_EQ(gcra.request().count(), 0);
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{10});
+
+  ManualClock::advance(std::chrono::milliseconds{4});
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{6});
+
+  ManualClock::advance(std::chrono::milliseconds{6});
+  REQUIRE_EQ(gcra.request().count(), 0);
+
+  // being idle does not accumulate credit
+  ManualClock::advance(std::chrono::seconds{5});
+  REQUIRE_EQ(gcra.request().count(), 0);
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{10});
+}
+
+/***/
+TEST_CASE("request with burst")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  GcraWindow<ManualClock> gcra { 100, std::chrono::seconds {1}, 10 };
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    REQUIRE_EQ(gcra.request().count(), 0);
+  }
+
+  REQUIRE_EQ(gcra.request(), std::chrono::milliseconds{10});
+}
+
+/***/
+TEST_CASE("never exceeds the sliding window limit")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  constexpr std::size_t max_messages = 50;
+  constexpr std::chrono::milliseconds interval{100};
+  GcraWindow<ManualClock> gcra { max_messages, interval };
+
+  std::deque<ManualClock::time_point> sent;
+  for (uint32_t i = 0; i < 10'000; ++i)
+  {
+    auto const delay = gcra.request();
+
+    if (delay.count() != 0)
+    {
+      ManualClock::advance(delay);
+      continue;
+    }
+
+    sent.push_back(ManualClock::now());
+    while (ManualClock::now() - sent.front() >= interval)
+    {
+      sent.pop_front();
+    }
+
+    REQUIRE_LE(sent.size(), max_messages);
+  }
+}
+
+namespace
+{
+struct OnSendCallback
+{
+  template <typename TMessage>
+  void on_send(TMessage const&)
+  {
+    ++counter;
+  }
+
+  size_t counter{0};
+};
+} // namespace
+
+/***/
+TEST_CASE("throttler with gcra window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  Throttler<int, OnSendCallback, TypeErasedStorage, GcraWindow<ManualClock>> throttler {
+    GcraWindow<ManualClock>{10, std::chrono::seconds{1}, 5}, OnSendCallback{}};
+
+  for (uint32_t i = 0; i < 20; ++i)
+  {
+    auto const delay = throttler.try_send_message(i % 2 == 0 ? 'c' : 'd');
+    REQUIRE_EQ(delay.count() == 0, i < 5);
+  }
+
+  auto delay = throttler.send_queued_messages();
+  uint32_t drains{0};
+  while (delay.count() != 0)
+  {
+    ManualClock::advance(delay);
+    delay = throttler.send_queued_messages();
+    ++drains;
+  }
+
+  // the remaining 15 messages are sent one per emission interval
+  REQUIRE_EQ(drains, 15);
+}
+
+/***/
+TEST_CASE("request_n")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  GcraWindow<ManualClock> gcra { 100, std::chrono::seconds {1}, 10 };
+
+  auto result = gcra.request_n(4);
+  REQUIRE_EQ(result.admitted, 4);
+  REQUIRE_EQ(result.delay.count(), 0);
+
+  result = gcra.request_n(20);
+  REQUIRE_EQ(result.admitted, 6);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{10});
+
+  ManualClock::advance(std::chrono::milliseconds{25});
+  result = gcra.request_n(20);
+  REQUIRE_EQ(result.admitted, 2);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{5});
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,162 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/KeyedThrottler.h"
+#include "ets/SlidingWindow.h"
+
+TEST_SUITE_BEGIN("KeyedThrottler");
+
+using namespace ets;
+
+namespace
+{
+struct HighPrioMsg
+{
+  uint32_t id;
+};
+
+struct LowPrioMsg
+{
+  uint32_t id;
+};
+
+struct OnSendCallback
+{
+  void on_send(uint32_t key, HighPrioMsg const& message) { sent.emplace_back(key, message.id); }
+
+  void on_send(uint32_t key, LowPrioMsg const& message) { sent.emplace_back(key, message.id); }
+
+  std::vector<std::pair<uint32_t, uint32_t>> sent;
+};
+
+template <typename TWindow>
+class MockKeyedThrottler : public KeyedThrottler<uint32_t, HighPrioMsg, OnSendCallback, TypeErasedStorage, TWindow>
+{
+public:
+  using base_t = KeyedThrottler<uint32_t, HighPrioMsg, OnSendCallback, TypeErasedStorage, TWindow>;
+  using base_t::base_t;
+
+  OnSendCallback& get_on_send() { return this->_on_send_callback; }
+};
+} // namespace
+
+/***/
+TEST_CASE_TEMPLATE("limit per key", TWindow, GcraWindow<ManualClock>, SlidingWindow<ManualClock>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  // 2 messages per second per key
+  MockKeyedThrottler<TWindow> throttler {2, std::chrono::seconds{1}, OnSendCallback{}};
+
+  // key 1 sends the first message, key 2 is not affected by key 1
+  REQUIRE_EQ(throttler.try_send_message(1, LowPrioMsg{0}).count(), 0);
+  REQUIRE_EQ(throttler.try_send_message(2, LowPrioMsg{0}).count(), 0);
+  REQUIRE_EQ(throttler.keys(), 2);
+
+  // exhaust key 1
+  std::chrono::nanoseconds delay{0};
+  for (uint32_t i = 1; i < 5; ++i)
+  {
+    delay = throttler.try_send_message(1, LowPrioMsg{i});
+  }
+  REQUIRE_GT(delay.count(), 0);
+
+  // a high priority message of key 1 is queued while key 2 still sends
+  REQUIRE_GT(throttler.try_send_message(1, HighPrioMsg{100}).count(), 0);
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.try_send_message(2, LowPrioMsg{1}).count(), 0);
+  REQUIRE_EQ(throttler.get_on_send().sent.back(), std::make_pair(2u, 1u));
+
+  std::size_t const queued = throttler.queued_messages();
+  REQUIRE_GT(queued, 0);
+
+  // drain everything
+  delay = throttler.send_queued_messages();
+  while (delay.count() != 0)
+  {
+    ManualClock::advance(delay);
+    delay = throttler.send_queued_messages();
+  }
+
+  REQUIRE_EQ(throttler.queued_messages(), 0);
+
+  // for key 1 the high priority message is sent first, then the low priority ones in order
+  std::vector<uint32_t> key_1_ids;
+  for (auto const& [key, id] : throttler.get_on_send().sent)
+  {
+    if (key == 1)
+    {
+      key_1_ids.push_back(id);
+    }
+  }
+
+  REQUIRE_EQ(key_1_ids.size(), 6);
+  std::size_t const sent_first = key_1_ids.size() - queued;
+  REQUIRE_EQ(key_1_ids[sent_first], 100);
+  for (std::size_t i = 0; i < key_1_ids.size(); ++i)
+  {
+    if (i != sent_first)
+    {
+      REQUIRE_EQ(key_1_ids[i], i < sent_first ? i : i - 1);
+    }
+  }
+}
+
+/***/
+TEST_CASE_TEMPLATE("messages of a key keep their order", TWindow, GcraWindow<ManualClock>, SlidingWindow<ManualClock>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockKeyedThrottler<TWindow> throttler {1, std::chrono::seconds{1}, OnSendCallback{}};
+
+  REQUIRE_EQ(throttler.try_send_message(7, LowPrioMsg{1}).count(), 0);
+  REQUIRE_NE(throttler.try_send_message(7, LowPrioMsg{2}).count(), 0);
+
+  // the window has room again but message 2 was not drained yet
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.try_send_message(7, LowPrioMsg{3}).count(), 0);
+  REQUIRE_EQ(throttler.queued_messages(), 2);
+
+  std::chrono::nanoseconds delay = throttler.send_queued_messages();
+  while (delay.count() != 0)
+  {
+    ManualClock::advance(delay);
+    delay = throttler.send_queued_messages();
+  }
+
+  REQUIRE_EQ(throttler.get_on_send().sent,
+             std::vector<std::pair<uint32_t, uint32_t>>{{7u, 1u}, {7u, 2u}, {7u, 3u}});
+}
+
+/***/
+TEST_CASE("evict idle keys")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockKeyedThrottler<GcraWindow<ManualClock>> throttler {1, std::chrono::seconds{1}, OnSendCallback{}};
+
+  for (uint32_t key = 0; key < 1000; ++key)
+  {
+    REQUIRE_EQ(throttler.try_send_message(key, LowPrioMsg{key}).count(), 0);
+  }
+
+  // key 0 has a queued message
+  REQUIRE_GT(throttler.try_send_message(0, LowPrioMsg{1}).count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.evict_idle(std::chrono::seconds{1}), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{500});
+  REQUIRE_EQ(throttler.evict_idle(std::chrono::seconds{1}), 999);
+  REQUIRE_EQ(throttler.keys(), 1);
+
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.get_on_send().sent.back(), std::make_pair(0u, 1u));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,88 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ets/MessageStorage.h"
+
+TEST_SUITE_BEGIN("MessageStorage");
+
+using namespace ets;
+
+struct IntMsg
+{
+  uint32_t value;
+};
+
+struct StringMsg
+{
+  std::string value;
+};
+
+struct RecordingCallback
+{
+  void on_send(IntMsg const& message) { sent.push_back(std::to_string(message.value)); }
+  void on_send(StringMsg const& message) { sent.push_back(message.value); }
+
+  std::vector<std::string> sent;
+};
+
+template <typename TContainer>
+void push_send_and_pop(TContainer& container)
+{
+  RecordingCallback callback;
+
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    if (i % 2 == 0)
+    {
+      container.push(IntMsg{i});
+    }
+    else
+    {
+      container.push(StringMsg{std::to_string(i)});
+    }
+  }
+
+  REQUIRE_EQ(container.size(), 100);
+
+  // send a prefix and release it
+  for (std::size_t i = 0; i < 30; ++i)
+  {
+    container.send(i, callback);
+  }
+  container.pop_front(30);
+
+  REQUIRE_EQ(container.size(), 70);
+
+  for (std::size_t i = 0; i < container.size(); ++i)
+  {
+    container.send(i, callback);
+  }
+  container.pop_front(container.size());
+
+  REQUIRE(container.empty());
+  REQUIRE_EQ(callback.sent.size(), 100);
+
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    REQUIRE_EQ(callback.sent[i], std::to_string(i));
+  }
+}
+
+/***/
+TEST_CASE("type erased storage keeps order")
+{
+  TypeErasedStorage::container<RecordingCallback> container;
+  push_send_and_pop(container);
+}
+
+/***/
+TEST_CASE("variant storage keeps order")
+{
+  VariantStorage<IntMsg, StringMsg>::container<RecordingCallback> container;
+  push_send_and_pop(container);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,156 @@
+#include "doctest.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "ets/Clock.h"
+#include "ets/Metrics.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("Metrics");
+
+using namespace ets;
+
+namespace
+{
+struct HighPrioMsg
+{
+};
+
+struct LowPrioMsg
+{
+};
+
+struct OnSendCallback
+{
+  template <typename TMessage>
+  void on_send(TMessage const&)
+  {
+  }
+};
+
+using priorities_t = PriorityMap<Tier<HighPrioMsg>, AnyTier<>>;
+using metered_throttler_t =
+  PriorityThrottler<OnSendCallback, priorities_t, SlidingWindow<ManualClock>, NoCoalescing, AtomicMetrics>;
+using throttler_t = PriorityThrottler<OnSendCallback, priorities_t, SlidingWindow<ManualClock>>;
+} // namespace
+
+// without metrics the throttler has no extra state
+static_assert(sizeof(throttler_t) == sizeof(Throttler<HighPrioMsg, OnSendCallback, TypeErasedStorage, SlidingWindow<ManualClock>>));
+
+/***/
+TEST_CASE("histogram buckets")
+{
+  for (uint64_t const value : std::array<uint64_t, 10>{0, 1, 15, 16, 17, 31, 32, 1'000, 123'456'789, UINT64_MAX})
+  {
+    std::size_t const index = LatencyHistogram::index_of(value);
+    REQUIRE_LT(index, LatencyHistogram::buckets);
+    REQUIRE_LE(LatencyHistogram::lowest_of(index), value);
+    REQUIRE_GE(LatencyHistogram::highest_of(index), value);
+
+    // the relative error is at most 1/16
+    REQUIRE_LE(LatencyHistogram::highest_of(index) - LatencyHistogram::lowest_of(index),
+               LatencyHistogram::lowest_of(index) / 16);
+  }
+
+  // the buckets are contiguous
+  for (std::size_t i = 0; i + 1 < LatencyHistogram::buckets; ++i)
+  {
+    REQUIRE_EQ(LatencyHistogram::highest_of(i) + 1, LatencyHistogram::lowest_of(i + 1));
+  }
+}
+
+/***/
+TEST_CASE("histogram quantiles")
+{
+  LatencyHistogram histogram;
+  for (int64_t i = 1; i <= 1'000; ++i)
+  {
+    histogram.record(std::chrono::microseconds{i});
+  }
+
+  auto const snapshot = histogram.snapshot();
+  REQUIRE_EQ(snapshot.count, 1'000);
+  REQUIRE_EQ(snapshot.max, 1'000'000);
+  REQUIRE_EQ(snapshot.mean(), std::chrono::nanoseconds{500'500});
+
+  auto const p50 = snapshot.value_at(0.5);
+  REQUIRE_GE(p50, std::chrono::microseconds{500});
+  REQUIRE_LE(p50, std::chrono::microseconds{500} + std::chrono::microseconds{500} / 16);
+
+  REQUIRE_EQ(snapshot.value_at(1.0), std::chrono::milliseconds{1});
+}
+
+/***/
+TEST_CASE("throttler counters and wait time")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  metered_throttler_t throttler {2, std::chrono::seconds{1}, OnSendCallback {}};
+
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    (void)throttler.try_send_message(LowPrioMsg{});
+  }
+  (void)throttler.try_send_message(HighPrioMsg{});
+
+  auto snapshot = throttler.metrics().snapshot();
+  REQUIRE_EQ(snapshot.admitted, 2);
+  REQUIRE_EQ(snapshot.throttled(), 4);
+  REQUIRE_EQ(snapshot.tiers[0].depth, 1);
+  REQUIRE_EQ(snapshot.tiers[1].depth, 3);
+  REQUIRE_EQ(snapshot.tiers[1].max_depth, 3);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_NE(throttler.send_queued_messages().count(), 0);
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+
+  snapshot = throttler.metrics().snapshot();
+  REQUIRE_EQ(snapshot.tiers[0].sent, 1);
+  REQUIRE_EQ(snapshot.tiers[1].sent, 3);
+  REQUIRE_EQ(snapshot.tiers[1].depth, 0);
+  REQUIRE_EQ(snapshot.tiers[1].max_depth, 3);
+
+  // one message waited 1s and the rest 2s
+  REQUIRE_EQ(snapshot.wait.count, 4);
+  REQUIRE_EQ(snapshot.wait.max, 2'000'000'000);
+  REQUIRE_GE(snapshot.wait.value_at(0.0), std::chrono::seconds{1});
+  REQUIRE_LE(snapshot.wait.value_at(0.0), std::chrono::milliseconds{1'000} + std::chrono::milliseconds{1'000} / 16);
+  REQUIRE_EQ(snapshot.wait.value_at(1.0), std::chrono::seconds{2});
+}
+
+/***/
+TEST_CASE("snapshot from a monitoring thread")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  metered_throttler_t throttler {10, std::chrono::seconds{1}, OnSendCallback {}};
+
+  std::atomic<bool> done{false};
+  std::atomic<bool> monotonic{true};
+  std::thread monitor{[&throttler, &done, &monotonic]()
+                      {
+                        uint64_t last{0};
+                        while (!done.load())
+                        {
+                          auto const snapshot = throttler.metrics().snapshot();
+                          monotonic = monotonic && (snapshot.admitted >= last);
+                          last = snapshot.admitted;
+                          std::this_thread::yield();
+                        }
+                      }};
+
+  for (uint32_t i = 0; i < 10'000; ++i)
+  {
+    ManualClock::advance(std::chrono::milliseconds{100});
+    (void)throttler.try_send_message(LowPrioMsg{});
+  }
+
+  done.store(true);
+  monitor.join();
+  REQUIRE(monotonic);
+  REQUIRE_EQ(throttler.metrics().snapshot().admitted, 10'000);
+}
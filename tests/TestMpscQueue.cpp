@@ -0,0 +1,100 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ets/MpscQueue.h"
+
+TEST_SUITE_BEGIN("MpscQueue");
+
+using namespace ets;
+
+/***/
+TEST_CASE("push and consume in batches")
+{
+  MpscQueue<std::string> queue {8};
+  REQUIRE_EQ(queue.capacity(), 8);
+  REQUIRE(queue.empty());
+
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    REQUIRE(queue.try_push(std::to_string(i)));
+  }
+
+  // the queue is full
+  REQUIRE_FALSE(queue.try_push(std::string{"full"}));
+
+  std::vector<std::string> consumed;
+  REQUIRE_EQ(queue.consume([&consumed](std::string& item) { consumed.push_back(std::move(item)); }, 5), 5);
+
+  // wrap around
+  for (uint32_t i = 8; i < 13; ++i)
+  {
+    REQUIRE(queue.try_push(std::to_string(i)));
+  }
+
+  REQUIRE_EQ(queue.consume([&consumed](std::string& item) { consumed.push_back(std::move(item)); }), 8);
+  REQUIRE(queue.empty());
+
+  for (uint32_t i = 0; i < 13; ++i)
+  {
+    REQUIRE_EQ(consumed[i], std::to_string(i));
+  }
+}
+
+/***/
+TEST_CASE("multiple producers")
+{
+  constexpr uint32_t producers = 4;
+  constexpr uint32_t items_per_producer = 20'000;
+
+  struct Item
+  {
+    uint32_t producer;
+    uint32_t sequence;
+  };
+
+  MpscQueue<Item> queue {1024};
+
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; ++p)
+  {
+    threads.emplace_back(
+      [&queue, p]()
+      {
+        for (uint32_t i = 0; i < items_per_producer; ++i)
+        {
+          queue.push(Item{p, i});
+        }
+      });
+  }
+
+  // each producer's items must arrive in order
+  std::vector<uint32_t> next_sequence(producers, 0);
+  uint32_t total{0};
+  while (total < producers * items_per_producer)
+  {
+    total += static_cast<uint32_t>(queue.consume(
+      [&next_sequence](Item& item)
+      {
+        REQUIRE_EQ(item.sequence, next_sequence[item.producer]);
+        next_sequence[item.producer] += 1;
+      },
+      64));
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE(queue.empty());
+  for (uint32_t p = 0; p < producers; ++p)
+  {
+    REQUIRE_EQ(next_sequence[p], items_per_producer);
+  }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,123 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ets/Clock.h"
+#include "ets/GcraWindow.h"
+#include "ets/Replay.h"
+#include "ets/SlidingWindow.h"
+
+TEST_SUITE_BEGIN("Replay");
+
+using namespace ets;
+
+namespace
+{
+std::string log_path(char const* test)
+{
+  return "/tmp/ets.test." + std::string{test} + "." + std::to_string(::getpid()) + ".log";
+}
+
+ReplayEvent event_at(std::chrono::nanoseconds timestamp, uint32_t id, uint16_t priority = 1)
+{
+  return ReplayEvent{timestamp.count(), id, priority};
+}
+} // namespace
+
+/***/
+TEST_CASE("write and map an event log")
+{
+  std::string const path = log_path("roundtrip");
+  std::vector<ReplayEvent> const events{event_at(std::chrono::seconds{1}, 1, 0),
+                                        event_at(std::chrono::seconds{2}, 2)};
+
+  write_event_log(path, events);
+
+  {
+    EventLog log{path};
+    REQUIRE_EQ(log.events().size(), 2);
+    REQUIRE_EQ(log.events()[0].timestamp, events[0].timestamp);
+    REQUIRE_EQ(log.events()[0].priority, 0);
+    REQUIRE_EQ(log.events()[1].id, 2);
+
+    EventLog const moved{std::move(log)};
+    REQUIRE_EQ(moved.events().size(), 2);
+    REQUIRE(log.events().empty());
+  }
+
+  // not an event log
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  std::fputs("a text file, not an event log", file);
+  std::fclose(file);
+  REQUIRE_THROWS_AS(EventLog{path}, std::runtime_error);
+
+  REQUIRE_EQ(std::remove(path.c_str()), 0);
+  REQUIRE_THROWS_AS(EventLog{path}, std::system_error);
+}
+
+/***/
+TEST_CASE("replay queues the messages over the limit")
+{
+  // 5 messages at once with a limit of 2 per second
+  std::vector<ReplayEvent> events;
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    events.push_back(event_at(std::chrono::seconds{1}, i));
+  }
+
+  ReplayReport const report = replay(events, SlidingWindow<ManualClock>{2, std::chrono::seconds{1}});
+
+  REQUIRE_EQ(report.messages, 5);
+  REQUIRE_EQ(report.queued, 3);
+  REQUIRE_EQ(report.sent, 5);
+
+  // sent 2 at 1s, 2 at 2s and the last at 3s
+  REQUIRE_EQ(report.duration, std::chrono::seconds{2});
+  REQUIRE_EQ(report.delays.count, 5);
+  REQUIRE_EQ(report.delays.max, std::chrono::nanoseconds{std::chrono::seconds{2}}.count());
+  REQUIRE_EQ(report.delays.value_at(0.0).count(), 0);
+  REQUIRE_EQ(report.delays.sum, std::chrono::nanoseconds{std::chrono::seconds{4}}.count());
+
+  REQUIRE_EQ(report.throughput(), doctest::Approx(2.5));
+  REQUIRE_EQ(report.utilization(2, std::chrono::seconds{1}), doctest::Approx(5.0 / 6.0));
+}
+
+/***/
+TEST_CASE("replay is deterministic")
+{
+  // a burst every 10 ms with idle gaps, events out of order are replayed at the latest time
+  std::vector<ReplayEvent> events;
+  for (uint32_t i = 0; i < 10'000; ++i)
+  {
+    auto const timestamp = std::chrono::milliseconds{(i / 50) * 10} + std::chrono::microseconds{i % 50};
+    events.push_back(event_at(timestamp, i, i % 10 == 0 ? 0 : 1));
+  }
+  std::swap(events[100], events[101]);
+
+  ReplayReport const first = replay(events, GcraWindow<ManualClock>{1'000, std::chrono::seconds{1}});
+  ReplayReport const second = replay(events, GcraWindow<ManualClock>{1'000, std::chrono::seconds{1}});
+
+  REQUIRE_EQ(first.sent, events.size());
+  REQUIRE_EQ(first.queued, second.queued);
+  REQUIRE_EQ(first.duration, second.duration);
+  REQUIRE_EQ(first.delays.sum, second.delays.sum);
+  REQUIRE_EQ(first.delays.max, second.delays.max);
+
+  // the flow is 5000 messages per second so the limit of 1000 per second is saturated, the 10 s
+  // of sending count as 11 windows
+  REQUIRE_GT(first.queued, 9'000);
+  REQUIRE_EQ(first.duration.count(), doctest::Approx(10e9).epsilon(0.01));
+  REQUIRE_EQ(first.utilization(1'000, std::chrono::seconds{1}), doctest::Approx(10.0 / 11.0).epsilon(0.01));
+
+  REQUIRE_EQ(replay({}, SlidingWindow<ManualClock>{1, std::chrono::seconds{1}}).messages, 0);
+}
+
+TEST_SUITE_END();
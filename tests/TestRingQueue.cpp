@@ -0,0 +1,87 @@
+#include "doctest.h"
+
+#include "ets/RingQueue.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+TEST_SUITE_BEGIN("RingQueue");
+
+using namespace ets;
+
+/***/
+TEST_CASE("push and pop items")
+{
+  RingQueue<uint32_t> queue {4};
+  REQUIRE(queue.empty());
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    queue.push_back(i);
+  }
+
+  REQUIRE_EQ(queue.size(), 3);
+  REQUIRE_EQ(queue.front(), 0);
+
+  queue.pop_front();
+  REQUIRE_EQ(queue.front(), 1);
+
+  // wrap around the end of the ring
+  for (uint32_t i = 3; i < 6; ++i)
+  {
+    queue.push_back(i);
+  }
+
+  REQUIRE_EQ(queue.size(), 5);
+  REQUIRE_GE(queue.capacity(), 5);
+
+  for (uint32_t i = 0; i < 5; ++i)
+  {
+    REQUIRE_EQ(queue[i], i + 1);
+  }
+}
+
+/***/
+TEST_CASE("grow keeps order")
+{
+  constexpr uint32_t n = 1000;
+  RingQueue<std::string> queue {2};
+
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    queue.push_back(std::to_string(i));
+
+    if (i % 3 == 0)
+    {
+      // keep the head moving while we grow
+      REQUIRE_EQ(queue.front(), std::to_string(i / 3));
+      queue.pop_front();
+    }
+  }
+
+  uint32_t expected = n - static_cast<uint32_t>(queue.size());
+  for (uint32_t i = 0; i < queue.size(); ++i)
+  {
+    REQUIRE_EQ(queue[i], std::to_string(expected + i));
+  }
+}
+
+/***/
+TEST_CASE("pop prefix")
+{
+  RingQueue<std::unique_ptr<uint32_t>> queue;
+
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    queue.emplace_back(std::make_unique<uint32_t>(i));
+  }
+
+  queue.pop_front(60);
+  REQUIRE_EQ(queue.size(), 40);
+  REQUIRE_EQ(*queue.front(), 60);
+
+  queue.pop_front(40);
+  REQUIRE(queue.empty());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,259 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "ets/GcraWindow.h"
+#include "ets/Runtime.h"
+
+TEST_SUITE_BEGIN("Runtime");
+
+using namespace ets;
+
+namespace
+{
+struct Order
+{
+  uint32_t producer;
+  uint32_t sequence;
+};
+
+/**
+ * Records the orders sent by a session, only used by the pipeline owning the session
+ */
+struct SessionCallback
+{
+  void on_send(Order const& order)
+  {
+    sent->push_back(order);
+    sent_count->fetch_add(1, std::memory_order_release);
+  }
+
+  std::vector<Order>* sent;
+  std::atomic<std::size_t>* sent_count;
+};
+
+using session_t = PriorityThrottler<SessionCallback, PriorityMap<Tier<Order>>, GcraWindow<>>;
+using runtime_t = Runtime<Order, session_t>;
+
+/**
+ * Waits until the sessions sent the expected number of messages
+ */
+bool wait_sent(std::atomic<std::size_t> const& sent_count, std::size_t expected)
+{
+  auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    if (sent_count.load(std::memory_order_acquire) == expected)
+    {
+      return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+
+  return false;
+}
+
+/**
+ * Checks the orders of each producer to a session were sent in the order they were pushed
+ */
+void check_order(std::vector<Order> const& sent, uint32_t producers)
+{
+  std::vector<int64_t> last_sequence(producers, -1);
+  for (Order const& order : sent)
+  {
+    REQUIRE_GT(static_cast<int64_t>(order.sequence), last_sequence[order.producer]);
+    last_sequence[order.producer] = order.sequence;
+  }
+}
+} // namespace
+
+/***/
+TEST_CASE("sessions are spread over the pipelines and keep the order of each producer")
+{
+  constexpr uint32_t producers = 3;
+  constexpr uint32_t sessions = 64;
+  constexpr uint32_t orders_per_producer = 20'000;
+
+  std::vector<std::vector<Order>> sent(sessions);
+  std::atomic<std::size_t> sent_count{0};
+
+  RuntimeConfig config;
+  config.pipelines = 2;
+  config.producers = producers;
+  config.ring_capacity = 256;
+  config.rebalance = false;
+
+  runtime_t runtime{config,
+                    [&sent, &sent_count](session_id_t session)
+                    {
+                      return std::make_unique<session_t>(1'000'000'000, std::chrono::seconds{1},
+                                                         SessionCallback{&sent[session], &sent_count});
+                    }};
+
+  // both pipelines own sessions
+  std::set<std::size_t> pipelines;
+  for (session_id_t session = 0; session < sessions; ++session)
+  {
+    pipelines.insert(runtime.pipeline_of(session));
+  }
+  REQUIRE_EQ(pipelines.size(), 2);
+
+  runtime.run();
+
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; ++p)
+  {
+    threads.emplace_back(
+      [&runtime, p]()
+      {
+        for (uint32_t i = 0; i < orders_per_producer; ++i)
+        {
+          runtime.producer(p).push(i % sessions, Order{p, i});
+        }
+      });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE(wait_sent(sent_count, producers * orders_per_producer));
+  runtime.stop();
+
+  std::size_t total_sessions{0};
+  for (std::size_t i = 0; i < runtime.pipelines(); ++i)
+  {
+    total_sessions += runtime.stats(i).sessions;
+  }
+  REQUIRE_EQ(total_sessions, sessions);
+
+  std::size_t total_sent{0};
+  for (auto const& session_sent : sent)
+  {
+    check_order(session_sent, producers);
+    total_sent += session_sent.size();
+  }
+  REQUIRE_EQ(total_sent, producers * orders_per_producer);
+}
+
+/***/
+TEST_CASE("throttled messages are sent by the pipeline once the window admits them")
+{
+  std::vector<Order> sent;
+  std::atomic<std::size_t> sent_count{0};
+
+  RuntimeConfig config;
+  config.pipelines = 2;
+  config.rebalance = false;
+
+  // two orders right away, then one every 10ms
+  runtime_t runtime{config,
+                    [&sent, &sent_count](session_id_t)
+                    {
+                      return std::make_unique<session_t>(GcraWindow<>{2, std::chrono::milliseconds{20}, 2},
+                                                         SessionCallback{&sent, &sent_count});
+                    }};
+  runtime.run();
+
+  for (uint32_t i = 0; i < 6; ++i)
+  {
+    runtime.producer(0).push(7, Order{0, i});
+  }
+
+  REQUIRE(wait_sent(sent_count, 6));
+  runtime.stop();
+
+  REQUIRE_EQ(runtime.stats(runtime.pipeline_of(7)).processed, 6);
+  REQUIRE_EQ(sent.size(), 6);
+  check_order(sent, 1);
+}
+
+/***/
+TEST_CASE("an idle pipeline steals a partition from a busy one")
+{
+  constexpr uint32_t sessions = 8;
+
+  RuntimeConfig config;
+  config.pipelines = 2;
+  config.ring_capacity = 256;
+  config.rebalance_interval = std::chrono::milliseconds{1};
+  config.steal_threshold = 64;
+
+  std::vector<std::vector<Order>> sent(sessions);
+  std::atomic<std::size_t> sent_count{0};
+  std::vector<session_id_t> ids;
+
+  runtime_t runtime{config,
+                    [&sent, &sent_count, &ids](session_id_t session)
+                    {
+                      std::size_t const index = std::find(ids.begin(), ids.end(), session) - ids.begin();
+                      return std::make_unique<session_t>(1'000'000'000, std::chrono::seconds{1},
+                                                         SessionCallback{&sent[index], &sent_count});
+                    }};
+
+  // sessions in different partitions all starting on the first pipeline
+  std::set<std::size_t> partitions;
+  for (session_id_t session = 0; ids.size() < sessions; ++session)
+  {
+    std::size_t const partition = mix_hash(session) & (runtime.partitions() - 1);
+    if ((runtime.pipeline_of(session) == 0) && partitions.insert(partition).second)
+    {
+      ids.push_back(session);
+    }
+  }
+
+  runtime.run();
+
+  uint32_t pushed{0};
+  auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while ((runtime.stats(1).partitions_in == 0) && (std::chrono::steady_clock::now() < deadline))
+  {
+    for (uint32_t i = 0; i < 1024; ++i, ++pushed)
+    {
+      runtime.producer(0).push(ids[pushed % sessions], Order{0, pushed});
+    }
+  }
+
+  // keep pushing while the partition moves
+  for (uint32_t i = 0; i < 10'000; ++i, ++pushed)
+  {
+    runtime.producer(0).push(ids[pushed % sessions], Order{0, pushed});
+  }
+
+  REQUIRE(wait_sent(sent_count, pushed));
+  runtime.stop();
+
+  PipelineStats const busy = runtime.stats(0);
+  PipelineStats const idle = runtime.stats(1);
+  REQUIRE_GE(idle.partitions_in, 1);
+  REQUIRE_EQ(busy.partitions_out, idle.partitions_in);
+  REQUIRE_EQ(idle.partitions_out, busy.partitions_in);
+  REQUIRE_GT(idle.processed, 0);
+
+  // only the partitions of the sessions had a load to move
+  std::size_t moved{0};
+  for (session_id_t const session : ids)
+  {
+    moved += runtime.pipeline_of(session) == 1;
+  }
+  REQUIRE_EQ(moved, idle.partitions_in - idle.partitions_out);
+
+  std::size_t total_sent{0};
+  for (auto const& session_sent : sent)
+  {
+    check_order(session_sent, 1);
+    total_sent += session_sent.size();
+  }
+  REQUIRE_EQ(total_sent, pushed);
+}
+
+TEST_SUITE_END();
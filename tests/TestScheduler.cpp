@@ -0,0 +1,82 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ets/Scheduler.h"
+
+TEST_SUITE_BEGIN("Scheduler");
+
+using namespace ets;
+
+/***/
+TEST_CASE("wait until scheduled time")
+{
+  Scheduler scheduler;
+
+  scheduler.schedule(std::chrono::milliseconds{20});
+  REQUIRE(scheduler.is_scheduled());
+  REQUIRE_FALSE(scheduler.is_due());
+
+  auto const start = std::chrono::steady_clock::now();
+  scheduler.wait();
+  REQUIRE_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{20});
+  REQUIRE(scheduler.is_due());
+
+  scheduler.cancel();
+  REQUIRE_FALSE(scheduler.is_scheduled());
+  REQUIRE_FALSE(scheduler.is_due());
+}
+
+/***/
+TEST_CASE("notification before wait is not lost")
+{
+  Scheduler scheduler;
+  scheduler.notify();
+
+  // returns immediately consuming the notification
+  scheduler.wait();
+
+  // the next wait times out on the schedule
+  scheduler.schedule(std::chrono::milliseconds{1});
+  scheduler.wait();
+  REQUIRE(scheduler.is_due());
+}
+
+/***/
+TEST_CASE_TEMPLATE("notify wakes parked thread", TSpin, std::integral_constant<int, 0>, std::integral_constant<int, 1>)
+{
+  Scheduler scheduler{std::chrono::milliseconds{TSpin::value}};
+  std::atomic<uint32_t> wakeups{0};
+  std::atomic<bool> stop{false};
+
+  std::thread processor{[&]()
+                        {
+                          while (!stop.load())
+                          {
+                            // nothing is scheduled, only a notification wakes us up
+                            scheduler.wait();
+                            wakeups.fetch_add(1);
+                          }
+                        }};
+
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    uint32_t const before = wakeups.load();
+    scheduler.notify();
+
+    while (wakeups.load() == before)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  stop.store(true);
+  scheduler.notify();
+  processor.join();
+
+  REQUIRE_GE(wakeups.load(), 100);
+}
+
+TEST_SUITE_END();
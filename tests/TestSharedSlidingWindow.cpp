@@ -0,0 +1,106 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ets/Clock.h"
+#include "ets/ConcurrentThrottler.h"
+#include "ets/SharedSlidingWindow.h"
+
+TEST_SUITE_BEGIN("SharedSlidingWindow");
+
+using namespace ets;
+
+namespace
+{
+std::string segment_name(char const* test)
+{
+  return "/ets.test." + std::string{test} + "." + std::to_string(::getpid());
+}
+
+struct OnSendCallback
+{
+  void on_send(int const&) { ++sent; }
+
+  std::size_t sent{0};
+};
+} // namespace
+
+/***/
+TEST_CASE("windows of the same name share the limit")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::string const name = segment_name("share");
+
+  SharedSlidingWindow<ManualClock> first {name, 3, std::chrono::seconds{1}};
+  SharedSlidingWindow<ManualClock> second {name, 3, std::chrono::seconds{1}};
+
+  REQUIRE_EQ(first.request().count(), 0);
+  REQUIRE_EQ(second.request().count(), 0);
+  REQUIRE_EQ(first.request().count(), 0);
+  REQUIRE_EQ(second.request(), std::chrono::seconds{1});
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(second.request_n(5).admitted, 3);
+
+  REQUIRE(SharedSlidingWindow<ManualClock>::remove(name));
+  REQUIRE_FALSE(SharedSlidingWindow<ManualClock>::remove(name));
+}
+
+/***/
+TEST_CASE("another process draws from the same window")
+{
+  std::string const name = segment_name("fork");
+  SharedSlidingWindow<> window {name, 10, std::chrono::hours{1}};
+
+  pid_t const child = ::fork();
+  REQUIRE_NE(child, -1);
+
+  if (child == 0)
+  {
+    SharedSlidingWindow<> child_window {name, 10, std::chrono::hours{1}};
+    ::_exit(child_window.request_n(7).admitted == 7 ? 0 : 1);
+  }
+
+  int status{0};
+  REQUIRE_EQ(::waitpid(child, &status, 0), child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE_EQ(WEXITSTATUS(status), 0);
+
+  REQUIRE_EQ(window.request_n(7).admitted, 3);
+  REQUIRE(SharedSlidingWindow<>::remove(name));
+}
+
+/***/
+TEST_CASE("a different limit is rejected")
+{
+  std::string const name = segment_name("layout");
+  SharedSlidingWindow<> window {name, 10, std::chrono::seconds{1}};
+
+  REQUIRE_THROWS_AS(SharedSlidingWindow<>(name, 11, std::chrono::seconds{1}), std::runtime_error);
+  REQUIRE_THROWS_AS(SharedSlidingWindow<>(name, 10, std::chrono::seconds{2}), std::runtime_error);
+  REQUIRE(SharedSlidingWindow<>::remove(name));
+}
+
+/***/
+TEST_CASE("concurrent throttler over a shared window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  std::string const name = segment_name("throttler");
+
+  ConcurrentThrottler<int, OnSendCallback, TypeErasedStorage, SharedSlidingWindow<ManualClock>> throttler {
+    SharedSlidingWindow<ManualClock>{name, 2, std::chrono::seconds{1}}, OnSendCallback{}, 16};
+
+  for (int i = 0; i < 3; ++i)
+  {
+    (void)throttler.try_send_message(i);
+  }
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE(SharedSlidingWindow<ManualClock>::remove(name));
+}
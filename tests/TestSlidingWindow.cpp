@@ -2,8 +2,10 @@
 
 #include <cstdint>
 #include <chrono>
-#include <thread>
+#include <type_traits>
 
+#include "ets/CacheLine.h"
+#include "ets/Clock.h"
 #include "ets/SlidingWindow.h"
 
 TEST_SUITE_BEGIN("SlidingWindow");
@@ -13,11 +15,13 @@ using namespace ets;
 /***/
 TEST_CASE("request and check")
 {
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
   // Accept 100 requests per second
-  SlidingWindow sw { 100, std::chrono::seconds {1} };
+  SlidingWindow<ManualClock> sw { 100, std::chrono::seconds {1} };
 
-  // First sleep for 500 ms
-  std::this_thread::sleep_for(std::chrono::milliseconds{500});
+  // First move forward 500 ms
+  ManualClock::advance(std::chrono::milliseconds{500});
 
   // Then send 90 requests
   for (uint32_t i = 0; i < 90; ++i)
@@ -27,8 +31,8 @@ TEST_CASE("request and check")
     REQUIRE_EQ(delay, 0);
   }
 
-  // Now sleep 600 ms
-  std::this_thread::sleep_for(std::chrono::milliseconds{600});
+  // Now move forward 600 ms
+  ManualClock::advance(std::chrono::milliseconds{600});
 
   // Then send 10 more requests
   for (uint32_t i = 0; i < 10; ++i)
@@ -39,13 +43,150 @@ TEST_CASE("request and check")
   }
 
   // We have now reached the maximum messages and any other request should fail for the next 400 ms
-  // here we assume there is no slowdown in the system for this test to pass ..
   for (uint32_t i = 0; i < 10; ++i)
   {
     // All the requests should fail returning a delay
+    auto const delay = sw.request();
+    REQUIRE_EQ(delay, std::chrono::milliseconds{400});
+  }
+
+  // Right before the oldest message leaves the window
+  ManualClock::advance(std::chrono::milliseconds{399});
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{1});
+
+  // The 90 messages of the first batch leave the window together
+  ManualClock::advance(std::chrono::milliseconds{1});
+  for (uint32_t i = 0; i < 90; ++i)
+  {
+    auto const delay = sw.request().count();
+    REQUIRE_EQ(delay, 0);
+  }
+
+  REQUIRE_EQ(sw.request(), std::chrono::milliseconds{600});
+}
+
+/***/
+TEST_CASE("request with steady clock")
+{
+  SlidingWindow sw { 10, std::chrono::seconds {1} };
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
     auto const delay = sw.request().count();
-    REQUIRE_GT(delay, 0);
+    REQUIRE_EQ(delay, 0);
   }
+
+  auto const delay = sw.request();
+  REQUIRE_GT(delay.count(), 0);
+  REQUIRE_LE(delay, std::chrono::seconds{1});
+}
+
+/***/
+TEST_CASE("request_n")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  // Accept 100 requests per second
+  SlidingWindow<ManualClock> sw { 100, std::chrono::seconds {1} };
+
+  auto result = sw.request_n(60);
+  REQUIRE_EQ(result.admitted, 60);
+  REQUIRE_EQ(result.delay.count(), 0);
+
+  ManualClock::advance(std::chrono::milliseconds{300});
+
+  // only the 40 free slots are available
+  result = sw.request_n(60);
+  REQUIRE_EQ(result.admitted, 40);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{700});
+
+  // the first 60 leave the window, the next 40 are still in it
+  ManualClock::advance(std::chrono::milliseconds{700});
+  result = sw.request_n(200);
+  REQUIRE_EQ(result.admitted, 60);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{300});
+
+  REQUIRE_EQ(sw.request().count(), std::chrono::nanoseconds{std::chrono::milliseconds{300}}.count());
+}
+
+/***/
+TEST_CASE("window fits in a cache line")
+{
+  // the admission of a throttler reads only its window, keep it to one line fill
+  static_assert(sizeof(SlidingWindow<>) <= cache_line_size);
+  static_assert(sizeof(SlidingWindow<ManualClock>) <= cache_line_size);
+  static_assert(sizeof(FixedSlidingWindow<4, std::chrono::seconds{1}>) <= cache_line_size);
+
+  SlidingWindow<ManualClock> sw { 5, std::chrono::seconds {1} };
+  REQUIRE_EQ(sw.max_messages(), 5);
+
+  sw.set_limit(7, std::chrono::seconds{2});
+  REQUIRE_EQ(sw.max_messages(), 7);
+  REQUIRE_EQ(sw.interval(), std::chrono::seconds{2});
+}
+
+/***/
+TEST_CASE("fixed window admits like the runtime window")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  SlidingWindow<ManualClock> sw { 3, std::chrono::milliseconds {100} };
+  FixedSlidingWindow<3, std::chrono::milliseconds{100}, ManualClock> fixed;
+
+  static_assert(decltype(fixed)::max_messages == 3);
+  static_assert(decltype(fixed)::interval == std::chrono::milliseconds{100});
+
+  for (uint32_t i = 0; i < 1'000; ++i)
+  {
+    if (i % 7 == 0)
+    {
+      auto const expected = sw.request_n(i % 5);
+      auto const result = fixed.request_n(i % 5);
+      REQUIRE_EQ(result.admitted, expected.admitted);
+      REQUIRE_EQ(result.delay, expected.delay);
+    }
+    else
+    {
+      REQUIRE_EQ(fixed.request(), sw.request());
+    }
+
+    ManualClock::advance(std::chrono::milliseconds{i % 40});
+  }
+}
+
+/***/
+TEST_CASE_TEMPLATE("count in window", TWindow, SlidingWindow<ManualClock>,
+                   FixedSlidingWindow<5, std::chrono::seconds{1}, ManualClock>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  TWindow window = [] {
+    if constexpr (std::is_same_v<TWindow, SlidingWindow<ManualClock>>)
+    {
+      return TWindow{5, std::chrono::seconds{1}};
+    }
+    else
+    {
+      return TWindow{};
+    }
+  }();
+
+  REQUIRE_EQ(window.count_in_window(std::chrono::seconds{1}), 0);
+  REQUIRE_EQ(window.remaining_capacity(), 5);
+
+  // wrap the ring around so the timestamps are in two segments
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    (void)window.request();
+    ManualClock::advance(std::chrono::milliseconds{300});
+  }
+
+  // 1.9s, 2.2s, 2.5s, 2.8s and 3.1s are in the ring and the time is 3.4s
+  REQUIRE_EQ(window.count_in_window(std::chrono::milliseconds{100}), 0);
+  REQUIRE_EQ(window.count_in_window(std::chrono::milliseconds{400}), 1);
+  REQUIRE_EQ(window.count_in_window(std::chrono::seconds{1}), 3);
+  REQUIRE_EQ(window.count_in_window(std::chrono::seconds{10}), 5);
+  REQUIRE_EQ(window.remaining_capacity(), 2);
+  REQUIRE_EQ(window.admissible(10, ManualClock::now()), window.remaining_capacity());
 }
 
-TEST_SUITE_END();
\ No newline at end of file
+TEST_SUITE_END();
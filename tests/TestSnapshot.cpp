@@ -0,0 +1,192 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "ets/Clock.h"
+#include "ets/Snapshot.h"
+#include "ets/Throttler.h"
+
+TEST_SUITE_BEGIN("Snapshot");
+
+using namespace ets;
+
+namespace
+{
+std::string snapshot_path(std::string const& name)
+{
+  return "/tmp/ets.test." + name + "." + std::to_string(::getpid()) + ".snapshot";
+}
+
+struct NewOrder
+{
+  uint64_t order_id;
+  std::string desc;
+};
+
+struct CancelOrder
+{
+  uint64_t order_id;
+};
+
+struct RecordingCallback
+{
+  void on_send(NewOrder const& order) { sent += "N" + std::to_string(order.order_id) + order.desc; }
+  void on_send(CancelOrder const& order) { sent += "C" + std::to_string(order.order_id); }
+
+  std::string sent;
+};
+
+using throttler_t =
+  PriorityThrottler<RecordingCallback, PriorityMap<Tier<CancelOrder>, Tier<NewOrder>>, SlidingWindow<ManualClock>>;
+
+class MockThrottler : public throttler_t
+{
+public:
+  using throttler_t::throttler_t;
+
+  std::string const& sent() { return this->_on_send_callback.sent; }
+};
+
+struct OrderSerializer
+{
+  void save(SnapshotWriter& writer, NewOrder const& order)
+  {
+    writer.write(uint8_t{0});
+    writer.write(order.order_id);
+    writer.write_string(order.desc);
+  }
+
+  void save(SnapshotWriter& writer, CancelOrder const& order)
+  {
+    writer.write(uint8_t{1});
+    writer.write(order.order_id);
+  }
+
+  template <typename TThrottler>
+  void load(SnapshotReader& reader, TThrottler& throttler)
+  {
+    auto const tag = reader.read<uint8_t>();
+    auto const order_id = reader.read<uint64_t>();
+    if (tag == 0)
+    {
+      throttler.queue_message(NewOrder{order_id, reader.read_string()});
+    }
+    else
+    {
+      throttler.queue_message(CancelOrder{order_id});
+    }
+  }
+};
+} // namespace
+
+/***/
+TEST_CASE("restore the window")
+{
+  std::string const path = snapshot_path("window");
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  SlidingWindow<ManualClock> window{3, std::chrono::seconds{1}};
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    REQUIRE_EQ(window.request().count(), 0);
+    ManualClock::advance(std::chrono::milliseconds{200});
+  }
+
+  save_snapshot<ManualClock>(path, window);
+
+  // the restarted process continues where the window was
+  ManualClock::advance(std::chrono::milliseconds{100});
+  SlidingWindow<ManualClock> restored{3, std::chrono::seconds{1}};
+  REQUIRE(restore_snapshot<ManualClock>(path, restored));
+
+  REQUIRE_EQ(restored.size(), 3);
+  REQUIRE_EQ(restored.request(), std::chrono::milliseconds{300});
+  REQUIRE_EQ(restored.request(), window.request());
+
+  ManualClock::advance(std::chrono::milliseconds{300});
+  REQUIRE_EQ(restored.request().count(), 0);
+  REQUIRE_EQ(restored.request(), std::chrono::milliseconds{200});
+
+  std::remove(path.c_str());
+}
+
+/***/
+TEST_CASE("restore the window with the system clock")
+{
+  std::string const path = snapshot_path("system");
+
+  FixedSlidingWindow<4, std::chrono::seconds{10}> window;
+  REQUIRE_EQ(window.request_n(4).admitted, 4);
+  save_snapshot(path, window);
+
+  FixedSlidingWindow<4, std::chrono::seconds{10}> restored;
+  REQUIRE(restore_snapshot(path, restored));
+
+  // the messages are still in the window
+  auto const delay = restored.request();
+  REQUIRE_GT(delay, std::chrono::seconds{9});
+  REQUIRE_LE(delay, std::chrono::seconds{10});
+
+  std::remove(path.c_str());
+}
+
+/***/
+TEST_CASE("restore the backlog")
+{
+  std::string const path = snapshot_path("backlog");
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler throttler{1, std::chrono::seconds{1}, RecordingCallback{}};
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{1, "a"}).count(), 0);
+  (void)throttler.try_send_message(NewOrder{2, "b"});
+  (void)throttler.try_send_message(CancelOrder{1});
+  (void)throttler.try_send_message(NewOrder{3, std::string(100, 'c')});
+
+  OrderSerializer serializer;
+  save_throttler_snapshot<ManualClock>(path, throttler, serializer);
+
+  MockThrottler restored{1, std::chrono::seconds{1}, RecordingCallback{}};
+  REQUIRE(restore_throttler_snapshot<ManualClock>(path, restored, serializer));
+
+  // the window is still full, then the backlog is sent by priority
+  REQUIRE_GT(restored.send_queued_messages().count(), 0);
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    ManualClock::advance(std::chrono::seconds{1});
+    (void)restored.send_queued_messages();
+  }
+
+  REQUIRE_EQ(restored.sent(), "C1N2bN3" + std::string(100, 'c'));
+
+  std::remove(path.c_str());
+}
+
+/***/
+TEST_CASE("missing or invalid snapshot")
+{
+  std::string const path = snapshot_path("invalid");
+  SlidingWindow<ManualClock> window{3, std::chrono::seconds{1}};
+
+  REQUIRE_FALSE(restore_snapshot(path, window));
+
+  {
+    std::ofstream file{path};
+    file << "not a snapshot of the window";
+  }
+  REQUIRE_THROWS_AS((void)restore_snapshot(path, window), std::runtime_error);
+
+  // a payload reader reading past the end
+  save_snapshot(path, window, [](SnapshotWriter& writer) { writer.write(uint32_t{1}); });
+  REQUIRE_THROWS_AS((void)restore_snapshot(path, window, [](SnapshotReader& reader) { (void)reader.read<uint64_t>(); }),
+                    std::runtime_error);
+
+  std::remove(path.c_str());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,82 @@
+#include "doctest.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ets/SpscQueue.h"
+
+TEST_SUITE_BEGIN("SpscQueue");
+
+using namespace ets;
+
+/***/
+TEST_CASE("push and consume in batches")
+{
+  SpscQueue<std::string> queue {8};
+  REQUIRE_EQ(queue.capacity(), 8);
+  REQUIRE(queue.empty());
+
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    REQUIRE(queue.try_push(std::to_string(i)));
+  }
+
+  // the queue is full
+  REQUIRE_FALSE(queue.try_push(std::string{"full"}));
+  REQUIRE_EQ(queue.pushed(), 8);
+
+  std::vector<std::string> consumed;
+  REQUIRE_EQ(queue.consume([&consumed](std::string& item) { consumed.push_back(std::move(item)); }, 5), 5);
+  REQUIRE_EQ(queue.consumed(), 5);
+
+  // wrap around
+  for (uint32_t i = 8; i < 13; ++i)
+  {
+    REQUIRE(queue.try_push(std::to_string(i)));
+  }
+
+  REQUIRE_EQ(queue.consume([&consumed](std::string& item) { consumed.push_back(std::move(item)); }), 8);
+  REQUIRE(queue.empty());
+  REQUIRE_EQ(queue.consumed(), queue.pushed());
+
+  for (uint32_t i = 0; i < 13; ++i)
+  {
+    REQUIRE_EQ(consumed[i], std::to_string(i));
+  }
+}
+
+/***/
+TEST_CASE("producer and consumer threads")
+{
+  constexpr uint32_t items = 200'000;
+
+  SpscQueue<uint32_t> queue {256};
+
+  std::thread producer{[&queue]()
+                       {
+                         for (uint32_t i = 0; i < items; ++i)
+                         {
+                           queue.push(uint32_t{i});
+                         }
+                       }};
+
+  // the items must arrive in order
+  uint32_t next{0};
+  while (next < items)
+  {
+    queue.consume(
+      [&next](uint32_t& item)
+      {
+        REQUIRE_EQ(item, next);
+        next += 1;
+      },
+      64);
+  }
+
+  producer.join();
+  REQUIRE(queue.empty());
+}
+
+TEST_SUITE_END();
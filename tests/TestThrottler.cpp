@@ -1,9 +1,13 @@
 #include "doctest.h"
 
+#include <array>
 #include <chrono>
 #include <cstdint>
-#include <thread>
+#include <span>
+#include <string>
+#include <vector>
 
+#include "ets/Clock.h"
 #include "ets/Throttler.h"
 
 TEST_SUITE_BEGIN("Throttler");
@@ -34,23 +38,26 @@ struct OnSendCallback
   size_t low_prior_counter{0};
 };
 
-class MockThrottler : public Throttler<HighPrioMsg,OnSendCallback>
+template <typename TRestStorage>
+class MockThrottler : public Throttler<HighPrioMsg, OnSendCallback, TRestStorage, SlidingWindow<ManualClock>>
   {
   public:
-    using base_t = Throttler<HighPrioMsg,OnSendCallback>;
+    using base_t = Throttler<HighPrioMsg, OnSendCallback, TRestStorage, SlidingWindow<ManualClock>>;
     using base_t::base_t;
 
-    OnSendCallback const& get_on_send() { return _on_send_callback; }
+    OnSendCallback const& get_on_send() { return this->_on_send_callback; }
   };
 
 /***/
-TEST_CASE("send message throttle and queue")
+TEST_CASE_TEMPLATE("send message throttle and queue", TRestStorage, TypeErasedStorage, VariantStorage<LowPrioMsg>)
 {
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
   // Accept 100 requests per second
-  MockThrottler throttler {100, std::chrono::seconds{1}, OnSendCallback {}};
+  MockThrottler<TRestStorage> throttler {100, std::chrono::seconds{1}, OnSendCallback {}};
 
-  // First sleep for 500 ms
-  std::this_thread::sleep_for(std::chrono::milliseconds{500});
+  // First move forward 500 ms
+  ManualClock::advance(std::chrono::milliseconds{500});
 
   // Then send 90 requests
   for (uint32_t i = 0; i < 90; ++i)
@@ -64,8 +71,8 @@ TEST_CASE("send message throttle and queue")
   REQUIRE_EQ(throttler.get_on_send().high_prior_counter, 0);
   REQUIRE_EQ(throttler.get_on_send().low_prior_counter, 90);
 
-  // Now sleep 600 ms
-  std::this_thread::sleep_for(std::chrono::milliseconds{600});
+  // Now move forward 600 ms
+  ManualClock::advance(std::chrono::milliseconds{600});
 
   // Then send 10 more requests
   for (uint32_t i = 0; i < 10; ++i)
@@ -83,17 +90,18 @@ TEST_CASE("send message throttle and queue")
   for (uint32_t i = 0; i < 10; ++i)
   {
     // All the messages should fail returning a delay
-    auto delay = throttler.try_send_message(HighPrioMsg{}).count();
-    REQUIRE_GT(delay, 0);
-    delay = throttler.try_send_message(LowPrioMsg{}).count();
-    REQUIRE_GT(delay, 0);
+    auto delay = throttler.try_send_message(HighPrioMsg{});
+    REQUIRE_EQ(delay, std::chrono::milliseconds{400});
+    delay = throttler.try_send_message(LowPrioMsg{});
+    REQUIRE_EQ(delay, std::chrono::milliseconds{400});
   }
 
-  // Now block and wait until we sent everything in the queue
-  auto delay = throttler.send_queued_messages().count();
-  while(delay != 0)
+  // Now wait each returned delay until we sent everything in the queue
+  auto delay = throttler.send_queued_messages();
+  while (delay.count() != 0)
   {
-    delay = throttler.send_queued_messages().count();
+    ManualClock::advance(delay);
+    delay = throttler.send_queued_messages();
 
     if (throttler.get_on_send().low_prior_counter > 90)
     {
@@ -108,4 +116,376 @@ TEST_CASE("send message throttle and queue")
   REQUIRE_EQ(throttler.get_on_send().low_prior_counter, 100);
 }
 
-TEST_SUITE_END();
\ No newline at end of file
+/***/
+TEST_CASE("send batch throttle and queue")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockThrottler<TypeErasedStorage> throttler {100, std::chrono::seconds{1}, OnSendCallback {}};
+
+  std::vector<LowPrioMsg> const low_batch(80);
+  auto result = throttler.try_send_batch(std::span{low_batch});
+  REQUIRE_EQ(result.admitted, 80);
+  REQUIRE_EQ(result.delay.count(), 0);
+  REQUIRE_EQ(throttler.get_on_send().low_prior_counter, 80);
+
+  ManualClock::advance(std::chrono::milliseconds{100});
+
+  std::array<HighPrioMsg, 50> high_batch{};
+  result = throttler.try_send_batch(std::span{high_batch});
+  REQUIRE_EQ(result.admitted, 20);
+  REQUIRE_EQ(result.delay, std::chrono::milliseconds{900});
+  REQUIRE_EQ(throttler.get_on_send().high_prior_counter, 20);
+
+  // the tail of the batch was queued and fits in the slots of the first batch
+  ManualClock::advance(result.delay);
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.get_on_send().high_prior_counter, 50);
+}
+
+namespace
+{
+struct Cancel
+{
+};
+
+struct Amend
+{
+};
+
+struct NewOrder
+{
+};
+
+using order_priorities_t = PriorityMap<Tier<Cancel>, Tier<Amend>, Tier<NewOrder>, AnyTier<>>;
+static_assert(order_priorities_t::tier_of<Cancel> == 0);
+static_assert(order_priorities_t::tier_of<Amend> == 1);
+static_assert(order_priorities_t::tier_of<NewOrder> == 2);
+static_assert(order_priorities_t::tier_of<int> == 3);
+static_assert(PriorityMap<Tier<Cancel, Amend>>::tier_of<NewOrder> == 1);
+
+struct RecordingCallback
+{
+  void on_send(Cancel const&) { sent.push_back('C'); }
+  void on_send(Amend const&) { sent.push_back('A'); }
+  void on_send(NewOrder const&) { sent.push_back('N'); }
+  void on_send(int const&) { sent.push_back('I'); }
+
+  std::string sent;
+};
+
+class MockPriorityThrottler : public PriorityThrottler<RecordingCallback, order_priorities_t, SlidingWindow<ManualClock>>
+{
+public:
+  using base_t = PriorityThrottler<RecordingCallback, order_priorities_t, SlidingWindow<ManualClock>>;
+  using base_t::base_t;
+
+  std::string const& sent() { return this->_on_send_callback.sent; }
+};
+} // namespace
+
+/***/
+TEST_CASE("send queued tiers by priority")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockPriorityThrottler throttler {1, std::chrono::seconds{1}, RecordingCallback {}};
+
+  REQUIRE_EQ(throttler.try_send_message(NewOrder{}).count(), 0);
+
+  // everything else is queued
+  (void)throttler.try_send_message(1);
+  (void)throttler.try_send_message(NewOrder{});
+  (void)throttler.try_send_message(Amend{});
+  (void)throttler.try_send_message(Cancel{});
+  (void)throttler.try_send_message(Amend{});
+  (void)throttler.try_send_message(Cancel{});
+
+  while (throttler.sent().size() != 7)
+  {
+    ManualClock::advance(std::chrono::seconds{1});
+    (void)throttler.send_queued_messages();
+  }
+
+  REQUIRE_EQ(throttler.sent(), "NCCAANI");
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+
+  // an emptied tier is filled again
+  ManualClock::advance(std::chrono::seconds{1});
+  (void)throttler.try_send_message(2);
+  (void)throttler.try_send_message(Amend{});
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.send_queued_messages().count(), 0);
+  REQUIRE_EQ(throttler.sent(), "NCCAANIIA");
+}
+
+/***/
+TEST_CASE("drain with a budget")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockPriorityThrottler throttler {5, std::chrono::seconds{1}, RecordingCallback {}};
+  std::array<NewOrder, 5> const orders{};
+  REQUIRE_EQ(throttler.try_send_batch(std::span{orders}).admitted, 5);
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    (void)throttler.try_send_message(Cancel{});
+    (void)throttler.try_send_message(NewOrder{});
+  }
+  ManualClock::advance(std::chrono::seconds{1});
+
+  // the budget stops the drain before the window does
+  auto status = throttler.send_queued_messages(DrainBudget{2});
+  REQUIRE_EQ(status.sent, 2);
+  REQUIRE(status.budget_exhausted);
+  REQUIRE_EQ(status.delay.count(), 0);
+  REQUIRE_EQ(status.remaining, std::array<std::size_t, 4>{1, 0, 3, 0});
+  REQUIRE_EQ(status.remaining_total(), 4);
+
+  // then the window stops it
+  status = throttler.send_queued_messages(DrainBudget{10});
+  REQUIRE_EQ(status.sent, 3);
+  REQUIRE_FALSE(status.budget_exhausted);
+  REQUIRE_EQ(status.delay, std::chrono::seconds{1});
+  REQUIRE_EQ(status.remaining, std::array<std::size_t, 4>{0, 0, 1, 0});
+
+  // a budget which ends with the backlog is not exhausted
+  ManualClock::advance(std::chrono::seconds{1});
+  status = throttler.send_queued_messages(DrainBudget{1});
+  REQUIRE_EQ(status.sent, 1);
+  REQUIRE_FALSE(status.budget_exhausted);
+  REQUIRE_EQ(status.remaining_total(), 0);
+  REQUIRE_EQ(throttler.sent(), "NNNNNCCCNNN");
+}
+
+namespace
+{
+/**
+ * A callback that takes one millisecond per message
+ */
+struct SlowCallback
+{
+  void on_send(NewOrder const&)
+  {
+    ManualClock::advance(std::chrono::milliseconds{1});
+    ++sent;
+  }
+
+  uint32_t sent{0};
+};
+} // namespace
+
+/***/
+TEST_CASE("drain with a time budget")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  PriorityThrottler<SlowCallback, PriorityMap<Tier<NewOrder>>, SlidingWindow<ManualClock>> throttler{
+    1'000, std::chrono::milliseconds{1}, SlowCallback{}};
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    throttler.queue_message(NewOrder{});
+  }
+
+  DrainBudget budget;
+  budget.max_time = std::chrono::microseconds{2'500};
+  auto status = throttler.send_queued_messages(budget);
+  REQUIRE_EQ(status.sent, 3);
+  REQUIRE(status.budget_exhausted);
+  REQUIRE_EQ(status.remaining_total(), 7);
+
+  status = throttler.send_queued_messages(DrainBudget{});
+  REQUIRE_EQ(status.sent, 7);
+  REQUIRE_FALSE(status.budget_exhausted);
+}
+
+namespace
+{
+/**
+ * A callback recording the size of each batch
+ */
+struct BatchCallback
+{
+  void on_send(Cancel const&) { batches.push_back(0); }
+
+  void on_send_batch(std::span<NewOrder const> orders) { batches.push_back(orders.size()); }
+
+  std::vector<std::size_t> batches;
+};
+} // namespace
+
+/***/
+TEST_CASE("send batches to the callback")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  using throttler_t = PriorityThrottler<BatchCallback, PriorityMap<Tier<Cancel>, Tier<NewOrder>>, SlidingWindow<ManualClock>>;
+
+  class MockBatchThrottler : public throttler_t
+  {
+  public:
+    using throttler_t::throttler_t;
+
+    std::vector<std::size_t>& batches() { return this->_on_send_callback.batches; }
+  };
+
+  MockBatchThrottler throttler{10, std::chrono::seconds{1}, BatchCallback{}};
+
+  // the admitted prefix is one batch, the rest is queued
+  std::array<NewOrder, 14> const orders{};
+  REQUIRE_EQ(throttler.try_send_batch(std::span{orders}).admitted, 10);
+  REQUIRE_EQ(throttler.batches(), std::vector<std::size_t>{10});
+  REQUIRE_EQ(throttler.queued(), 4);
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    throttler.queue_message(NewOrder{});
+  }
+  (void)throttler.try_send_message(Cancel{});
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.batches().clear();
+  REQUIRE_EQ(throttler.send_queued_messages(), std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.batches(), std::vector<std::size_t>{0, 9});
+
+  // the ring of 16 messages wraps around, its messages come in two spans
+  for (uint32_t i = 0; i < 7; ++i)
+  {
+    throttler.queue_message(NewOrder{});
+  }
+
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.batches().clear();
+  REQUIRE_EQ(throttler.send_queued_messages(), std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.batches(), std::vector<std::size_t>{7, 3});
+  REQUIRE_EQ(throttler.queued(), 2);
+
+  // the budget limits the batch
+  std::array<NewOrder, 13> const more{};
+  (void)throttler.try_send_batch(std::span{more});
+  ManualClock::advance(std::chrono::seconds{1});
+  throttler.batches().clear();
+  auto const status = throttler.send_queued_messages(DrainBudget{2});
+  REQUIRE(status.budget_exhausted);
+  REQUIRE_EQ(status.sent, 2);
+  REQUIRE_EQ(throttler.batches(), std::vector<std::size_t>{2});
+}
+
+/***/
+TEST_CASE("drain batches with a budget larger than the window admits")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  using throttler_t = PriorityThrottler<BatchCallback, PriorityMap<Tier<NewOrder>>, SlidingWindow<ManualClock>>;
+  throttler_t throttler{5, std::chrono::seconds{1}, BatchCallback{}};
+
+  std::array<NewOrder, 30> const orders{};
+  REQUIRE_EQ(throttler.try_send_batch(std::span{orders}).admitted, 5);
+  REQUIRE_EQ(throttler.queued(), 25);
+  ManualClock::advance(std::chrono::seconds{1});
+
+  // the window stops the drain before the budget does, the caller has to wait for the delay
+  auto const status = throttler.send_queued_messages(DrainBudget{10});
+  REQUIRE_EQ(status.sent, 5);
+  REQUIRE_FALSE(status.budget_exhausted);
+  REQUIRE_EQ(status.delay, std::chrono::seconds{1});
+  REQUIRE_EQ(status.remaining_total(), 20);
+}
+
+namespace
+{
+/**
+ * A message counting its copies and moves
+ */
+struct Payload
+{
+  explicit Payload(std::string desc) : desc(std::move(desc)) {}
+
+  Payload(Payload const& other) : desc(other.desc) { ++copies; }
+  Payload(Payload&& other) noexcept : desc(std::move(other.desc)) { ++moves; }
+  Payload& operator=(Payload const& other)
+  {
+    desc = other.desc;
+    ++copies;
+    return *this;
+  }
+  Payload& operator=(Payload&& other) noexcept
+  {
+    desc = std::move(other.desc);
+    ++moves;
+    return *this;
+  }
+  ~Payload() = default;
+
+  std::string desc;
+  static inline uint32_t copies{0};
+  static inline uint32_t moves{0};
+};
+
+struct ConsumingCallback
+{
+  void on_send(Payload&& payload) { sent.push_back(std::move(payload.desc)); }
+  void on_send(Payload const&) { ++by_reference; }
+  void on_send(HighPrioMsg const&) {}
+
+  std::vector<std::string> sent;
+  uint32_t by_reference{0};
+};
+
+template <typename TTier>
+class MockPayloadThrottler
+  : public PriorityThrottler<ConsumingCallback, PriorityMap<TTier>, SlidingWindow<ManualClock>>
+{
+public:
+  using base_t = PriorityThrottler<ConsumingCallback, PriorityMap<TTier>, SlidingWindow<ManualClock>>;
+  using base_t::base_t;
+
+  ConsumingCallback const& get_on_send() { return this->_on_send_callback; }
+};
+} // namespace
+
+/***/
+TEST_CASE_TEMPLATE("move and emplace messages", TTier, Tier<Payload>, Tier<Payload, HighPrioMsg>,
+                   AnyTier<TypeErasedStorage>, AnyTier<VariantStorage<Payload>>)
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  Payload::copies = 0;
+  Payload::moves = 0;
+
+  MockPayloadThrottler<TTier> throttler {1, std::chrono::seconds{1}, ConsumingCallback {}};
+
+  // the admitted message is handed to the callback as an rvalue
+  REQUIRE_EQ(throttler.try_send_message(Payload{"a"}).count(), 0);
+  REQUIRE_EQ(Payload::moves, 0);
+
+  // the throttled ones are moved or constructed in the backlog
+  REQUIRE_NE(throttler.try_send_message(Payload{"b"}).count(), 0);
+  REQUIRE_NE(throttler.template try_emplace_message<Payload>(std::string{"c"}).count(), 0);
+  REQUIRE_EQ(Payload::moves, 1);
+
+  // an lvalue is copied once into the backlog and still owned by the caller
+  Payload const d{"d"};
+  REQUIRE_NE(throttler.try_send_message(d).count(), 0);
+  REQUIRE_EQ(Payload::copies, 1);
+  REQUIRE_EQ(d.desc, "d");
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    ManualClock::advance(std::chrono::seconds{1});
+    (void)throttler.send_queued_messages();
+  }
+
+  // the drain hands the queued messages over as rvalues
+  REQUIRE_EQ(throttler.get_on_send().sent, std::vector<std::string>{"a", "b", "c", "d"});
+  REQUIRE_EQ(throttler.get_on_send().by_reference, 0);
+  REQUIRE_EQ(Payload::copies, 1);
+
+  // an admitted lvalue is passed by reference
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(throttler.try_send_message(d).count(), 0);
+  REQUIRE_EQ(throttler.get_on_send().by_reference, 1);
+  REQUIRE_EQ(Payload::copies, 1);
+}
+
+TEST_SUITE_END();
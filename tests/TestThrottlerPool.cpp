@@ -0,0 +1,128 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/ThrottlerPool.h"
+
+TEST_SUITE_BEGIN("ThrottlerPool");
+
+using namespace ets;
+
+namespace
+{
+struct NewOrder
+{
+  uint64_t order_id;
+};
+
+struct CancelOrder
+{
+  uint64_t order_id;
+};
+
+struct SessionCallback
+{
+  void on_send(std::size_t session, NewOrder const& order) { sent.push_back("N" + _tag(session, order.order_id)); }
+  void on_send(std::size_t session, CancelOrder const& order) { sent.push_back("C" + _tag(session, order.order_id)); }
+
+  static std::string _tag(std::size_t session, uint64_t order_id)
+  {
+    return std::to_string(order_id) + "@" + std::to_string(session);
+  }
+
+  std::vector<std::string> sent;
+};
+
+using pool_t = ThrottlerPool<SessionCallback, PriorityMap<Tier<CancelOrder>, Tier<NewOrder>>, SlidingWindow<ManualClock>>;
+
+class MockPool : public pool_t
+{
+public:
+  using pool_t::pool_t;
+
+  std::vector<std::string>& sent() { return this->_on_send_callback.sent; }
+};
+} // namespace
+
+/***/
+TEST_CASE("spread messages over the sessions")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockPool pool{3, 2, std::chrono::seconds{1}, SessionCallback{}};
+  REQUIRE_EQ(pool.sessions(), 3);
+
+  // the idle sessions are used in turn, 6 messages fit in the pool
+  std::vector<std::size_t> sessions;
+  for (uint64_t i = 0; i < 6; ++i)
+  {
+    ManualClock::advance(std::chrono::milliseconds{1});
+    RoutedSend const routed = pool.try_send_message(NewOrder{i});
+    REQUIRE_EQ(routed.delay.count(), 0);
+    sessions.push_back(routed.session);
+  }
+
+  REQUIRE_EQ(sessions, std::vector<std::size_t>{0, 1, 2, 0, 1, 2});
+  REQUIRE_EQ(pool.sent().back(), "N5@2");
+}
+
+/***/
+TEST_CASE("queue on the session with the soonest slot")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  std::vector<SlidingWindow<ManualClock>> windows;
+  windows.emplace_back(1, std::chrono::seconds{1});
+  windows.emplace_back(1, std::chrono::milliseconds{100});
+  MockPool pool{std::move(windows), SessionCallback{}};
+
+  REQUIRE_EQ(pool.try_send_message(NewOrder{1}).session, 0);
+  REQUIRE_EQ(pool.try_send_message(NewOrder{2}).session, 1);
+
+  // both are throttled, the faster session frees up first
+  RoutedSend routed = pool.try_send_message(NewOrder{3});
+  REQUIRE_EQ(routed.session, 1);
+  REQUIRE_EQ(routed.delay, std::chrono::milliseconds{100});
+
+  // the session with the shorter backlog gets the next message
+  routed = pool.try_send_message(NewOrder{4});
+  REQUIRE_EQ(routed.session, 0);
+  REQUIRE_EQ(routed.delay, std::chrono::seconds{1});
+  REQUIRE_EQ(pool.session(0).queued(), 1);
+  REQUIRE_EQ(pool.session(1).queued(), 1);
+
+  ManualClock::advance(std::chrono::milliseconds{100});
+  REQUIRE_EQ(pool.send_queued_messages(), std::chrono::milliseconds{900});
+  REQUIRE_EQ(pool.sent().back(), "N3@1");
+  REQUIRE_EQ(pool.least_loaded(), 1);
+
+  ManualClock::advance(std::chrono::milliseconds{900});
+  REQUIRE_EQ(pool.send_queued_messages().count(), 0);
+  REQUIRE_EQ(pool.sent().back(), "N4@0");
+}
+
+/***/
+TEST_CASE("pin messages to a session")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+
+  MockPool pool{2, 1, std::chrono::seconds{1}, SessionCallback{}};
+
+  RoutedSend const routed = pool.try_send_message(NewOrder{1});
+  REQUIRE_EQ(routed.session, 0);
+
+  // the cancel goes to the session of its order even if that session is throttled
+  REQUIRE_GT(pool.try_send_message_on(routed.session, CancelOrder{1}).count(), 0);
+  REQUIRE_EQ(pool.least_loaded(), 1);
+  REQUIRE_EQ(pool.try_send_message(NewOrder{2}).session, 1);
+
+  ManualClock::advance(std::chrono::seconds{1});
+  REQUIRE_EQ(pool.send_queued_messages().count(), 0);
+  REQUIRE_EQ(pool.sent(), std::vector<std::string>{"N1@0", "N2@1", "C1@0"});
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,137 @@
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "ets/Clock.h"
+#include "ets/TimerWheel.h"
+
+TEST_SUITE_BEGIN("TimerWheel");
+
+using namespace ets;
+
+using wheel_t = TimerWheel<uint32_t, ManualClock>;
+
+/***/
+TEST_CASE("fire due timers only")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  wheel_t wheel {std::chrono::milliseconds{1}};
+
+  auto const first = wheel.add(1);
+  auto const second = wheel.add(2);
+  auto const third = wheel.add(3);
+
+  wheel.schedule_after(first, std::chrono::milliseconds{5}, ManualClock::now());
+  wheel.schedule_after(second, std::chrono::milliseconds{300}, ManualClock::now());
+  wheel.schedule_after(third, std::chrono::seconds{100}, ManualClock::now());
+  REQUIRE_EQ(wheel.size(), 3);
+  REQUIRE_EQ(*wheel.next_expiry(), ManualClock::now() + std::chrono::milliseconds{5});
+
+  std::vector<uint32_t> fired;
+  auto on_expire = [&fired](wheel_t::timer_id, uint32_t value) { fired.push_back(value); };
+
+  REQUIRE_EQ(wheel.advance(ManualClock::now() + std::chrono::microseconds{4999}, on_expire), 0);
+  REQUIRE_EQ(wheel.advance(ManualClock::now() + std::chrono::milliseconds{5}, on_expire), 1);
+  REQUIRE_EQ(fired, std::vector<uint32_t>{1});
+  REQUIRE_FALSE(wheel.is_scheduled(first));
+
+  // cancelled timers do not fire
+  wheel.cancel(third);
+  REQUIRE_EQ(wheel.advance(ManualClock::now() + std::chrono::seconds{200}, on_expire), 1);
+  REQUIRE_EQ(fired, std::vector<uint32_t>{1, 2});
+  REQUIRE_EQ(wheel.size(), 0);
+  REQUIRE_FALSE(wheel.next_expiry());
+
+  // ids are reused
+  wheel.remove(third);
+  REQUIRE_EQ(wheel.add(4), third);
+}
+
+/***/
+TEST_CASE("reschedule from the callback")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  wheel_t wheel {std::chrono::milliseconds{1}, ManualClock::now()};
+
+  auto const id = wheel.add(7);
+  wheel.schedule_after(id, std::chrono::milliseconds{10}, ManualClock::now());
+
+  // a throttler that keeps returning a delay until it drained its backlog
+  uint32_t drains{0};
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    ManualClock::advance(std::chrono::milliseconds{1});
+    wheel.advance(ManualClock::now(),
+                  [&](wheel_t::timer_id timer, uint32_t)
+                  {
+                    ++drains;
+                    if (drains < 5)
+                    {
+                      wheel.schedule_after(timer, std::chrono::milliseconds{10}, ManualClock::now());
+                    }
+                  });
+  }
+
+  REQUIRE_EQ(drains, 5);
+}
+
+/***/
+TEST_CASE("matches a sorted reference")
+{
+  ManualClock::set(ManualClock::time_point{std::chrono::seconds{1}});
+  auto const start = ManualClock::now();
+  constexpr auto tick = std::chrono::microseconds{10};
+  wheel_t wheel {tick, start};
+
+  uint64_t seed{7};
+  auto next = [&seed]()
+  {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed >> 33;
+  };
+
+  // deadlines from a few ticks to beyond the top level
+  std::vector<ManualClock::time_point> deadlines;
+  for (uint32_t i = 0; i < 2000; ++i)
+  {
+    auto const range = uint64_t{1} << (next() % 40);
+    deadlines.push_back(start + std::chrono::nanoseconds{static_cast<int64_t>(next() % range)});
+    wheel.schedule(wheel.add(i), deadlines.back());
+  }
+
+  std::multimap<ManualClock::time_point, uint32_t> reference;
+  for (uint32_t i = 0; i < deadlines.size(); ++i)
+  {
+    reference.emplace(deadlines[i], i);
+  }
+
+  // advance in growing steps and check every timer fires in the step that contains its deadline
+  auto now = start;
+  std::chrono::nanoseconds step{1000};
+  while (!reference.empty())
+  {
+    now += step;
+    step = step * 3 / 2;
+
+    wheel.advance(now,
+                  [&](wheel_t::timer_id, uint32_t value)
+                  {
+                    REQUIRE_LE(deadlines[value], now);
+                    REQUIRE_GT(deadlines[value] + 2 * tick, now - step * 2 / 3);
+                    reference.erase(reference.find(deadlines[value]));
+                  });
+
+    // nothing that is due is left behind, allowing the deadline rounding up to the tick
+    if (!reference.empty())
+    {
+      REQUIRE_GT(reference.begin()->first + tick, now);
+    }
+  }
+
+  REQUIRE_EQ(wheel.size(), 0);
+}
+
+TEST_SUITE_END();
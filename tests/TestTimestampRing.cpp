@@ -0,0 +1,65 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "ets/TimestampRing.h"
+
+TEST_SUITE_BEGIN("TimestampRing");
+
+using namespace ets;
+
+/***/
+TEST_CASE("request over external memory")
+{
+  std::atomic<uint64_t> sequence{0};
+  auto slots = std::make_unique<TimestampRing::Slot[]>(2);
+  TimestampRing ring {sequence, slots.get(), 2, std::chrono::nanoseconds{100}};
+
+  REQUIRE_EQ(ring.request_n(1, 1'000).admitted, 1);
+  REQUIRE_EQ(ring.request_n(1, 1'050).admitted, 1);
+  REQUIRE_EQ(sequence.load(), 2);
+
+  auto const result = ring.request_n(1, 1'060);
+  REQUIRE_EQ(result.admitted, 0);
+  REQUIRE_EQ(result.delay, std::chrono::nanoseconds{40});
+
+  REQUIRE_EQ(ring.request_n(2, 1'100).admitted, 1);
+  REQUIRE_EQ(ring.request_n(2, 1'200).admitted, 2);
+}
+
+/***/
+TEST_CASE("complete the claim of a dead sender")
+{
+  std::atomic<uint64_t> sequence{0};
+  auto slots = std::make_unique<TimestampRing::Slot[]>(2);
+  TimestampRing ring {sequence, slots.get(), 2, std::chrono::nanoseconds{100}, std::chrono::milliseconds{1}};
+
+  // a sender claims the first message and dies before writing its timestamp
+  sequence.fetch_add(1);
+  REQUIRE_EQ(ring.request_n(1, 1'000).admitted, 1);
+
+  // the third message waits for the dead claim, then counts it as sent now
+  auto const result = ring.request_n(1, 1'010);
+  REQUIRE_EQ(result.admitted, 0);
+  REQUIRE_EQ(result.delay, std::chrono::nanoseconds{100});
+
+  REQUIRE_EQ(ring.request_n(1, 1'110).admitted, 1);
+}
+
+/***/
+TEST_CASE("a batch larger than the window")
+{
+  std::atomic<uint64_t> sequence{0};
+  auto slots = std::make_unique<TimestampRing::Slot[]>(3);
+  TimestampRing ring {sequence, slots.get(), 3, std::chrono::nanoseconds{100}};
+
+  auto result = ring.request_n(5, 1'000);
+  REQUIRE_EQ(result.admitted, 3);
+  REQUIRE_EQ(result.delay, std::chrono::nanoseconds{100});
+
+  result = ring.request_n(5, 1'100);
+  REQUIRE_EQ(result.admitted, 3);
+  REQUIRE_EQ(result.delay, std::chrono::nanoseconds{100});
+}